@@ -2,180 +2,780 @@
  * Name: sliding_puzzle.c                                                                           *
  * File creation date: 2022-04-17                                                                   *
  * 1.0 date: 2022-07-10                                                                             *
- * Last modification date: 2022-09-09                                                               *
+ * Last modification date: 2026-10-17                                                               *
  * Author: Ryan Wells                                                                               *
  * Purpose: A sliding-block puzzle CLI videogame                                                    *
  * Further work: see notes at end of file                                                           *
  ****************************************************************************************************/
 
 /* Preprocessing Directives (#include) */
-#include <string.h> // for strcpy(), strcat(), strcmp(), and strlen()
-#include <stdlib.h> // for exit(), rand(), srand(), and atoi()
-#include <stdio.h> // for printf(), scanf(), getchar(), fopen(), fclose(), fseek(),
-                   //    fgetc(), ftell(), fread(), fprintf(),
-                   //    the macros "NULL", "EOF", and "SEEK_SET",
+#define _POSIX_C_SOURCE 200809L // for nanosleep(), write(), isatty(), open(), fstat(), mmap(), threads, and termios under strict
+                                //    ISO C compilation
+#include <string.h> // for strcpy(), strcat(), strcmp(), strlen(), strrchr(), memcpy(), and memset()
+#include <stdlib.h> // for exit(), atexit(), atoi(), abs(), strtol(), strtoull(), strtod(), malloc(), calloc(), aligned_alloc(),
+                    //    and free()
+#include <stdio.h> // for printf(), scanf(), getchar(), fopen(), fclose(),
+                   //    fprintf(), sprintf(), fflush(), fwrite(), rename(),
+                   //    the macros "NULL" and "EOF",
                    //    and the types "FILE" and "size_t"
 #include <stdbool.h> // for the macros "bool", "true", and "false"
-#include <time.h> // for time()
+#include <stdint.h> // for the types "uint8_t" and "uint64_t"
+#include <time.h> // for time(), nanosleep(), clock_gettime(), the type "struct timespec", and the macro "CLOCK_MONOTONIC"
 #include <ctype.h> // for isdigit() and tolower()
+#include <stddef.h> // for offsetof()
+#include <unistd.h> // for read(), write(), isatty(), close(), sysconf(),
+                    //    and the macros "STDIN_FILENO", "STDOUT_FILENO", and "_SC_NPROCESSORS_ONLN"
+#include <fcntl.h> // for open() and the macro "O_RDONLY"
+#include <sys/stat.h> // for fstat() and the type "struct stat"
+#include <sys/mman.h> // for mmap(), munmap(), and the macros "PROT_READ", "MAP_PRIVATE", and "MAP_FAILED"
+#include <errno.h> // for errno and the macro "EINTR"
+#include <pthread.h> // for pthread_create(), pthread_join(), pthread_mutex_init(), pthread_mutex_lock(),
+                     //    pthread_mutex_unlock(), pthread_mutex_destroy(), pthread_once(), the types "pthread_t",
+                     //    "pthread_mutex_t", and "pthread_once_t", and the macro "PTHREAD_ONCE_INIT"
+#include <stdatomic.h> // for atomic_load_explicit(), atomic_store_explicit(), atomic_fetch_or_explicit(),
+                       //    and the macro "memory_order_relaxed"
+#include <termios.h> // for tcgetattr(), tcsetattr(), the type "struct termios",
+                     //    and the macros "ICANON", "ECHO", "ISIG", "VMIN", "VTIME", and "TCSANOW"
+#include <sys/ioctl.h> // for ioctl(), the type "struct winsize", and the macro "TIOCGWINSZ"
+// The tile kernels (see KERNEL_SET) use the widest vectors the compiler targets: AVX2 when built with -mavx2 or -march=native,
+//    otherwise SSE2 on any x86-64, otherwise (or with SP_SCALAR_KERNELS defined) plain C:
+#if defined(__AVX2__) && !defined(SP_SCALAR_KERNELS)
+#include <immintrin.h> // for the AVX2 intrinsics (_mm256_shuffle_epi8(), _mm256_testz_si256(), and the like)
+#define AVX2_KERNELS
+#elif defined(__SSE2__) && !defined(SP_SCALAR_KERNELS)
+#include <emmintrin.h> // for the SSE2 intrinsics (_mm_shufflelo_epi16(), _mm_movemask_epi8(), and the like)
+#define SSE2_KERNELS
+#endif
+#include "sliding_puzzle.h" // for the engine interface, its move codes, and the type "Sp_State"
 
 /* Preprocessing Directives (#define) */
-#define ROW_WIDTH 38
-#define CLEAR_CONSOLE (void) printf("\033[H\033[2J\033[3J"); // ANSI escapes for clearing screen and scrollback.
-#define BLANK_LINE "|                                    |"
-#define PANEL_TOP " ____________________________________ "
-#define GAP "                                      "
+#define DEFAULT_PANEL_WIDTH 38 // Characters across each panel of the default puzzle and of templates, edges included
+#define DEFAULT_PANEL_HEIGHT 12 // Lines down each one, its top line included
+#define MIN_PANEL_WIDTH 4 // Narrowest panel a puzzle can have: its edges and room for a two-digit panel number
+#define MIN_PANEL_HEIGHT 2 // Shortest: its top line and one line of art
+#define PANEL_SIZE_HEADER "Panel size: " // Starts the template line giving the size of its panels (as in "Panel size: 38x12")
+#define CLEAR_SEQUENCE "\033[H\033[2J\033[3J" // ANSI escapes for clearing screen and scrollback.
+#define CLEAR_CONSOLE (void) printf(CLEAR_SEQUENCE);
 #define MAX_LINE 1000
-#define NUM_ROWS 12
-#define FILE_PANEL_ALL_CHAR_NUM 4254
-#define SELECTED_PANEL (panel_number == 0 ? panel0 : panel_number == 1 ? panel1 : panel_number == 2 ? panel2 \
-: panel_number == 3 ? panel3 : panel_number == 4 ? panel4 : panel_number == 5 ? panel5 \
-: panel_number == 6 ? panel6 : panel_number == 7 ? panel7 : panel8)
+#define DISPLAY_FIRST_LINE 2 // Terminal line of the puzzle's first row, just below "Puzzle:"
+#define PROMPT_LINES 3 // Terminal lines draw_display() leaves below the puzzle: two blank lines, then the prompt
+#define MAX_DISPLAY_LINES (DEFAULT_PANEL_HEIGHT * MAX_GRID_SIDE + 1) // Lines in the largest display: each row of panels, plus
+                                                                    //     the final line (panels may be any size whose display
+                                                                    //     fits in this many lines and MAX_DISPLAY_WIDTH columns)
+#define MAX_DISPLAY_WIDTH (DEFAULT_PANEL_WIDTH * MAX_GRID_SIDE + 3 + DEFAULT_PANEL_WIDTH) // Characters in its longest line: a row
+                                                                                          //     of panels, a 3-space gap, and the
+                                                                                          //     sidebar
+#define MAX_PICTURE_SIZE ((MAX_DISPLAY_LINES - 1) * MAX_DISPLAY_WIDTH) // Bytes of art in the largest picture whose display fits
+#define FRAME_BUFFER_SIZE 65536 // Comfortably above a full repaint of the largest display, about 30 KB
+#define SYNC_BEGIN "\033[?2026h" // Synchronized output: the terminal holds off showing anything until SYNC_END,
+#define SYNC_END "\033[?2026l"   //     so a frame appears all at once (terminals without it ignore both)
+#define PANEL_BYTES(size) ((size_t) (size).width * (size_t) (size).height) // A panel's lines lie back to back, with no nulls
+#define PANEL_LINE(panel, line, size) ((panel) + (size_t) (line) * (size_t) (size).width) //     or new-lines
+#define PANEL_STRIDE(size) ((PANEL_BYTES(size) + CACHE_LINE - 1) / CACHE_LINE * CACHE_LINE) // Bytes from one atlas panel to
+                                                                                          //     the next: each starts on a
+                                                                                          //     cache line, zero-padded
+#define FILE_LINE_LENGTH(columns, size) ((size).width * (columns) + 1) // Each line of a custom puzzle, including its new-line
+#define FILE_PUZZLE_LENGTH(rows, columns, size) (((size).height * (rows) + 1) * FILE_LINE_LENGTH(columns, size) - 1) // Up to the
+                                                                                                                 //     final
+                                                                                                                 //     line's end
+#define PACK_MAGIC "SPUZPACK" // Opens every puzzle pack (the terminating null is not stored)
+#define PACK_MAGIC_LENGTH (sizeof(PACK_MAGIC) - 1)
+#define PACK_VERSION 3
+#define PACK_HEADER_SIZE 32 // Magic, then little-endian uint32s: version, puzzle count, tile count, index offset, tile offset
+#define PACK_NAME_LENGTH 32 // Each index entry starts with the puzzle's name, null-padded (but not necessarily null-terminated)
+#define PACK_ENTRY_SIZE (PACK_NAME_LENGTH + 8) // Name; grid rows and columns, then panel width and height (a byte each); offset
+                                              //     (uint32) of the puzzle's layout, the offset of a tile block (uint32, from
+                                              //     the first) for each of its panels; each block is a panel's lines back to back
+#define MAX_COMPILE_THREADS 64 // Most threads the pack compiler validates files on, however many cores there are
+#define SOURCE_VALID 0 // Outcomes of validating a pack compiler's source file (Pack_Source.status)
+#define SOURCE_UNOPENED 1
+#define SOURCE_NO_PUZZLE 2
+#define SOURCE_FORMAT_ERROR 3
+#define FNV_OFFSET_BASIS 14695981039346656037ULL // 64-bit FNV-1a hash constants, for spotting identical tiles
+#define FNV_PRIME 1099511628211ULL
+#define MIN_GRID_SIDE 2 // Fewest rows or columns of panels a puzzle can have
+#define MAX_GRID_SIDE 8 // Most rows or columns; move codes have room for flipping any of the 64 positions
+#define MAX_CELLS (MAX_GRID_SIDE * MAX_GRID_SIDE)
+#define DEFAULT_SIDE 3 // The default puzzle is 3x3, the only size small enough for a distance table of every arrangement
+#define NUM_PANELS (DEFAULT_SIDE * DEFAULT_SIDE) // Positions on a 3x3 board
+#define GAP_TILE (NUM_PANELS - 1) // The 3x3 board's gap tile (on any board, the last tile stands for the gap, and its art is
+                                  //     shown as the "final piece" instead)
+#define FLIP_HORIZONTAL SP_FLIP_HORIZONTAL // Orientation bit for a mirror across the y-axis
+#define FLIP_VERTICAL SP_FLIP_VERTICAL // Orientation bit for a mirror across the x-axis
+#define ROTATE SP_ROTATE // A 180-degree rotation toggles both bits
+#define NUM_ORIENTATIONS 4 // Every combination of the two orientation bits
+#define ATLAS_GAP(grid, top_row) ((grid)->cells * NUM_ORIENTATIONS + (top_row)) // Panels of an atlas after every tile in every
+#define ATLAS_SIDEBAR(grid) ((grid)->cells * NUM_ORIENTATIONS + 2)              //     orientation: the gap's graphics (anywhere
+#define ATLAS_PANELS(grid) ((grid)->cells * NUM_ORIENTATIONS + 3)               //     below the top row, then in the top row,
+                                                                                //     with no top line) and "Final Piece:"
+#define CACHE_LINE 64
+#if defined(AVX2_KERNELS)
+#define KERNEL_SET "AVX2" // The instructions the tile kernels (mirror_line() and panels_equal()) are built with
+#elif defined(SSE2_KERNELS)
+#define KERNEL_SET "SSE2"
+#else
+#define KERNEL_SET "scalar"
+#endif
+#define BENCH_BYTES (256L << 20) // Bytes of panels each "--bench-kernels" measurement runs through
+#define BENCH_PANELS 64 // Panels it runs through them in, cycling
+#define BENCH_ROUNDS 5 // Times each measurement is taken, keeping the fastest (the others are slowed by whatever else ran)
+#define MAX_SOLUTION_LENGTH SP_MAX_SOLUTION_LENGTH // Above the 4x4 worst case of 80 slides plus 15 flips, and any 5x5 one
+#define MAX_GOALS 16 // Most goal arrangements the solver tracks separately before treating tiles individually
+#define SOLVER_NODE_LIMIT 20000000L // Boards the solver examines before giving up (only ever reached on boards larger than 3x3)
+#define PATTERN_NODE_LIMIT 100000000L //     or, guided by pattern databases, which examine boards faster and to better effect
+#define TOO_FAR_MESSAGE "This board is too far from solved for the solver to find a shortest solution."
+#define AUTOPLAY_DELAY_NS 400000000L // Pause between frames while "solve" plays the solution back
+#define SLIDE_UP SP_SLIDE_UP // The panel below the gap moves up
+#define SLIDE_DOWN SP_SLIDE_DOWN // The panel above the gap moves down
+#define SLIDE_LEFT SP_SLIDE_LEFT // The panel right of the gap moves left
+#define SLIDE_RIGHT SP_SLIDE_RIGHT // The panel left of the gap moves right
+// Move codes are part of the engine interface; see sliding_puzzle.h.
+#define NUM_REACHABLE_STATES 181440 // 9! / 2: sliding can only reach half of all arrangements of the tiles and gap
+#define MAX_SLIDE_DISTANCE 31 // The most slides any 3x3 arrangement needs
+#define MAX_DIFFICULTY (MAX_SLIDE_DISTANCE + GAP_TILE) // Farthest slides plus a flip for each of tiles 0-7
+#define DISTANCE_BITS 5 // Bits per entry in Distance_Table.packed, enough for MAX_SLIDE_DISTANCE
+#define DISTANCES_PER_WORD (64 / DISTANCE_BITS)
+#define DIFFICULTY_ATTEMPTS 100 // Boards sampled before working from the closest to a requested difficulty
+#define DIFFICULTY_STEPS 2000 // Changes tried to the closest sample before settling for the closest board found
+#define DIFFICULTY_CHECK_SEEDS 12 // Seeds "--check-difficulty" scrambles each difficulty with
+#define MAX_TURNINGS 64 // Most ways of turning the tiles hardest_distance() keeps (those no other way beats for every goal)
+#define PCG_MULTIPLIER 6364136223846793005ULL // The LCG multiplier recommended for 64-bit PCG state
+#define PCG_STREAM 1442695040888963407ULL // Default PCG stream (any odd increment will do)
+#define SLIDE_MOVE(direction) SP_SLIDE_MOVE(direction)
+#define FLIP_MOVE(position, flip) SP_FLIP_MOVE(position, flip)
+#define KEY_BUFFER_SIZE 256 // Keystrokes read at once in keystroke mode; a burst longer than this is simply read in pieces
+#define KEYS_MOVED 0 // Outcomes of read_keys()
+#define KEYS_PROMPT 1
+#define KEYS_QUIT 2
+#define CTRL_C 3 // Keystroke mode reads these itself, since the terminal no longer turns them into a signal or end of file
+#define CTRL_D 4
+#define HISTORY_INITIAL_CAPACITY 256 // Moves the undo history holds before it first grows (it doubles each time it fills)
+#define LOG_MAGIC "SPUZLOG" // Opens every session log, followed by a version byte (the terminating null is not stored)
+#define LOG_MAGIC_LENGTH (sizeof(LOG_MAGIC) - 1)
+#define LOG_VERSION 2
+#define LOG_CODE_BITS 8 // Each logged event is one varint: milliseconds since the last event, shifted up past its code
+#define LOG_CODE_MASK ((1 << LOG_CODE_BITS) - 1)
+#define LOG_UNDO FLIP_MOVE(62, 0) // Event codes that are no move: slides only go in four directions, and a flip always flips
+#define LOG_REDO FLIP_MOVE(63, 0)
+#define MAX_VARINT_BYTES 10 // Bytes in the longest LEB128 encoding of a uint64_t
+#define MAX_BATCH_THREADS 64 // Most threads the batch modes (verify, solve, enumerate, patterns) run on, however many cores there are
+#define BATCH_CHUNK 32 // Items (boards, submissions, or bitset words) a batch thread takes from its own queue at a time
+#define BATCH_SCRAMBLE 0 // Passes of the batch thread pool (Batch_Job.pass)
+#define BATCH_VERIFY 1
+#define BATCH_SOLVE 2
+#define BATCH_EXPAND 3
+#define BATCH_PATTERN 4
+#define BITSET_WORDS ((NUM_REACHABLE_STATES + 63) / 64) // Words in a bitset of the reachable arrangements, by board_rank() / 2
+#define TABLE_FILE_NAME "sliding_puzzle.dist" // The distance table saved by "--enumerate", looked for in the current directory
+#define TABLE_MAGIC "SPUZDIST" // Opens the distance table file (the terminating null is not stored)
+#define TABLE_MAGIC_LENGTH (sizeof(TABLE_MAGIC) - 1)
+#define TABLE_VERSION 1
+#define TABLE_BYTE_ORDER 0x01020304U // Stored as the machine stores it, so that a table from the other byte order is rebuilt
+#define TABLE_HEADER_SIZE 24 // Magic, then uint32s: version (little-endian), byte-order mark, table size (little-endian), and
+                             //     4 spare; a multiple of 8, keeping the Distance_Table after it aligned when mapped
+#define PATTERN_FILE_NAME "sliding_puzzle_%dx%d.pdb" // Pattern databases saved by "--build-patterns", one file per board
+                                                     //     size (by rows and columns), looked for in the current directory
+#define PATTERN_MAGIC "SPUZPATT" // Opens every pattern database file (the terminating null is not stored)
+#define PATTERN_MAGIC_LENGTH (sizeof(PATTERN_MAGIC) - 1)
+#define PATTERN_VERSION 1
+#define PATTERN_HEADER_SIZE 64 // Magic, a little-endian uint32 version, a byte each for rows, columns, and groups, 1 spare,
+                               //     then each group's size (from byte 16) and tiles (from byte 24, MAX_PATTERN_SIZE apiece)
+#define PATTERN_LAYOUTS 2 // Board sizes with pattern databases (see pattern_layouts)
+#define MAX_PATTERN_GROUPS 5 // Most groups of tiles a board's pattern databases split it into
+#define MAX_PATTERN_SIZE 6 // Most tiles in a group
+#define PATTERN_BLOCK 64 // Placements a batch thread expands as one item while building a pattern database
+#define PATTERN_UNSEEN 255 // A table entry not reached yet
+#define ARENA_INITIAL_CAPACITY 65536 // Bytes a batch solver thread's output arena starts with (it doubles each time it fills)
+#define SOLVE_RESULT_MAX 1024 // Longest line the batch solver prints for a board, with a MAX_SOLUTION_LENGTH path
+#define VERIFY_PENDING 0 // Outcomes of verifying a submission (Submission.result)
+#define VERIFY_PASS 1
+#define VERIFY_ILLEGAL 2
+#define VERIFY_UNSOLVED 3
+#define VERIFY_UNREADABLE 4
+#define VERIFY_NO_PUZZLE 5
+#define MAX_REPLAY_PAUSE_MS 10000 // Longest pause between events when replaying on screen, however long the player paused
+#define INVERSE_MOVE(move) ((move) & 3 ? (move) : (uint8_t) ((move) ^ (1 << 2))) // A flip undoes itself; a slide is undone by
+                                                                                // the opposite slide (direction ^ 1)
 
 /* Type Definitions */
-typedef struct Panel {
+typedef struct Panel_Size {
+    int width; // Characters across every panel of a puzzle, its two edges included.
+    int height; // Lines down, its top line included.
+} Panel_Size;
+
+typedef struct Grid {
+    int rows;
+    int columns;
+    int cells; // rows * columns; the last tile (cells - 1) stands for the gap, which belongs in the last position.
+    int8_t neighbours[MAX_CELLS][4]; // For the gap in each position, the position of the panel each slide direction moves
+                                     //     into it (-1 if there is none), so no move ever has to check the board's edges.
+} Grid;
+
+typedef struct Viewport {
+    const Grid *grid; // The board being shown.
+    int first_row; // The rows and columns of panels shown, which is all of them unless the terminal is too small.
+    int rows;
+    int first_column;
+    int columns;
+    bool sidebar; // Whether the sidebar is shown beside them (only when every column fits with it).
+} Viewport;
+
+typedef struct Display {
+    Viewport view; // The part of the board composed, as update_viewport() chose it.
+    int lines; // Lines in use: a panel's height for each row of panels shown, and the final line.
+    int panel_width; // Characters across each panel, the segments that draw_display() compares.
+    int lengths[MAX_DISPLAY_LINES]; // Characters in each line; the sidebar lengthens the last two rows of panels.
+    char text[MAX_DISPLAY_LINES][MAX_DISPLAY_WIDTH + 1]; // Each line, null-terminated.
+} Display;
+
+typedef struct Board {
     /*
-     * Position diagram:
+     * Positions count left to right, top to bottom; on a 3x3 board:
      *  0 1 2
      *  3 4 5
      *  6 7 8
      */
-    int position;
-    bool is_gap;
-    char row0[ROW_WIDTH + 1]; // "+ 1" is for the null character
-    char row1[ROW_WIDTH + 1];
-    char row2[ROW_WIDTH + 1];
-    char row3[ROW_WIDTH + 1];
-    char row4[ROW_WIDTH + 1];
-    char row5[ROW_WIDTH + 1];
-    char row6[ROW_WIDTH + 1];
-    char row7[ROW_WIDTH + 1];
-    char row8[ROW_WIDTH + 1];
-    char row9[ROW_WIDTH + 1];
-    char row10[ROW_WIDTH + 1];
-    char row11[ROW_WIDTH + 1];
-} Panel;
-
-typedef struct Panel_Row {
-    char row0[ROW_WIDTH * 3 + 1]; // "* 3" for three panels, "+ 1" for the null char
-    char row1[ROW_WIDTH * 3 + 1];
-    char row2[ROW_WIDTH * 3 + 1];
-    char row3[ROW_WIDTH * 3 + 1];
-    char row4[ROW_WIDTH * 3 + 1];
-    char row5[ROW_WIDTH * 3 + 1];
-    char row6[ROW_WIDTH * 3 + 1];
-    char row7[ROW_WIDTH * 3 + 1];
-    char row8[ROW_WIDTH * 3 + 1];
-    char row9[ROW_WIDTH * 3 + 1];
-    char row10[ROW_WIDTH * 3 + 1];
-    char row11[ROW_WIDTH * 3 + 1];
-} Panel_Row;
-
-typedef struct Panel_Row_Plus_Side_Panel {
-    char row0[ROW_WIDTH * 3 + 3 + ROW_WIDTH + 1]; // "+ 3 + ROW_WIDTH" is for a 3-space gap and the final panel out to the side
-    char row1[ROW_WIDTH * 3 + 3 + ROW_WIDTH + 1];
-    char row2[ROW_WIDTH * 3 + 3 + ROW_WIDTH + 1];
-    char row3[ROW_WIDTH * 3 + 3 + ROW_WIDTH + 1];
-    char row4[ROW_WIDTH * 3 + 3 + ROW_WIDTH + 1];
-    char row5[ROW_WIDTH * 3 + 3 + ROW_WIDTH + 1];
-    char row6[ROW_WIDTH * 3 + 3 + ROW_WIDTH + 1];
-    char row7[ROW_WIDTH * 3 + 3 + ROW_WIDTH + 1];
-    char row8[ROW_WIDTH * 3 + 3 + ROW_WIDTH + 1];
-    char row9[ROW_WIDTH * 3 + 3 + ROW_WIDTH + 1];
-    char row10[ROW_WIDTH * 3 + 3 + ROW_WIDTH + 1];
-    char row11[ROW_WIDTH * 3 + 3 + ROW_WIDTH + 1];
-} Panel_Row_Plus_Side_Panel;
-
-typedef struct Panel_All {
-    Panel_Row top;
-    Panel_Row middle;
-    Panel_Row bottom;
-    char final_row[ROW_WIDTH * 3 + 1];
-} Panel_All;
-
-typedef struct Panel_All_Plus_Side_Panel {
-    Panel_Row top;
-    Panel_Row_Plus_Side_Panel middle;
-    Panel_Row_Plus_Side_Panel bottom;
-    char final_row[ROW_WIDTH * 3 + 3 + ROW_WIDTH + 1];
-} Panel_All_Plus_Side_Panel;
+    const Grid *grid; // The board's size and neighbour table.
+    int gap; // Position of the gap, tracked so that slides never have to search for it.
+    uint8_t tiles[MAX_CELLS]; // Index of the tile at each position (tile t belongs in position t).
+    uint8_t orientations[MAX_CELLS]; // Orientation bits of each tile, indexed by tile.
+} Board;
+
+typedef struct Tile_Atlas {
+    char *art; // Every panel the puzzle shows, PANEL_STRIDE() apart in a single cache-aligned block (see atlas_panel()): each
+               //     tile's art in every orientation, by tile and then by orientation bits, then the panels from ATLAS_GAP() on.
+    Panel_Size size;
+    uint8_t matches[MAX_CELLS][MAX_CELLS]; // Bit o of matches[t][p] is set if tile t in orientation o reproduces the
+                                           //     solution art of position p, so tiles with identical art are interchangeable.
+    const Grid *grid; // The puzzle's size.
+} Tile_Atlas;
+
+typedef struct Solution {
+    int length;
+    int next; // Index of the next move to be played back by the "solve" command.
+    uint8_t moves[MAX_SOLUTION_LENGTH];
+} Solution;
+
+typedef struct Search {
+    const Tile_Atlas *atlas;
+    Board board; // The board being searched, altered and restored move by move.
+    int goal_count; // Number of reachable goal arrangements (tiles with identical art can trade places),
+                    //     or more than MAX_GOALS if there are too many to track separately.
+    int goals[MAX_GOALS + 1][MAX_CELLS]; // Each goal arrangement's position for each tile
+                                         //     (-1 for the gap, or for a tile whose art fits several positions).
+    uint8_t cost[MAX_GOALS][MAX_CELLS][MAX_CELLS]; // Lower bound on the moves tile t still needs in position p, per goal.
+    int bound; // Current IDA* cost bound.
+    int next_bound; // Smallest cost seen beyond the current bound.
+    int length; // Number of slides in the solution, once found.
+    long nodes; // Boards examined so far; the search gives up beyond node_limit
+    long node_limit; //     (SOLVER_NODE_LIMIT, or PATTERN_NODE_LIMIT with pattern databases).
+    const struct Pattern_Database *patterns; // The board size's pattern databases, if it has them and every tile has
+                                             //     a goal position (see pattern_estimate()), or NULL.
+    int flips[MAX_GOALS]; // For pattern_estimate(): the flips each goal arrangement needs, which no slide changes.
+    int8_t pattern_groups[MAX_CELLS]; //     the group of the tile that belongs in each position (-1 for none),
+    int homes[MAX_GOALS][MAX_CELLS]; //     where that tile is now, for each goal arrangement,
+    uint8_t group_costs[MAX_GOALS][2][MAX_PATTERN_GROUPS]; //     each group's entry, looked up directly and reflected,
+    int pattern_sums[MAX_GOALS][2]; //     the sums of both,
+    uint8_t stale[MAX_GOALS][2]; //     and a bit for each group whose entry has changed since pattern_estimate() last
+                                 //     looked it up (see solver_slide()).
+    int8_t fits[MAX_CELLS][MAX_CELLS]; // Flips tile t would need to finish in position p (-1 if its art fits p no way up),
+    int misfits; //     how many tiles (the gap among them) are now where their art doesn't fit,
+    int fit_flips; //     and the flips the others need, all kept up to date by solver_slide().
+    uint8_t path[MAX_SOLUTION_LENGTH];
+} Search;
+
+typedef struct Distance_Table {
+    uint64_t packed[(NUM_REACHABLE_STATES + DISTANCES_PER_WORD - 1) / DISTANCES_PER_WORD]; // Slides needed to solve each
+                                                                                           //     arrangement, DISTANCE_BITS
+                                                                                           //     apiece, by board_rank() / 2.
+    uint32_t by_distance[NUM_REACHABLE_STATES]; // The board_rank() of every arrangement, nearest to farthest (BFS order).
+    int first[MAX_SLIDE_DISTANCE + 2]; // Index in by_distance of the first arrangement at each distance.
+} Distance_Table;
+
+typedef struct Mapped_File {
+    const char *data; // The file's contents, mapped read-only into memory.
+    size_t size;
+} Mapped_File;
+
+typedef struct Pattern_Layout {
+    int rows;
+    int columns;
+    int group_count;
+    int sizes[MAX_PATTERN_GROUPS];
+    int8_t tiles[MAX_PATTERN_GROUPS][MAX_PATTERN_SIZE]; // Each group's tiles; a tile's goal is the position of its number.
+} Pattern_Layout;
+
+typedef struct Pattern_Database {
+    const Pattern_Layout *layout;
+    const uint8_t *costs[MAX_PATTERN_GROUPS]; // Each group's table: the fewest moves of the group's own tiles that bring
+                                              //     them home, by pattern_rank() of the positions they are in.
+    Mapped_File file;
+} Pattern_Database;
+
+typedef struct Pack_Source {
+    const char *filename;
+    int status; // SOURCE_VALID, or why the file can't go into the pack.
+    long error_offset; // For SOURCE_FORMAT_ERROR: the first invalid byte, and its line and column.
+    long line;
+    long column;
+    const Grid *grid; // For SOURCE_VALID: the puzzle's size, the size of its panels,
+    Panel_Size size;
+    char *tiles; //     each panel's tile block, as stored in a pack, back to back (NULL if there wasn't memory for them),
+    uint64_t hashes[MAX_CELLS]; //     and hash_tile() of each tile block.
+} Pack_Source;
+
+typedef struct Pack_Job {
+    Pack_Source *sources;
+    int count;
+    int next; // Index of the next source for a thread to claim; guarded by "lock".
+    pthread_mutex_t lock;
+} Pack_Job;
+
+typedef struct Frame {
+    Display shown; // The display as last drawn on the terminal.
+    bool valid; // Whether the terminal still shows it, or something else has taken over the screen since.
+    bool synchronized; // Whether to wrap each frame in SYNC_BEGIN and SYNC_END (only when writing to a terminal).
+    size_t used; // Bytes of the next frame composed so far.
+    char out[FRAME_BUFFER_SIZE]; // The next frame, composed in full and then sent with a single write().
+} Frame;
+
+typedef struct Rng {
+    uint64_t state; // PCG32 generator state; a given seed always produces the same sequence of scrambles.
+    uint64_t increment; // Selects the PCG stream; always odd.
+} Rng;
+
+typedef struct History {
+    uint8_t *moves; // Ring buffer of move codes, oldest first from "first" (NULL until the first move).
+    size_t capacity; // Always 0 or a power of two, so ring positions wrap with a mask.
+    size_t first; // Ring position of the oldest move remembered.
+    size_t count; // Moves that can be undone, from the oldest on.
+    size_t undone; // Moves after those that have been undone and can be redone, in order.
+} History;
+
+struct Sp_State {
+    Tile_Atlas atlas; // The puzzle's art in every orientation; never altered once built.
+    Board board;
+    const char *final_piece_text; // The sidebar, above and below "Final Piece:" (panels of the atlas).
+    const char *final_piece;
+    Display display; // The display as last composed by update_display() (not kept up to date by moves).
+    Rng rng;
+    const Distance_Table *table; // Opened the first time a difficulty is asked for (NULL until then).
+    Mapped_File table_file; // The saved table that "table" points into, if it was mapped rather than built.
+    int distance; // Moves from solved the last scramble to a difficulty reached, which may fall short of the difficulty
+                  //     (-1 for other scrambles, and on boards other than 3x3, whose random walks are never measured).
+    int correct; // Positions showing their solution art (counting the gap in the last position); all of them once solved.
+                 //     Kept up to date move by move, so that no art is compared during play.
+    History history; // Every move since the scramble, a byte apiece, for undo and redo.
+    FILE *log; // Session log that every move, undo, and redo is recorded in (NULL when not recording).
+    struct timespec log_time; // When the last event was recorded.
+};
+
+typedef struct Submission {
+    long line; // Line of the input the submission is on.
+    long scramble; // Index of its board among the distinct boards to scramble (-1 if it can't be verified at all).
+    const char *moves; // The moves, in the short form of command_to_moves() (null-terminated).
+    int result; // VERIFY_PENDING until verified, then how it turned out.
+    long move_count; // Moves in the submission (for VERIFY_ILLEGAL, the number of the one that can't be made).
+} Submission;
+
+typedef struct Scramble {
+    int puzzle; // Index among the puzzles loaded.
+    uint64_t seed;
+    int difficulty;
+    Board board; // The board the game scrambles to from this seed and difficulty, once worked out.
+} Scramble;
+
+typedef struct Verify_Puzzle {
+    char name[MAX_LINE + 1]; // As given in the submissions ("-" for the default puzzle).
+    long pack_puzzle;
+    Sp_State *state; // The loaded puzzle, copied by each thread that uses it (NULL if it can't be loaded).
+} Verify_Puzzle;
+
+typedef struct Solve_Task {
+    long line; // Line of the input the board is on.
+    bool readable; // Whether the line holds a board.
+    Board board;
+    int distance; // The length of a shortest solution, once solved (-1 if there is none, or the search gave up).
+    bool gave_up; // Whether the search gave up on it (see SOLVER_NODE_LIMIT), though a solution exists.
+    int thread; // The thread that solved it, in whose arena its result line is.
+    size_t offset; // Where in that arena the result line starts, and how long it is.
+    size_t length;
+} Solve_Task;
+
+typedef struct Arena {
+    char *data; // Result lines, back to back (NULL until the first).
+    size_t used;
+    size_t capacity;
+    bool failed; // Whether it ever ran out of memory, leaving some results out.
+} Arena;
+
+typedef struct Batch_Queue {
+    pthread_mutex_t lock; // Guards "next" and "end", which the owning thread and thieves both change.
+    long next; // First item (board or submission) not yet taken.
+    long end; // One past the last.
+} Batch_Queue;
+
+typedef struct Batch_Job { // Too large for the stack, with its per-thread arrays, so each batch mode keeps its job static.
+    Submission *submissions;
+    Scramble *scrambles;
+    const Verify_Puzzle *puzzles;
+    int pass; // What the threads are doing: BATCH_SCRAMBLE, BATCH_VERIFY, BATCH_SOLVE, BATCH_EXPAND, or BATCH_PATTERN.
+    int thread_count; // Threads in the current pass.
+    int max_threads; // Threads with a scratch state and move buffer.
+    Batch_Queue queues[MAX_BATCH_THREADS]; // Each thread's share of the items, taken from the front by its owner
+                                           //     and from the back by threads that have run out.
+    Sp_State *scratch[MAX_BATCH_THREADS]; // Each thread's own copy of the puzzle it is working on.
+    int current[MAX_BATCH_THREADS]; // The puzzle in each thread's scratch state (-1 for none yet).
+    uint8_t *moves[MAX_BATCH_THREADS]; // Each thread's buffer of move codes, "capacity" long.
+    int capacity;
+    Solve_Task *tasks; // For BATCH_SOLVE: the boards to solve, and the art that decides when they are solved.
+    const Tile_Atlas *atlas;
+    const Distance_Table *table; // The distance table for 3x3 boards, for solve_board() to look slides up in (or NULL).
+    Arena arenas[MAX_BATCH_THREADS]; // Each solver thread's own scratch for its result lines, so no thread waits on another.
+    const uint64_t *frontier; // For BATCH_EXPAND: the breadth-first layer being expanded, a bit per arrangement,
+    uint64_t *reached[MAX_BATCH_THREADS]; //     and each thread's own bitset of the arrangements one slide from it.
+    const Grid *grid; // For BATCH_PATTERN: the board size and group whose pattern database table is being built,
+    int group_size;
+    long placements; //     how many placements the group has,
+    int cost; //     the cost of the layer being expanded,
+    _Atomic uint32_t *layer; //     the gap positions (a bit apiece) to expand from with each placement, at this cost
+    _Atomic uint32_t *next_layer; //     and the next (added to by every thread),
+    uint32_t *placed; //     the gap positions each placement has already been expanded from,
+    uint8_t *costs; //     the table,
+    long expanded[MAX_BATCH_THREADS]; //     and how many placements each thread expanded in the layer.
+} Batch_Job;
+
+typedef struct Batch_Worker {
+    Batch_Job *job;
+    int index; // Which queue, scratch state, and buffer are this thread's.
+} Batch_Worker;
+
+_Static_assert(SP_RENDER_SIZE == MAX_DISPLAY_LINES * (MAX_DISPLAY_WIDTH + 1) + 1,
+               "SP_RENDER_SIZE must hold every line of the largest display, its new-line, and a terminating null");
+_Static_assert(FLIP_MOVE(MAX_CELLS - 1, ROTATE) == 255, "Move codes must have room for flipping every position");
 
 /* Declarations of External Variables */
-// none
+static Grid grids[MAX_GRID_SIDE - MIN_GRID_SIDE + 1][MAX_GRID_SIDE - MIN_GRID_SIDE + 1]; // Every size of board, by rows and
+                                                                                        //     columns (see grid_of())
+static const Pattern_Layout pattern_layouts[PATTERN_LAYOUTS] = {
+    {4, 4, 3, {6, 6, 3}, {{0, 1, 4, 5, 8, 9}, {2, 3, 6, 7, 10, 11}, {12, 13, 14}}}, // Two 2x3 blocks and the bottom row
+    {5, 5, 5, {5, 5, 5, 5, 4}, {{0, 1, 2, 5, 6}, {3, 4, 7, 8, 9}, {10, 11, 15, 16, 20}, {12, 13, 14, 17, 18}, {19, 21, 22, 23}}}
+};
+static Pattern_Database pattern_databases[PATTERN_LAYOUTS]; // Each layout's tables, once mapped (see pattern_database())
 
 /* Prototypes for non-main functions */
-void play_game(FILE *picture_file, int selection);
-bool check_formatting(FILE *picture_file, long *offset);
-Panel_All store_picture_heart(Panel *panel0, Panel *panel1, Panel *panel2,
-                              Panel *panel3, Panel *panel4, Panel *panel5,
-                              Panel *panel6, Panel *panel7, Panel *panel8);
-Panel blank_panel(void);
-Panel_Row assemble_panel_row(Panel panel0, Panel panel1, Panel panel2);
-Panel_All assemble_panel_all(Panel_Row top, Panel_Row middle, Panel_Row bottom);
-Panel_All store_picture_from_file(FILE *picture_file, long *offset,
-                                  Panel *panel0, Panel *panel1, Panel *panel2,
-                                  Panel *panel3, Panel *panel4, Panel *panel5,
-                                  Panel *panel6, Panel *panel7, Panel *panel8);
-void print_panel_all(Panel_All pa);
-void print_panel_row(Panel_Row pr);
-Panel_All_Plus_Side_Panel scramble_puzzle(Panel *panel0, Panel *panel1, Panel *panel2,
-                                          Panel *panel3, Panel *panel4, Panel *panel5,
-                                          Panel *panel6, Panel *panel7, Panel *panel8,
-                                          Panel_Row *top, Panel_Row *middle, Panel_Row *bottom,
-                                          Panel_Row_Plus_Side_Panel *middle_and_side, Panel_Row_Plus_Side_Panel *bottom_and_side,
-                                          Panel *final_piece_text, Panel *final_piece);
-Panel flip_panel_over_x(Panel p);
-Panel flip_panel_over_y(Panel p);
-char *reverse(char *reversed_string_holder, char *string);
-Panel_Row_Plus_Side_Panel add_side_panel(Panel_Row pr, Panel side_panel);
-Panel_All_Plus_Side_Panel assemble_all_plus_side(Panel_Row top, Panel_Row_Plus_Side_Panel middle, Panel_Row_Plus_Side_Panel bottom, int gap);
-void print_all_plus_side(Panel_All_Plus_Side_Panel paplus);
-void print_row_plus_side(Panel_Row_Plus_Side_Panel prplus);
+void play_game(Mapped_File *picture_file, const char *picture_name, int selection, uint64_t seed, int difficulty, bool keys,
+               const char *log_name);
+long check_formatting(const Mapped_File *picture_file, long *offset, const Grid **grid, Panel_Size *size);
+bool read_panel_size(const Mapped_File *picture_file, Panel_Size *size);
+bool panel_size_fits(const Grid *grid, Panel_Size size);
+bool is_panel_top(const char *text, int width);
+const Grid *store_picture_heart(char tiles[], Panel_Size *size);
+void blank_panel(char *panel, Panel_Size size, bool top, bool sides);
+void panel_top(char *line, int width);
+void store_picture_from_file(const Mapped_File *picture_file, long offset, const Grid *grid, Panel_Size size, char tiles[]);
+const Grid *store_picture_from_pack(const Mapped_File *pack, uint32_t puzzle, char tiles[], Panel_Size *size);
+int print_picture(FILE *file, const Grid *grid, Panel_Size size, const char *panels[]);
+void print_solution(const Tile_Atlas *atlas);
+void scramble_puzzle(const Tile_Atlas *atlas, Board *board, const char **final_piece_text, const char **final_piece,
+                     Display *display, Rng *rng, const Distance_Table *table, int difficulty);
+void flip_panel_over_x(char *flipped, const char *panel, Panel_Size size);
+void flip_panel_over_y(char *flipped, const char *panel, Panel_Size size);
+void mirror_line(char *mirrored, const char *line, int width);
+void mirror_line_scalar(char *mirrored, const char *line, int width);
 int read_line(char *input, int n);
-bool parse_command(char *command, int n, Panel_All solution,
-                   Panel *panel0, Panel *panel1, Panel *panel2,
-                   Panel *panel3, Panel *panel4, Panel *panel5,
-                   Panel *panel6, Panel *panel7, Panel *panel8,
-                   bool *submit);
+bool parse_command(char *command, int n, Sp_State *state, Solution *autoplay, bool *submit, bool *repaint);
 bool caseless_cmp(char str1[], char str2[]);
 void print_command_listing(void);
-void print_numbers(void);
-bool caseless_skip_digit_cmp_no9(char str1[], char str2[]);
-Panel_All_Plus_Side_Panel update_display(Panel *panel0, Panel *panel1, Panel *panel2,
-                                         Panel *panel3, Panel *panel4, Panel *panel5,
-                                         Panel *panel6, Panel *panel7, Panel *panel8,
-                                         Panel_Row *top, Panel_Row *middle, Panel_Row *bottom,
-                                         Panel_Row_Plus_Side_Panel *middle_and_side, Panel_Row_Plus_Side_Panel *bottom_and_side,
-                                         Panel *final_piece_text, Panel *final_piece);
-bool check_answer(Panel *panel0, Panel *panel1, Panel *panel2,
-                  Panel *panel3, Panel *panel4, Panel *panel5,
-                  Panel *panel6, Panel *panel7, Panel *panel8,
-                  Panel *solution_panel0, Panel *solution_panel1, Panel *solution_panel2,
-                  Panel *solution_panel3, Panel *solution_panel4, Panel *solution_panel5,
-                  Panel *solution_panel6, Panel *solution_panel7, Panel *solution_panel8);
-bool compare_panels(Panel a, Panel b);
+void print_numbers(const Grid *grid, Panel_Size size);
+void update_display(const Tile_Atlas *atlas, const Board *board, const char *final_piece_text, const char *final_piece,
+                    const Viewport *view, Display *display);
+Viewport full_view(const Grid *grid);
+void update_viewport(Viewport *view, const Grid *grid, Panel_Size size, int focus);
+bool same_view(const Viewport *a, const Viewport *b);
+bool check_answer(const Tile_Atlas *atlas, const Board *board);
+bool compare_panels(const char *a, const char *b, Panel_Size size);
+bool panels_equal(const char *a, const char *b, size_t stride);
+bool panels_equal_scalar(const char *a, const char *b, size_t stride);
 void export_template(void);
-Panel_All make_template(void);
-int print_panel_all_to_file(FILE *filename, Panel_All pa);
-int print_panel_row_to_file(FILE *filename, Panel_Row pr);
+int print_template(FILE *file, const Grid *grid, Panel_Size size);
+Board solved_board(const Grid *grid);
+bool board_same(const Board *a, const Board *b);
+int board_tile_at(const Board *board, int position);
+int board_orientation(const Board *board, int tile);
+bool board_apply(Board *board, uint8_t move);
+const Grid *grid_of(int rows, int columns);
+void build_grids(void);
+bool build_atlas(Tile_Atlas *atlas, const Grid *grid, Panel_Size size, const char tiles[]);
+char *atlas_panel(const Tile_Atlas *atlas, int panel);
+bool solve_board(const Tile_Atlas *atlas, const Distance_Table *table, const Board *board, Solution *solution);
+void finish_solution(const Search *search, Solution *solution);
+bool board_solvable(const Tile_Atlas *atlas, const Board *board);
+bool table_solves(const Tile_Atlas *atlas);
+bool assign_positions(const Tile_Atlas *atlas, const int tile_positions[], int target[], bool used[], int tile, int parity,
+                      Search *search);
+bool solver_search(Search *search, int depth, const int distances[], int last_direction);
+void solver_slide(Search *search, int tile, int from, int to);
+int linear_conflicts(const Search *search, int goal);
+int line_conflicts(const int line[], int count);
+int placement_flips(const Search *search);
+int pattern_estimate(Search *search, int goal);
+int pattern_cost(const Search *search, int goal, int group, bool reflected);
+char *move_to_command(char *command, uint8_t move);
+void rng_seed(Rng *rng, uint64_t seed);
+uint32_t rng_next(Rng *rng);
+uint32_t rng_below(Rng *rng, uint32_t bound);
+uint32_t board_rank(const Board *board);
+Board board_unrank(uint32_t rank);
+void build_distance_table(Distance_Table *table);
+int table_distance(const Distance_Table *table, const Board *board);
+int goal_distance(const Distance_Table *table, const Board *board, const int goal[]);
+Board board_at_difficulty(const Tile_Atlas *atlas, const Distance_Table *table, Rng *rng, int difficulty);
+void draw_display(Frame *frame, const Display *display);
+void frame_append(Frame *frame, const char *text, size_t length);
+void frame_send(Frame *frame);
+bool map_file(const char *filename, Mapped_File *file);
+int unmap_file(Mapped_File *file);
+uint32_t read_le32(const char *bytes);
+bool is_pack(const Mapped_File *file);
+bool check_pack(const Mapped_File *pack);
+const char *pack_entry(const Mapped_File *pack, uint32_t puzzle);
+void locate_byte(const Mapped_File *file, long byte, long *line, long *column);
+void compile_pack(const char *pack_name, int file_count, char *filenames[]);
+void *validate_sources(void *job);
+void validate_source(Pack_Source *source);
+uint64_t hash_tile(const char *tile, size_t length);
+void write_le32(char *bytes, uint32_t value);
+bool command_to_move(char *command, int n, uint8_t *move);
+void run_script(const char *script_name, const char *puzzle_name, long pack_puzzle, uint64_t seed, int difficulty);
+int read_script_line(FILE *script, char input[], int n);
+bool load_puzzle(const char *puzzle_name, long pack_puzzle, char tiles[], const Grid **grid, Panel_Size *size);
+Sp_State *create_state(const char tiles[], const Grid *grid, Panel_Size size);
+void make_sidebar(const Tile_Atlas *atlas, const char **final_piece_text, const char **final_piece);
+const Distance_Table *state_table(Sp_State *state);
+int count_correct(const Tile_Atlas *atlas, const Board *board);
+int tile_correct(const Tile_Atlas *atlas, const Board *board, int position);
+int command_to_moves(const char *command, uint8_t moves[], int capacity);
+void set_raw_input(bool raw);
+void restore_input(void);
+int read_keys(Sp_State *state, int *panel);
+bool apply_move(Sp_State *state, uint8_t move);
+void history_push(History *history, uint8_t move);
+bool write_varint(FILE *file, uint64_t value);
+bool read_varint(const char **cursor, const char *end, uint64_t *value);
+bool start_recording(Sp_State *state, const char *log_name, const char *puzzle_name, long pack_puzzle, uint64_t seed,
+                     int difficulty);
+void record_event(Sp_State *state, uint8_t code);
+double elapsed_seconds(const struct timespec *started, const struct timespec *finished);
+void run_replay(const char *log_name, const char *puzzle_name, long pack_puzzle, double speed);
+void verify_batch(const char *submissions_name);
+char *read_all(FILE *file, size_t *size);
+int batch_thread_count(void);
+void run_batch_pass(Batch_Job *job, Batch_Worker workers[], int pass, long count);
+void *batch_items(void *worker);
+bool steal_items(Batch_Job *job, int thief);
+Sp_State *scratch_state(Batch_Job *job, int thread, int puzzle);
+void scramble_board(Batch_Job *job, int thread, Scramble *scramble);
+void verify_submission(Batch_Job *job, int thread, Submission *submission);
+void solve_batch(const char *boards_name, const char *puzzle_name, long pack_puzzle);
+bool parse_board(const char *text, const Grid *grid, Board *board);
+void solve_task(Batch_Job *job, int thread, Solve_Task *task);
+char *arena_reserve(Arena *arena, size_t size);
+void enumerate_states(void);
+void expand_word(Batch_Job *job, int thread, long word);
+Board reachable_board(uint32_t index);
+const Distance_Table *open_distance_table(Mapped_File *file);
+void close_distance_table(const Distance_Table *table, Mapped_File *file);
+void build_patterns(void);
+int build_pattern_group(Batch_Job *job, Batch_Worker workers[], const Grid *grid, const int8_t tiles[], int size,
+                        uint8_t *costs);
+void expand_placements(Batch_Job *job, int thread, long block);
+uint32_t pattern_rank(const int positions[], int size, int cells);
+void pattern_unrank(uint32_t rank, int size, int cells, int positions[]);
+long pattern_entries(int cells, int size);
+void pattern_header(char header[], const Pattern_Layout *layout);
+void open_pattern_databases(void);
+const Pattern_Database *pattern_database(const Grid *grid);
+void bench_kernels(void);
+int hardest_distance(const Tile_Atlas *atlas, const Distance_Table *table);
+void check_difficulty(const char *puzzle_name, long pack_puzzle);
 
 /* Definition of main */
-/********************************************************************************************************
- * main():              Purpose: Run main menu loop, handle file opening/exporting, and run play_game() *
- *                      Parameters: none                                                                *
- *                      Return value: int                                                               *
- *                      Side effects: - prints to stdout                                                *
- *                                    - reads from stdin                                                *
- *                                    - terminates program                                              *
- *                                    - clears CLI screen and scrollback                                *
- *                                    - reads and writes external files                                 *
- ********************************************************************************************************/
-int main(void)
+#ifndef SP_LIBRARY // Leave out the front end when building the engine as a library (see sliding_puzzle.h).
+/**************************************************************************************************************************
+ * main():              Purpose: Run main menu loop, handle file opening/exporting, and run play_game()                   *
+ *                      Parameters: - int argc --> the number of command-line arguments                                   *
+ *                                  - char *argv[] --> the command-line arguments; "--seed <number>" fixes the scramble   *
+ *                                      so that the same board can be played (or benchmarked) again, and                  *
+ *                                      "--difficulty <moves>" scrambles that many moves from solved, or as near as the   *
+ *                                      puzzle's art allows (see board_at_difficulty()),                                  *
+ *                                      "--keys" plays by keystroke rather than by command line (see read_keys()),        *
+ *                                      "--record <log>" records the game as a session log, "--replay <log>" replays one  *
+ *                                      headlessly or, with "--speed <factor>", on screen (see run_replay()),             *
+ *                                      "--script <file>" plays a file of commands headlessly (see run_script()),         *
+ *                                      "--verify <file>" checks a batch of solutions (see verify_batch()),               *
+ *                                      "--solve-batch <file>" solves a batch of boards (see solve_batch()),              *
+ *                                      "--enumerate" reports on every reachable board and saves the distance table       *
+ *                                      (see enumerate_states()), "--build-patterns" saves the pattern databases the      *
+ *                                      solver uses on larger boards (see build_patterns()), "--bench-kernels" times the  *
+ *                                      tile kernels (see bench_kernels()), "--check-difficulty" checks the scrambles to  *
+ *                                      every difficulty (see check_difficulty()), and                                    *
+ *                                      "--compile-pack <pack> <files...>" compiles custom puzzles into a pack instead    *
+ *                      Return value: int                                                                                 *
+ *                      Side effects: - prints to stdout                                                                  *
+ *                                    - reads from stdin                                                                  *
+ *                                    - terminates program                                                                *
+ *                                    - clears CLI screen and scrollback                                                  *
+ *                                    - reads and writes external files                                                   *
+ **************************************************************************************************************************/
+int main(int argc, char *argv[])
 {
     int selection;
-    FILE *picture_file = NULL;
+    Mapped_File picture_file;
     char user_text[MAX_LINE] = {0};
     int fclose_return;
+    uint64_t seed = (uint64_t) time(NULL);
+    int difficulty = -1; // -1 for a uniformly random scramble.
+    char *end;
+    const char *script_name = NULL; // Headless mode's command file ("-" for stdin), or NULL to play interactively.
+    const char *puzzle_name = NULL; // Headless mode's puzzle file or pack, or NULL for the default puzzle.
+    long pack_puzzle = 1;
+    bool keys = false; // Whether to play by keystroke (only possible when stdin is a terminal).
+    const char *log_name = NULL; // Session log to record the game in, or NULL not to record.
+    const char *replay_name = NULL; // Session log to replay instead of playing, or NULL to play.
+    const char *verify_name = NULL; // Submissions to verify instead of playing ("-" for stdin), or NULL to play.
+    const char *boards_name = NULL; // Boards to solve instead of playing ("-" for stdin), or NULL to play.
+    bool check = false; // Whether to check the scrambles to every difficulty instead of playing.
+    double speed = 0; // Replay's playback speed, as a multiple of real time (0 to replay headlessly, at full speed).
+
+    // Command-line options:
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc && isdigit((unsigned char) argv[i + 1][0]))
+        {
+            seed = strtoull(argv[++i], &end, 10);
+            if (*end == '\0')
+                continue;
+        }
+        else if (strcmp(argv[i], "--difficulty") == 0 && i + 1 < argc && isdigit((unsigned char) argv[i + 1][0]))
+        {
+            difficulty = (int) strtol(argv[++i], &end, 10);
+            if (*end == '\0' && difficulty <= MAX_DIFFICULTY)
+                continue;
+        }
+        else if (strcmp(argv[i], "--keys") == 0)
+        {
+            keys = true;
+            continue;
+        }
+        else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc)
+        {
+            log_name = argv[++i];
+            continue;
+        }
+        else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc)
+        {
+            replay_name = argv[++i];
+            continue;
+        }
+        else if (strcmp(argv[i], "--speed") == 0 && i + 1 < argc && isdigit((unsigned char) argv[i + 1][0]))
+        {
+            speed = strtod(argv[++i], &end);
+            if (*end == '\0' && speed > 0)
+                continue;
+        }
+        else if (strcmp(argv[i], "--verify") == 0 && i + 1 < argc)
+        {
+            verify_name = argv[++i];
+            continue;
+        }
+        else if (strcmp(argv[i], "--solve-batch") == 0 && i + 1 < argc)
+        {
+            boards_name = argv[++i];
+            continue;
+        }
+        else if (strcmp(argv[i], "--enumerate") == 0)
+        {
+            enumerate_states();
+            return 0;
+        }
+        else if (strcmp(argv[i], "--build-patterns") == 0)
+        {
+            build_patterns();
+            return 0;
+        }
+        else if (strcmp(argv[i], "--bench-kernels") == 0)
+        {
+            bench_kernels();
+            return 0;
+        }
+        else if (strcmp(argv[i], "--check-difficulty") == 0)
+        {
+            check = true;
+            continue;
+        }
+        else if (strcmp(argv[i], "--script") == 0 && i + 1 < argc)
+        {
+            script_name = argv[++i];
+            continue;
+        }
+        else if (strcmp(argv[i], "--puzzle") == 0 && i + 1 < argc)
+        {
+            puzzle_name = argv[++i];
+            continue;
+        }
+        else if (strcmp(argv[i], "--pack-puzzle") == 0 && i + 1 < argc && isdigit((unsigned char) argv[i + 1][0]))
+        {
+            pack_puzzle = strtol(argv[++i], &end, 10);
+            if (*end == '\0' && pack_puzzle >= 1)
+                continue;
+        }
+        else if (strcmp(argv[i], "--compile-pack") == 0 && i + 2 < argc)
+        {
+            // Every remaining argument is a puzzle file to compile:
+            compile_pack(argv[i + 1], argc - i - 2, argv + i + 2);
+            return 0;
+        }
+        (void) printf("Error 19: Invalid command-line argument \"%s\".\n", argv[i]);
+        (void) printf("Usage: %s [--seed <number>] [--difficulty <moves, 0-%d as the art allows>] [--keys] [--record <log>]\n", argv[0],
+                      MAX_DIFFICULTY);
+        (void) printf("       %s --script <commands, or - for stdin> [--puzzle <file>] [--pack-puzzle <number>]\n", argv[0]);
+        (void) printf("       %s --replay <log> [--speed <factor>] [--puzzle <file>] [--pack-puzzle <number>]\n", argv[0]);
+        (void) printf("       %s --verify <submissions, or - for stdin>\n", argv[0]);
+        (void) printf("       %s --solve-batch <boards, or - for stdin> [--puzzle <file>] [--pack-puzzle <number>]\n", argv[0]);
+        (void) printf("       %s --enumerate\n", argv[0]);
+        (void) printf("       %s --build-patterns\n", argv[0]);
+        (void) printf("       %s --bench-kernels\n", argv[0]);
+        (void) printf("       %s --check-difficulty [--puzzle <file>] [--pack-puzzle <number>]\n", argv[0]);
+        (void) printf("       %s --compile-pack <pack> <puzzle files...>\n", argv[0]);
+        exit(19);
+    }
+    if (script_name != NULL)
+    {
+        run_script(script_name, puzzle_name, pack_puzzle, seed, difficulty);
+        return 0;
+    }
+    if (boards_name != NULL)
+    {
+        solve_batch(boards_name, puzzle_name, pack_puzzle);
+        return 0;
+    }
+    if (check)
+    {
+        check_difficulty(puzzle_name, pack_puzzle);
+        return 0;
+    }
+    if (verify_name != NULL)
+    {
+        verify_batch(verify_name);
+        return 0;
+    }
+    if (replay_name != NULL)
+    {
+        run_replay(replay_name, puzzle_name, pack_puzzle, speed);
+        return 0;
+    }
+    keys = keys && isatty(STDIN_FILENO); // Piped input goes on being read a line at a time.
 
     // Main menu loop:
     do
@@ -186,31 +786,35 @@ int main(void)
             selection = 0; // Without this line, nonnumeric input would cause the selection from the previous loop to be rerun,
                            //       due to scanf()'s call ignoring nonnumeric input.
             (void) printf("Select a menu option:\n");
-            (void) printf("\t1 = Play default puzzle\n\t2 = Load custom puzzle\n\t3 = Export custom puzzle template\n\t4 = Quit\n");
+            (void) printf("\t1 = Play default puzzle\n\t2 = Load custom puzzle or puzzle pack\n\t3 = Export custom puzzle template\n\t4 = Quit\n");
             (void) printf("SELECTION: ");
             (void) scanf("%d", &selection); while (getchar() != '\n');
         } while (selection < 1 || selection > 4);
         if (selection == 1)
         {
-            picture_file = NULL;
-            play_game(picture_file, selection);
+            play_game(NULL, NULL, selection, seed, difficulty, keys, log_name);
             selection = 4; // exit program after game to prevent 2nd puzzle bug I haven't been able to solve
         }
         if (selection == 2)
         {
             // Prompt for custom file:
-            (void) printf("Enter filename (including extension) of custom puzzle.\n");
+            (void) printf("Enter filename (including extension) of custom puzzle or puzzle pack.\n");
             (void) printf("Custom puzzle file must be located in the same directory as this program.\n");
             (void) printf("FILENAME: ");
             (void) read_line(user_text, MAX_LINE + 1);
 
-            // Test whether a file with given name exists:
-            picture_file = fopen(user_text, "r");
-            if (picture_file != NULL)
+            // Test whether a file with given name exists, mapping it into memory if so:
+            if (map_file(user_text, &picture_file))
             {
-                play_game(picture_file, selection);
+                play_game(&picture_file, user_text, selection, seed, difficulty, keys, log_name);
                 selection = 4; // exit program after game to prevent 2nd puzzle bug I haven't been able to solve
             }
+            else if (picture_file.size > 0) // It was opened, but couldn't be mapped.
+            {
+                CLEAR_CONSOLE;
+                (void) printf("Error 21: Specified file could not be mapped into memory.\n");
+                exit(21);
+            }
             else
             {
                 (void) printf("Unable to locate file. Please ensure file exists and is located in the same directory as this program.\n");
@@ -226,43 +830,57 @@ int main(void)
 
     return 0;
 }
+#endif
 
 
 /* Definitions of other functions */
-/************************************************************************************************************************
- * play_game():         Purpose: Creates puzzle / stores puzzle in memory, runs game loop, runs winning sequence        *
- *                      Parameters: - FILE *picture_file --> pointer to the file containing the user's custom puzzle    *
- *                                      (or a NULL pointer if the user elected to play a default puzzle)                *
- *                                  - int selection --> value is either 1 (default puzzle) or 2 (custom puzzle)         *
- *                      Return value: none                                                                              *
- *                      Side effects: - prints to stdout                                                                *
- *                                    - reads from stdin                                                                *
- *                                    - terminates program                                                              *
- *                                    - clears CLI screen and scrollback                                                *
- *                                    - reads external files                                                            *
- ************************************************************************************************************************/
-void play_game(FILE *picture_file, int selection)
+/************************************************************************************************************************************
+ * play_game():         Purpose: Creates puzzle / stores puzzle in memory, runs game loop, runs winning sequence                    *
+ *                      Parameters: - Mapped_File *picture_file --> pointer to the mapped file containing the user's custom puzzle  *
+ *                                      or puzzle pack (or a NULL pointer if the user elected to play a default puzzle)             *
+ *                                  - const char *picture_name --> the name of that file (or NULL), recorded in the session log     *
+ *                                  - int selection --> value is either 1 (default puzzle) or 2 (custom puzzle)                     *
+ *                                  - uint64_t seed --> seed for the scramble's random number generator                             *
+ *                                  - int difficulty --> the number of moves the scramble should be from solved                     *
+ *                                      (or -1 for a uniformly random scramble)                                                     *
+ *                                  - bool keys --> whether to play by keystroke (see read_keys()) rather than by command line      *
+ *                                  - const char *log_name --> the session log to record the game in (or NULL not to record)        *
+ *                      Return value: none                                                                                          *
+ *                      Side effects: - prints to stdout                                                                            *
+ *                                    - reads from stdin                                                                            *
+ *                                    - terminates program                                                                          *
+ *                                    - clears CLI screen and scrollback                                                            *
+ *                                    - reads and writes external files                                                             *
+ ************************************************************************************************************************************/
+void play_game(Mapped_File *picture_file, const char *picture_name, int selection, uint64_t seed, int difficulty, bool keys,
+               const char *log_name)
 {
     // Variable declarations:
     int default_picture;
-    int fclose_return;
-    Panel panel0, panel1, panel2, panel3, panel4, panel5, panel6, panel7, panel8;
-    Panel solution_panel0, solution_panel1, solution_panel2,
-          solution_panel3, solution_panel4, solution_panel5,
-          solution_panel6, solution_panel7, solution_panel8;
-    Panel_All solution;
-    Panel_Row top, middle, bottom;
-    Panel final_piece_text, final_piece;
-    Panel_Row_Plus_Side_Panel middle_and_side;
-    Panel_Row_Plus_Side_Panel bottom_and_side;
-    Panel_All_Plus_Side_Panel display;
+    int unmap_return;
+    char tiles[MAX_PICTURE_SIZE]; // The puzzle's art as loaded, each tile's lines back to back, indexed by tile.
+    const Grid *grid = NULL; // The puzzle's size,
+    Panel_Size size; //     and the size of its panels.
+    Sp_State *state; // The puzzle's art, board, and display.
+    static Frame frame; // What the terminal shows, so that only changed panels need redrawing.
+    Viewport view; // The part of the board shown, which is all of it unless the terminal is too small.
+    bool repaint = false;
     bool unsolved = true;
+    bool moved = true; // Whether the last command or autoplay step changed the board.
+    Board before; // The board before the last command.
     char command[MAX_LINE] = {0};
     int length; // Character length of user commands.
     bool valid;
-    bool correct_format = false;
+    long error_offset;
+    long line, column;
+    long pack_puzzle = 0; // Which puzzle of a pack to play, counting from 1 (0 if the file is not a pack).
+    uint32_t pack_size;
     bool submit = false;
     long offset;
+    Solution autoplay = {.length = 0, .next = 0}; // Moves queued by the "solve" command.
+    struct timespec autoplay_delay = {.tv_sec = 0, .tv_nsec = AUTOPLAY_DELAY_NS};
+    int key_input = KEYS_PROMPT; // What the last keystrokes asked for (always the command prompt unless playing by keystroke).
+    int panel = -1; // In keystroke mode, a panel number typed without its flip yet (-1 for none).
 
     if (selection == 1)
     {
@@ -277,17 +895,50 @@ void play_game(FILE *picture_file, int selection)
             (void) scanf("%d", &default_picture); while (getchar() != '\n');
         } while (default_picture != 1);
     }
+    else if (selection == 2 && is_pack(picture_file))
+    {
+        if (!check_pack(picture_file))
+        {
+            CLEAR_CONSOLE;
+            (void) printf("Error 22: Puzzle pack is damaged or from another version of this program.\n");
+            exit(22);
+        }
+
+        // Only the index is read to list the pack, so even a huge pack lists instantly:
+        pack_size = read_le32(picture_file->data + 12);
+        do
+        {
+            CLEAR_CONSOLE;
+            pack_puzzle = 0; // Without this line, nonnumeric input would cause the selection from the previous loop to be rerun,
+                             //     due to scanf()'s call ignoring nonnumeric input.
+            (void) printf("Which puzzle from the pack would you like?\n");
+            for (uint32_t i = 0; i < pack_size; i++)
+                (void) printf("\t%lu = %.*s\n", (unsigned long) i + 1, PACK_NAME_LENGTH, pack_entry(picture_file, i));
+            (void) printf("SELECTION: ");
+            (void) scanf("%ld", &pack_puzzle); while (getchar() != '\n');
+        } while (pack_puzzle < 1 || pack_puzzle > (long) pack_size);
+        default_picture = 0; //prep for switch statement.
+    }
     else if (selection == 2)
     {
-        correct_format = check_formatting(picture_file, &offset);
-        if (!correct_format)
+        error_offset = check_formatting(picture_file, &offset, &grid, &size);
+        if (offset < 0)
+        {
+            CLEAR_CONSOLE;
+            (void) printf("Error 6: EOF return while searching custom file. Possible formatting error.\n");
+            (void) printf("Ensure template instructions have been followed.\n");
+            exit(6);
+        }
+        if (error_offset >= 0)
         {
+            locate_byte(picture_file, error_offset, &line, &column);
             CLEAR_CONSOLE;
             (void) printf("Error 3: Format error.\n");
-            (void) printf("Specified file could not be read. Possible formatting error.\n");
+            (void) printf("Specified file could not be read. First formatting error at byte %ld (line %ld, column %ld).\n",
+                          error_offset, line, column);
             (void) printf("Ensure template instructions have been followed.\n");
-            fclose_return = fclose(picture_file);
-            if (fclose_return)
+            unmap_return = unmap_file(picture_file);
+            if (unmap_return)
             {
                 (void) printf("Error 4: Close error.\n");
                 (void) printf("Specified file could not be closed correctly.\n");
@@ -301,7 +952,7 @@ void play_game(FILE *picture_file, int selection)
     switch (default_picture)
     {
         case 1:
-                solution = store_picture_heart(&panel0, &panel1, &panel2, &panel3, &panel4, &panel5, &panel6, &panel7, &panel8);
+                grid = store_picture_heart(tiles, &size);
                 break;
         default: // let default_picture be zero if the user loaded a file
             if (picture_file == NULL)
@@ -312,9 +963,12 @@ void play_game(FILE *picture_file, int selection)
             }
             else
             {
-                solution = store_picture_from_file(picture_file, &offset, &panel0, &panel1, &panel2, &panel3, &panel4, &panel5, &panel6, &panel7, &panel8);
-                fclose_return = fclose(picture_file);
-                if (fclose_return)
+                if (pack_puzzle)
+                    grid = store_picture_from_pack(picture_file, (uint32_t) pack_puzzle - 1, tiles, &size);
+                else
+                    store_picture_from_file(picture_file, offset, grid, size, tiles);
+                unmap_return = unmap_file(picture_file);
+                if (unmap_return)
                 {
                     CLEAR_CONSOLE;
                     (void) printf("Error 12: Close error after storing custom picture.\n");
@@ -325,62 +979,115 @@ void play_game(FILE *picture_file, int selection)
             }
     }
 
-    // Duplicate panels as solution panels to check against:
-    solution_panel0 = panel0;
-    solution_panel1 = panel1;
-    solution_panel2 = panel2;
-    solution_panel3 = panel3;
-    solution_panel4 = panel4;
-    solution_panel5 = panel5;
-    solution_panel6 = panel6;
-    solution_panel7 = panel7;
+    // Precompute every orientation of every tile so flips during play never touch the art:
+    state = create_state(tiles, grid, size);
+    if (state == NULL)
+    {
+        CLEAR_CONSOLE;
+        (void) printf("Error 27: Not enough memory to play.\n");
+        exit(27);
+    }
+
+    // Scrambled (though not yet shown) first, so that the banner can say how far from solved the board really is:
+    if (!sp_scramble(state, seed, difficulty))
+    {
+        CLEAR_CONSOLE;
+        (void) printf("Error 27: Not enough memory to play.\n");
+        exit(27);
+    }
 
     CLEAR_CONSOLE;
     (void) printf("Solution:\n");
-    print_panel_all(solution);
+    print_solution(&state->atlas);
+    (void) printf("\n\nScramble seed: %llu (run with \"--seed %llu\" to play this board again)", (unsigned long long) seed,
+                  (unsigned long long) seed);
+    if (state->distance >= 0 && state->distance < difficulty)
+        (void) printf("\nDifficulty: %d moves from solved (the closest to %d this puzzle's art could be scrambled to)",
+                      state->distance, difficulty);
+    else if (state->distance >= 0)
+        (void) printf("\nDifficulty: %d moves from solved", state->distance);
     (void) printf("\n\nPress ENTER to scramble puzzle and begin.\n\n");
     while (getchar() != '\n'); // Wait for Enter key.
-
-    display = scramble_puzzle(&panel0, &panel1, &panel2,
-                              &panel3, &panel4, &panel5,
-                              &panel6, &panel7, &panel8,
-                              &top, &middle, &bottom,
-                              &middle_and_side, &bottom_and_side,
-                              &final_piece_text, &final_piece);
-
-    solution_panel8 = panel8; // This is here and not earlier because after scrambling, panel8 is just a gap panel--which is what the solution requires.
+    if (log_name != NULL && !start_recording(state, log_name, picture_name, pack_puzzle, seed, difficulty))
+    {
+        CLEAR_CONSOLE;
+        (void) printf("Error 28: Session log %s could not be written.\n", log_name);
+        exit(28);
+    }
 
     // Main game loop:
+    frame.valid = false;
+    frame.synchronized = isatty(STDOUT_FILENO);
+    view = full_view(state->atlas.grid);
+    if (keys)
+        set_raw_input(true);
     while (unsolved)
     {
-        CLEAR_CONSOLE;
-        (void) printf("Puzzle:\n");
-        print_all_plus_side(display);
-        (void) printf("\n\n");
-        do
+        // Show as much of the board as the terminal has room for, keeping the gap (or the panel about to be flipped) in view:
+        update_viewport(&view, state->atlas.grid, state->atlas.size,
+                        panel >= 0 && panel < state->atlas.grid->cells ? panel : state->board.gap);
+        update_display(&state->atlas, &state->board, state->final_piece_text, state->final_piece, &view, &state->display);
+        draw_display(&frame, &state->display);
+        if (autoplay.next < autoplay.length)
+        {
+            // Play back the next move of a requested solution instead of reading a command:
+            (void) nanosleep(&autoplay_delay, NULL);
+            (void) sp_apply_moves(state, &autoplay.moves[autoplay.next++], 1);
+            moved = true;
+        }
+        else
+        {
+            before = state->board;
+            if (keys)
+            {
+                if (panel < 0)
+                    (void) printf("Arrow keys or WASD to slide, a panel number then H, V, or R to flip, U to undo, Y to redo, Enter for a command: ");
+                else
+                    (void) printf("Flip panel %d: H, V, or R? ", panel);
+                key_input = read_keys(state, &panel);
+                if (key_input == KEYS_QUIT)
+                {
+                    CLEAR_CONSOLE;
+                    exit(0);
+                }
+            }
+            if (key_input == KEYS_PROMPT)
+            {
+                if (keys)
+                {
+                    set_raw_input(false);
+                    (void) printf("\r\033[K"); // The prompt takes the place of the keystroke hint.
+                }
+                do
+                {
+                    (void) printf("Enter command (\"help\" for help): ");
+                    length = read_line(command, MAX_LINE + 1);
+                    if (length == 0 && feof(stdin))
+                    {
+                        // Nothing more can be read, so stop instead of rejecting an empty command forever:
+                        CLEAR_CONSOLE;
+                        exit(0);
+                    }
+                    valid = parse_command(command, length, state, &autoplay, &submit, &repaint);
+                } while (!valid);
+                if (keys)
+                    set_raw_input(true);
+            }
+            if (repaint)
+            {
+                frame.valid = false;
+                repaint = false;
+            }
+            moved = !board_same(&state->board, &before);
+        }
+        if (moved && sp_is_solved(state))
+        {
+            // The move that completes the picture wins at once, without waiting for "submit":
+            unsolved = false;
+        }
+        else if (submit)
         {
-            (void) printf("Enter command (\"help\" for help): ");
-            length = read_line(command, MAX_LINE + 1);
-            valid = parse_command(command, length, solution,
-                                  &panel0, &panel1, &panel2,
-                                  &panel3, &panel4, &panel5,
-                                  &panel6, &panel7, &panel8,
-                                  &submit);
-        } while (!valid);
-        display = update_display(&panel0, &panel1, &panel2,
-                                 &panel3, &panel4, &panel5,
-                                 &panel6, &panel7, &panel8,
-                                 &top, &middle, &bottom,
-                                 &middle_and_side, &bottom_and_side,
-                                 &final_piece_text, &final_piece);
-        if (submit)
-        {
-            unsolved = !check_answer(&panel0, &panel1, &panel2,
-                                     &panel3, &panel4, &panel5,
-                                     &panel6, &panel7, &panel8,
-                                     &solution_panel0, &solution_panel1, &solution_panel2,
-                                     &solution_panel3, &solution_panel4, &solution_panel5,
-                                     &solution_panel6, &solution_panel7, &solution_panel8);
+            unsolved = !sp_is_solved(state);
             submit = false;
             if (unsolved)
             {
@@ -388,11 +1095,14 @@ void play_game(FILE *picture_file, int selection)
                 (void) printf("\a");
                 (void) printf("Submission incorrect. Press ENTER to keep playing.\n\n");
                 while (getchar() != '\n');
+                frame.valid = false;
             }
         }
     }
 
     // Winning sequence (from here to end of function):
+    if (keys)
+        set_raw_input(false);
     CLEAR_CONSOLE;
     (void) printf("\a\a\a");
     (void) printf(
@@ -409,7 +1119,7 @@ void play_game(FILE *picture_file, int selection)
 
     CLEAR_CONSOLE;
     (void) printf("Solution:\n");
-    print_panel_all(solution);
+    print_solution(&state->atlas);
     (void) printf("\n\n----press ENTER----\n\n");
     while (getchar() != '\n');
 
@@ -419,139 +1129,199 @@ void play_game(FILE *picture_file, int selection)
 }
 
 
-/************************************************************************************************************************
- * check_formatting():  Purpose: Determines whether given file contains a validly formatted puzzle                      *
- *                      Parameters: - FILE *picture_file --> pointer to the file containing the user's custom puzzle    *
- *                                  - long *offset --> pointer to the variable in which to store the file offset        *
- *                                                          which indicates the beginning of the valid puzzle           *
- *                      Return value: bool --> true for validity, false for invalidity                                  *
- *                      Side effects: - reads external files                                                            *
- *                                    - alters external variable pointed to by "long *offset"                           *
- *                                    - prints to stdout                                                                *
- *                                    - terminates program                                                              *
- *                                    - clears CLI screen and scrollback                                                *
- ************************************************************************************************************************/
-bool check_formatting(FILE *picture_file, long *offset)
+/******************************************************************************************************************************************
+ * check_formatting():  Purpose: Determines whether given file contains a validly formatted puzzle, in a single pass over the mapped      *
+ *                                 file: finds the first top line at least two panels wide, takes the number of columns from its run      *
+ *                                 of panel tops and the number of rows from how many rows of panels follow it, then checks every         *
+ *                                 border character from there to the final line against the template (panel interiors are left           *
+ *                                 alone). The panels' size is the one a PANEL_SIZE_HEADER line above the puzzle gives, as                *
+ *                                 templates have, or else their width is taken from the first panel top and their height from how        *
+ *                                 many lines of art follow it; either way the puzzle's display must fit (see panel_size_fits()).         *
+ *                                 Returns the byte offset of the first formatting error, or -1 if there is none.                         *
+ *                      Parameters: - const Mapped_File *picture_file --> pointer to the mapped file containing the user's custom puzzle  *
+ *                                  - long *offset --> pointer to the variable in which to store the file offset                          *
+ *                                                          which indicates the beginning of the valid puzzle                             *
+ *                                                          (or -1 if there is no top line, in which case the file's size is returned)    *
+ *                                  - const Grid **grid --> pointer to the variable in which to store the puzzle's size (NULL unless      *
+ *                                                          the puzzle is valid)                                                          *
+ *                                  - Panel_Size *size --> pointer to the variable in which to store the size of its panels               *
+ *                      Return value: long --> -1 for validity, otherwise the offset of the first invalid byte                            *
+ *                      Side effects: - alters external variables pointed to by "long *offset", "const Grid **grid", and                  *
+ *                                        "Panel_Size *size"                                                                              *
+ ******************************************************************************************************************************************/
+long check_formatting(const Mapped_File *picture_file, long *offset, const Grid **grid, Panel_Size *size)
 {
-    int fseek_return = 0;
-    int fread_return = 0;
-    int ch, i;
-    bool found_topline = false;
-    long told_pos = 0;
-    bool correct_formatting = true;
-
-    // topline_size is equal to the number of bytes in the top line of a panel row, minus the initial space and the automatic terminating null:
-    size_t topline_size = (sizeof(PANEL_TOP PANEL_TOP PANEL_TOP) - sizeof(char) - sizeof(char));
-    char potential_topline[(int) topline_size];
-    char spaced_potential_topline[(int) topline_size + 1];
-
-    // Ensure position indicator is at beginning of file:
-    fseek_return = fseek(picture_file, 0, SEEK_SET);
-    if (fseek_return)
+    const char *data = picture_file->data;
+    bool given = read_panel_size(picture_file, size); // Whether the header gave the panels' size.
+    size_t start, line, column, line_length, length, next;
+    size_t run = 0; // Underscores along the first panel top.
+    int rows, columns;
+    char expected;
+
+    // Find topline, two panel tops side by side (as wide as the header says, if it says):
+    *grid = NULL;
+    for (start = 0; start + 1 < picture_file->size; start += run + 1)
     {
-        CLEAR_CONSOLE;
-        (void) printf("Error 5: File position indicator could not be set correctly.\n");
-        exit(5);
+        run = 0;
+        if (data[start] != ' ')
+            continue;
+        while (start + 1 + run < picture_file->size && data[start + 1 + run] == '_')
+            run++;
+        if (run > 0 && (!given || run + 2 == (size_t) size->width) && start + 2 * run + 4 <= picture_file->size
+            && is_panel_top(data + start, (int) run + 2) && is_panel_top(data + start + run + 2, (int) run + 2))
+            break;
     }
-
-    // Find topline:
-    do
+    if (start + 1 >= picture_file->size)
     {
-        while ((ch = fgetc(picture_file)) != ' ' && ch != EOF);
-        if (ch == EOF)
-        {
-            CLEAR_CONSOLE;
-            (void) printf("Error 6: EOF return while searching custom file. Possible formatting error.\n");
-            (void) printf("Ensure template instructions have been followed.\n");
-            exit(6);
-        }
-        told_pos = ftell(picture_file);
-        if (told_pos == -1)
-        {
-            CLEAR_CONSOLE;
-            (void) printf("Error 7: Failure to tell current file position.\n");
-            exit(7);
-        }
-        fread_return = fread(potential_topline, topline_size, 1, picture_file);
-        if (fread_return < 1)
+        *offset = -1;
+        return (long) picture_file->size;
+    }
+    *offset = (long) start;
+    size->width = (int) run + 2;
+    if (size->width > MAX_DISPLAY_WIDTH)
+        return (long) start; // Too wide to be a panel of any puzzle.
+
+    // Every panel top on the top line is a column, and every row of panels below it (starting with a vertical bar at either
+    //     end of its first line) is a row; missing rows show up below as formatting errors where they should have been:
+    for (columns = 2; columns < MAX_GRID_SIDE; columns++)
+    {
+        next = start + (size_t) (size->width * columns);
+        if (next + (size_t) size->width > picture_file->size || !is_panel_top(data + next, size->width))
+            break;
+    }
+    line_length = (size_t) FILE_LINE_LENGTH(columns, *size);
+    if (!given)
+    {
+        // Likewise, every line of art (starting with a vertical bar at either end) down to the next top line is a panel's:
+        for (size->height = 1; size->height < MAX_DISPLAY_LINES; size->height++)
         {
-            CLEAR_CONSOLE;
-            (void) printf("Error 8: Failure to read potential topline. Possible formatting error.\n");
-            (void) printf("Ensure template instructions have been followed.\n");
-            exit(8);
+            next = start + line_length * (size_t) size->height;
+            if (next + line_length - 2 >= picture_file->size || (data[next] != '|' && data[next + line_length - 2] != '|'))
+                break;
         }
+        if (size->height < MIN_PANEL_HEIGHT)
+            size->height = MIN_PANEL_HEIGHT;
+    }
+    for (rows = 0; rows < MAX_GRID_SIDE; rows++)
+    {
+        next = start + line_length * (size_t) (size->height * rows + 1);
+        if (next + line_length - 2 >= picture_file->size || (data[next] != '|' && data[next + line_length - 2] != '|'))
+            break;
+    }
+    if (rows < MIN_GRID_SIDE)
+        rows = MIN_GRID_SIDE;
+    if (!panel_size_fits(grid_of(rows, columns), *size))
+        return (long) start;
+
+    // Check formatting of panels, skipping interiors and new-lines:
+    length = (size_t) FILE_PUZZLE_LENGTH(rows, columns, *size);
+    for (size_t i = 0; i < length; i++)
+    {
+        if (start + i >= picture_file->size)
+            return (long) (start + i); // The file ends partway through the puzzle.
+        line = i / line_length;
+        column = i % line_length;
+        if (column == line_length - 1)
+            continue;
+        if (column % (size_t) size->width == 0 || column % (size_t) size->width == (size_t) size->width - 1)
+            expected = line % (size_t) size->height == 0 ? ' ' : '|'; // Panel edges: spaces on top lines, vertical bars elsewhere
+        else if (line % (size_t) size->height == 0)
+            expected = '_';
+        else
+            continue;
+        if (data[start + i] != expected)
+            return (long) (start + i);
+    }
+    *grid = grid_of(rows, columns);
 
-        (void) strcat(strcpy(spaced_potential_topline, " "), potential_topline);
-
+    return -1;
+}
 
-        if (strcmp(spaced_potential_topline, PANEL_TOP PANEL_TOP PANEL_TOP "\0"))
-        {
-            fseek_return = fseek(picture_file, told_pos, SEEK_SET);
-            if (fseek_return)
-            {
-                CLEAR_CONSOLE;
-                (void) printf("Error 9: File position indicator could not be set to previous position.\n");
-                exit(9);
-            }
-        }
-        else
-        {
-            found_topline = true;
-            *offset = told_pos - (long) sizeof(char);
-            fseek_return = fseek(picture_file, *offset, SEEK_SET);
-            if (fseek_return)
-            {
-                CLEAR_CONSOLE;
-                (void) printf("Error 10: File position indicator could not be set to adjusted position.\n");
-                exit(10);
-            }
-        }
-    } while (!found_topline);
 
-    // Check formatting of panels, skipping interiors:
-    for (i = 0, ch = fgetc(picture_file); i < FILE_PANEL_ALL_CHAR_NUM && ch != EOF; i++, ch = fgetc(picture_file))
+/***********************************************************************************************************************************
+ * read_panel_size():   Purpose: Looks for a PANEL_SIZE_HEADER line ("Panel size: 38x12", width by height) above the puzzle in a   *
+ *                                 mapped file, as export_template() writes, storing the size it gives and returning true if it    *
+ *                                 has one that some puzzle's panels could be                                                      *
+ *                      Parameters: - const Mapped_File *picture_file --> pointer to the mapped file containing the custom puzzle  *
+ *                                  - Panel_Size *size --> pointer to the variable in which to store the size                      *
+ *                      Return value: bool                                                                                         *
+ *                      Side effects: - alters the variable pointed to by "Panel_Size *size"                                       *
+ ***********************************************************************************************************************************/
+bool read_panel_size(const Mapped_File *picture_file, Panel_Size *size)
+{
+    const char *data = picture_file->data;
+    size_t header_length = sizeof(PANEL_SIZE_HEADER) - 1;
+    size_t i;
+    int values[2];
+    int digits;
+
+    // Each line up to the first that starts like a top line:
+    for (size_t start = 0; start + 1 < picture_file->size && !(data[start] == ' ' && data[start + 1] == '_'); start = i + 1)
     {
-        // Check all needed spaces:
-        if (i == 0 || i == 37 || i == 38 || i == 75 || i == 76 || i == 113 ||
-            i == 1380 || i == 1417 || i == 1418 || i == 1455 || i == 1456 || i == 1493 ||
-            i == 2760 || i == 2797 || i == 2798 || i == 2835 || i == 2836 || i == 2873 ||
-            i == 4140 || i == 4177 || i == 4178 || i == 4215 || i == 4216 || i == 4253)
-        {
-            if (ch != ' ')
-            {
-                correct_formatting = false;
-                break;
-            }
-        }
-        // Check all needed underscores:
-        if ((i > 0 && i < 37) || (i > 38 && i < 75) || (i > 76 && i < 113) ||
-            (i > 1380 && i < 1417) || (i > 1418 && i < 1455) || (i > 1456 && i < 1493) ||
-            (i > 2760 && i < 2797) || (i > 2798 && i < 2835) || (i > 2836 && i < 2873) ||
-            (i > 4140 && i < 4177) || (i > 4178 && i < 4215) || (i > 4216 && i < 4253))
-        {
-            if (ch != '_')
-            {
-                correct_formatting = false;
-                break;
-            }
-        }
-        // Check all needed vertical bars:
-        if (((i > 114 && i < 1380) || (i > 1494 && i < 2760) || (i > 2874 && i < 4140)) &&
-                ((((i - 0) % 115) == 0) || (((i - 37) % 115) == 0) || (((i - 38) % 115) == 0) ||
-                 (((i - 75) % 115) == 0) || (((i - 76) % 115) == 0) || (((i - 113) % 115) == 0)))
+        i = start;
+        if (start + header_length < picture_file->size && memcmp(data + start, PANEL_SIZE_HEADER, header_length) == 0)
         {
-            if (ch != '|')
+            // The width, an 'x', and the height (anything after it is ignored):
+            i += header_length;
+            for (int v = 0; v < 2; v++)
             {
-                correct_formatting = false;
-                break;
+                values[v] = 0;
+                for (digits = 0; i < picture_file->size && isdigit((unsigned char) data[i]) && digits < 4; i++, digits++)
+                    values[v] = values[v] * 10 + data[i] - '0';
+                if (v == 0 && (i >= picture_file->size || data[i++] != 'x'))
+                    values[0] = 0; // Not a size after all.
             }
+            *size = (Panel_Size) {.width = values[0], .height = values[1]};
+            if (size->width >= MIN_PANEL_WIDTH && size->width <= MAX_DISPLAY_WIDTH && size->height >= MIN_PANEL_HEIGHT
+                && size->height < MAX_DISPLAY_LINES)
+                return true;
         }
+        while (i < picture_file->size && data[i] != '\n')
+            i++;
     }
 
-    return correct_formatting;
+    return false;
+}
+
+
+/*******************************************************************************************************************************
+ * panel_size_fits():   Purpose: Determines whether panels of a given size are allowed on a board of a given size: big enough  *
+ *                                 for their edges, a line of art, and a panel number, and small enough that the display (the  *
+ *                                 board, a 3-space gap, and a panel-wide sidebar) fits in MAX_DISPLAY_LINES and               *
+ *                                 MAX_DISPLAY_WIDTH, so that any size from the default's down fits on a board of any size     *
+ *                      Parameters: - const Grid *grid --> the board's size                                                    *
+ *                                  - Panel_Size size --> the panels' size                                                     *
+ *                      Return value: bool                                                                                     *
+ *                      Side effects: none                                                                                     *
+ *******************************************************************************************************************************/
+bool panel_size_fits(const Grid *grid, Panel_Size size)
+{
+    return size.width >= MIN_PANEL_WIDTH && size.height >= MIN_PANEL_HEIGHT
+           && (long) size.width * (grid->columns + 1) + 3 <= MAX_DISPLAY_WIDTH
+           && (long) size.height * grid->rows + 1 <= MAX_DISPLAY_LINES;
+}
+
+
+/*********************************************************************************************************************************
+ * is_panel_top():      Purpose: Determines whether text is the top line of a panel of a given width: a space, underscores, and  *
+ *                                 another space                                                                                 *
+ *                      Parameters: - const char *text --> the text (at least "width" characters)                                *
+ *                                  - int width --> the width of a panel                                                         *
+ *                      Return value: bool                                                                                       *
+ *                      Side effects: none                                                                                       *
+ *********************************************************************************************************************************/
+bool is_panel_top(const char *text, int width)
+{
+    if (text[0] != ' ' || text[width - 1] != ' ')
+        return false;
+    for (int i = 1; i < width - 1; i++)
+        if (text[i] != '_')
+            return false;
+
+    return true;
 }
 
-// Blank puzzle, for reference:
+// Blank 3x3 puzzle, for reference (other sizes have more or fewer panels across and down):
 //  ____________________________________  ____________________________________  ____________________________________ 
 // |                                    ||                                    ||                                    |
 // |                                    ||                                    ||                                    |
@@ -591,701 +1361,440 @@ bool check_formatting(FILE *picture_file, long *offset)
 //  ____________________________________  ____________________________________  ____________________________________ 
 
 
-/**************************************************************************************************************************************
- * store_picture_heart():   Purpose: Stores, in passed panel variable pointers, the strings making up the "heart" puzzle's graphics,  *
- *                                      and returns the combined, completed picture                                                   *
- *                          Parameters: - Panel *panel0 --> pointer to the variable containing the 0th panel                          *
- *                                      - Panel *panel1 --> pointer to the variable containing the 1st panel                          *
- *                                      - Panel *panel2 --> pointer to the variable containing the 2nd panel                          *
- *                                      - Panel *panel3 --> pointer to the variable containing the 3rd panel                          *
- *                                      - Panel *panel4 --> pointer to the variable containing the 4th panel                          *
- *                                      - Panel *panel5 --> pointer to the variable containing the 5th panel                          *
- *                                      - Panel *panel6 --> pointer to the variable containing the 6th panel                          *
- *                                      - Panel *panel7 --> pointer to the variable containing the 7th panel                          *
- *                                      - Panel *panel8 --> pointer to the variable containing the 8th panel                          *
- *                          Return value: Panel_All                                                                                   *
- *                          Side effects: - alters the panel variables pointed to by the parameters                                   *
- **************************************************************************************************************************************/
-Panel_All store_picture_heart(Panel *panel0, Panel *panel1, Panel *panel2,
-                              Panel *panel3, Panel *panel4, Panel *panel5,
-                              Panel *panel6, Panel *panel7, Panel *panel8)
-{
-    *panel0 = (Panel) {
-                        .row0 = PANEL_TOP "\0",
-                        .row1 = "|                                 ** |\0",
-                        .row2 = "|                               **   |\0",
-                        .row3 = "|                             **     |\0",
-                        .row4 = "|                           **       |\0",
-                        .row5 = "|                         **         |\0",
-                        .row6 = "|                       **           |\0",
-                        .row7 = "|                     **             |\0",
-                        .row8 = "|                   **               |\0",
-                        .row9 = "|                 **                 |\0",
-                        .row10 = "|                 **                 |\0",
-                        .row11 = "|                 **                 |\0"
-                      };
-    
-    *panel1 = (Panel) {
-                        .row0 = PANEL_TOP "\0",
-                        .row1 = "|***                              ***|\0",
-                        .row2 = "|   ***                        ***   |\0",
-                        .row3 = "|      **                    **      |\0",
-                        .row4 = "|        **                **        |\0",
-                        .row5 = "|          **            **          |\0",
-                        .row6 = "|            **        **            |\0",
-                        .row7 = "|              **    **              |\0",
-                        .row8 = "|                *  *                |\0",
-                        .row9 = "|                 **                 |\0",
-                        .row10 = BLANK_LINE "\0",
-                        .row11 = BLANK_LINE "\0",
-                      };
-
-    *panel2 = (Panel) {
-                        .row0 = PANEL_TOP "\0",
-                        .row1 = "| **                                 |\0",
-                        .row2 = "|   **                               |\0",
-                        .row3 = "|     **                             |\0",
-                        .row4 = "|       **                           |\0",
-                        .row5 = "|         **                         |\0",
-                        .row6 = "|           **                       |\0",
-                        .row7 = "|             **                     |\0",
-                        .row8 = "|               **                   |\0",
-                        .row9 = "|                 **                 |\0",
-                        .row10 = "|                 **                 |\0",
-                        .row11 = "|                 **                 |\0",
-                      };
-
-    *panel3 = (Panel) {
-                        .row0 = PANEL_TOP "\0",
-                        .row1 = "|                 **                 |\0",
-                        .row2 = "|                 **                 |\0",
-                        .row3 = "|                 **                 |\0",
-                        .row4 = "|                 **                 |\0",
-                        .row5 = "|                   **               |\0",
-                        .row6 = "|                     **             |\0",
-                        .row7 = "|                       **           |\0",
-                        .row8 = "|                         **         |\0",
-                        .row9 = "|                           **       |\0",
-                        .row10 = "|                             **     |\0",
-                        .row11 = "|                               **   |\0",
-                      };
-
-    *panel4 = blank_panel();
-
-    *panel5 = (Panel) {
-                        .row0 = PANEL_TOP "\0",
-                        .row1 = "|                 **                 |\0",
-                        .row2 = "|                 **                 |\0",
-                        .row3 = "|                 **                 |\0",
-                        .row4 = "|                 **                 |\0",
-                        .row5 = "|               **                   |\0",
-                        .row6 = "|             **                     |\0",
-                        .row7 = "|           **                       |\0",
-                        .row8 = "|         **                         |\0",
-                        .row9 = "|       **                           |\0",
-                        .row10 = "|     **                             |\0",
-                        .row11 = "|   **                               |\0",
-                      };
-
-    *panel6 = (Panel) {
-                        .row0 = PANEL_TOP "\0",
-                        .row1 = "|                                   *|\0",
-                        .row2 = BLANK_LINE "\0",
-                        .row3 = BLANK_LINE "\0",
-                        .row4 = BLANK_LINE "\0",
-                        .row5 = BLANK_LINE "\0",
-                        .row6 = BLANK_LINE "\0",
-                        .row7 = BLANK_LINE "\0",
-                        .row8 = BLANK_LINE "\0",
-                        .row9 = BLANK_LINE "\0",
-                        .row10 = BLANK_LINE "\0",
-                        .row11 = BLANK_LINE "\0",
-                      };
-
-    *panel7 = (Panel) {
-                        .row0 = PANEL_TOP "\0",
-                        .row1 = BLANK_LINE "\0",
-                        .row2 = "|*                                  *|\0",
-                        .row3 = "| **                              ** |\0",
-                        .row4 = "|   **                          **   |\0",
-                        .row5 = "|     **                      **     |\0",
-                        .row6 = "|       **                  **       |\0",
-                        .row7 = "|         **              **         |\0",
-                        .row8 = "|           **          **           |\0",
-                        .row9 = "|             **      **             |\0",
-                        .row10 = "|               **  **               |\0",
-                        .row11 = "|                 **                 |\0",
-                      };
-
-    *panel8 = (Panel) {
-                        .row0 = PANEL_TOP "\0",
-                        .row1 = "|*                                   |\0",
-                        .row2 = BLANK_LINE "\0",
-                        .row3 = BLANK_LINE "\0",
-                        .row4 = BLANK_LINE "\0",
-                        .row5 = BLANK_LINE "\0",
-                        .row6 = BLANK_LINE "\0",
-                        .row7 = BLANK_LINE "\0",
-                        .row8 = BLANK_LINE "\0",
-                        .row9 = BLANK_LINE "\0",
-                        .row10 = BLANK_LINE "\0",
-                        .row11 = BLANK_LINE "\0",
-                      };
-    
-    Panel_Row top = assemble_panel_row(*panel0, *panel1, *panel2);
-    Panel_Row middle = assemble_panel_row(*panel3, *panel4, *panel5);
-    Panel_Row bottom = assemble_panel_row(*panel6, *panel7, *panel8);
-
-    return assemble_panel_all(top, middle, bottom);
-}
-
-
-/********************************************************************************************
- * blank_panel():    Purpose: Returns by value a panel variable with blanked out graphics   *
- *                   Parameters: none                                                       *
- *                   Return value: Panel                                                    *
- *                   Side effects: none                                                     *
- ********************************************************************************************/
-Panel blank_panel(void)
-{
-    Panel p = {.row0 = PANEL_TOP "\0",
-               .row1 = BLANK_LINE "\0",
-               .row2 = BLANK_LINE "\0",
-               .row3 = BLANK_LINE "\0",
-               .row4 = BLANK_LINE "\0",
-               .row5 = BLANK_LINE "\0",
-               .row6 = BLANK_LINE "\0",
-               .row7 = BLANK_LINE "\0",
-               .row8 = BLANK_LINE "\0",
-               .row9 = BLANK_LINE "\0",
-               .row10 = BLANK_LINE "\0",
-               .row11 = BLANK_LINE "\0"
-              };
-
-    return p;
-}
-
-
-/********************************************************************************************************************
- * assemble_panel_row():    Purpose: Takes 3 passed panel variables and assembles them into a 1x3 unit for return.  *
- *                          Parameters: - Panel panel0 --> value of the desired leftmost panel                      *
- *                                      - Panel panel1 --> value of the desired middle panel                        *
- *                                      - Panel panel2 --> value of the desired rightmost panel                     *
- *                          Return value: Panel_Row                                                                 *
- *                          Side effects: none                                                                      *
- ********************************************************************************************************************/
-Panel_Row assemble_panel_row(Panel panel0, Panel panel1, Panel panel2)
+/**********************************************************************************************************************************
+ * store_picture_heart():   Purpose: Stores the "heart" puzzle's graphics in the passed array of tiles, and returns the puzzle's  *
+ *                                      size (3x3, with panels of the default size)                                               *
+ *                          Parameters: - char tiles[] --> the array in which to store each tile's art, indexed by tile           *
+ *                                      - Panel_Size *size --> pointer to the variable in which to store the size of its panels   *
+ *                          Return value: const Grid                                                                              *
+ *                          Side effects: - alters the array "char tiles[]" and the variable pointed to by "Panel_Size *size"     *
+ **********************************************************************************************************************************/
+const Grid *store_picture_heart(char tiles[], Panel_Size *size)
 {
-    Panel_Row pr = {.row0 = *strcat(strcat(strcpy(pr.row0, panel0.row0), panel1.row0), panel2.row0),
-                    .row1 = *strcat(strcat(strcpy(pr.row1, panel0.row1), panel1.row1), panel2.row1),
-                    .row2 = *strcat(strcat(strcpy(pr.row2, panel0.row2), panel1.row2), panel2.row2),
-                    .row3 = *strcat(strcat(strcpy(pr.row3, panel0.row3), panel1.row3), panel2.row3),
-                    .row4 = *strcat(strcat(strcpy(pr.row4, panel0.row4), panel1.row4), panel2.row4),
-                    .row5 = *strcat(strcat(strcpy(pr.row5, panel0.row5), panel1.row5), panel2.row5),
-                    .row6 = *strcat(strcat(strcpy(pr.row6, panel0.row6), panel1.row6), panel2.row6),
-                    .row7 = *strcat(strcat(strcpy(pr.row7, panel0.row7), panel1.row7), panel2.row7),
-                    .row8 = *strcat(strcat(strcpy(pr.row8, panel0.row8), panel1.row8), panel2.row8),
-                    .row9 = *strcat(strcat(strcpy(pr.row9, panel0.row9), panel1.row9), panel2.row9),
-                    .row10 = *strcat(strcat(strcpy(pr.row10, panel0.row10), panel1.row10), panel2.row10),
-                    .row11 = *strcat(strcat(strcpy(pr.row11, panel0.row11), panel1.row11), panel2.row11)
-                   };
-    return pr;
-}
-
-
-/****************************************************************************************************
- * assemble_panel_all():    Purpose: Takes 3 passed Panel_Rows combines them into a 9x9 set.        *
- *                          Parameters: - Panel_Row top --> the value of the desired top row        *
- *                                      - Panel_Row middle --> the value of the desired middle row  *
- *                                      - Panel_Row bottom --> the value of the desired bottom row  *
- *                          Return value: Panel_All                                                 *
- *                          Side effects: none                                                      *
- ****************************************************************************************************/
-Panel_All assemble_panel_all(Panel_Row top, Panel_Row middle, Panel_Row bottom)
-{
-    Panel_All pa = {
-                    .top = top,
-                    .middle = middle,
-                    .bottom = bottom,
-                    .final_row = PANEL_TOP PANEL_TOP PANEL_TOP "\0"
-                   };
-    return pa;
-}
-
-
-/***************************************************************************************************************************************
- * store_picture_from_file():   Purpose: Stores, in passed panel variable pointers, the strings making up a custom puzzle's graphics,  *
- *                                          and returns the combined, completed picture                                                *
- *                              Parameters: - FILE *picture_file --> pointer to the file containing the user's custom puzzle           *
- *                                          - long *offset --> pointer to the variable containing the file offset                      *
- *                                                          which indicates the beginning of the custom puzzle                         *
- *                                          - Panel *panel0 --> pointer to the variable containing the 0th panel                       *
- *                                          - Panel *panel1 --> pointer to the variable containing the 1st panel                       *
- *                                          - Panel *panel2 --> pointer to the variable containing the 2nd panel                       *
- *                                          - Panel *panel3 --> pointer to the variable containing the 3rd panel                       *
- *                                          - Panel *panel4 --> pointer to the variable containing the 4th panel                       *
- *                                          - Panel *panel5 --> pointer to the variable containing the 5th panel                       *
- *                                          - Panel *panel6 --> pointer to the variable containing the 6th panel                       *
- *                                          - Panel *panel7 --> pointer to the variable containing the 7th panel                       *
- *                                          - Panel *panel8 --> pointer to the variable containing the 8th panel                       *
- *                              Return value: Panel_All                                                                                *
- *                              Side effects: - reads external files                                                                   *
- *                                            - alters the panel variables pointed to by the Panel * parameters                        *
- *                                            - prints to stdout                                                                       *
- *                                            - terminates program                                                                     *
- *                                            - clears CLI screen and scrollback                                                       *
- ***************************************************************************************************************************************/
-Panel_All store_picture_from_file(FILE *picture_file, long *offset,
-                                  Panel *panel0, Panel *panel1, Panel *panel2,
-                                  Panel *panel3, Panel *panel4, Panel *panel5,
-                                  Panel *panel6, Panel *panel7, Panel *panel8)
-{
-    size_t line_size = sizeof(PANEL_TOP) - sizeof(char); // subtracting the automatic terminating null
-    long temp_offset;
-    long told_pos = 0;
-    int inner_counter = 0, outer_counter = 0;
-    int fseek_return = 0;
-    int fread_return = 0;
-    char buffer[line_size];
-    char *interlaced_rows[108] = {panel0->row0, panel1->row0, panel2->row0,
-                                  panel0->row1, panel1->row1, panel2->row1,
-                                  panel0->row2, panel1->row2, panel2->row2,
-                                  panel0->row3, panel1->row3, panel2->row3,
-                                  panel0->row4, panel1->row4, panel2->row4,
-                                  panel0->row5, panel1->row5, panel2->row5,
-                                  panel0->row6, panel1->row6, panel2->row6,
-                                  panel0->row7, panel1->row7, panel2->row7,
-                                  panel0->row8, panel1->row8, panel2->row8,
-                                  panel0->row9, panel1->row9, panel2->row9,
-                                  panel0->row10, panel1->row10, panel2->row10,
-                                  panel0->row11, panel1->row11, panel2->row11,
-                                  panel3->row0, panel4->row0, panel5->row0,
-                                  panel3->row1, panel4->row1, panel5->row1,
-                                  panel3->row2, panel4->row2, panel5->row2,
-                                  panel3->row3, panel4->row3, panel5->row3,
-                                  panel3->row4, panel4->row4, panel5->row4,
-                                  panel3->row5, panel4->row5, panel5->row5,
-                                  panel3->row6, panel4->row6, panel5->row6,
-                                  panel3->row7, panel4->row7, panel5->row7,
-                                  panel3->row8, panel4->row8, panel5->row8,
-                                  panel3->row9, panel4->row9, panel5->row9,
-                                  panel3->row10, panel4->row10, panel5->row10,
-                                  panel3->row11, panel4->row11, panel5->row11,
-                                  panel6->row0, panel7->row0, panel8->row0,
-                                  panel6->row1, panel7->row1, panel8->row1,
-                                  panel6->row2, panel7->row2, panel8->row2,
-                                  panel6->row3, panel7->row3, panel8->row3,
-                                  panel6->row4, panel7->row4, panel8->row4,
-                                  panel6->row5, panel7->row5, panel8->row5,
-                                  panel6->row6, panel7->row6, panel8->row6,
-                                  panel6->row7, panel7->row7, panel8->row7,
-                                  panel6->row8, panel7->row8, panel8->row8,
-                                  panel6->row9, panel7->row9, panel8->row9,
-                                  panel6->row10, panel7->row10, panel8->row10,
-                                  panel6->row11, panel7->row11, panel8->row11};
-    
-    fseek_return = fseek(picture_file, *offset, SEEK_SET);
-    if (fseek_return)
-    {
-        CLEAR_CONSOLE;
-        (void) printf("Error 13: File position indicator could not be set in preparation for storing custom picture in memory.\n");
-        exit(13);
-    }
-
-    while (outer_counter < 108)
-    {
-        // Skipping the new-lines present after every three buffer-lengths:
-        if (inner_counter == 3)
+    // Lines 1 to 11 of each tile (below its top line), leaving out blank lines at the bottom; NULL is a blank line:
+    static const char *const heart[NUM_PANELS][DEFAULT_PANEL_HEIGHT - 1] = {
         {
-            inner_counter = 0;
-            told_pos = ftell(picture_file);
-            if (told_pos == -1)
-            {
-                CLEAR_CONSOLE;
-                (void) printf("Error 14: Failure to tell current file position when skipping new-lines.\n");
-                exit(14);
-            }
-
-            temp_offset = told_pos + (long) sizeof(char);
-
-            fseek_return = fseek(picture_file, temp_offset, SEEK_SET);
-            if (fseek_return)
-            {
-                CLEAR_CONSOLE;
-                (void) printf("Error 15: File position indicator could not be set to adjusted position when skipping new-lines.\n");
-                exit(15);
-            }
-        }
-
-        fread_return = fread(buffer, line_size, 1, picture_file);
-        if (fread_return < 1)
+            "|                                 ** |",
+            "|                               **   |",
+            "|                             **     |",
+            "|                           **       |",
+            "|                         **         |",
+            "|                       **           |",
+            "|                     **             |",
+            "|                   **               |",
+            "|                 **                 |",
+            "|                 **                 |",
+            "|                 **                 |"
+        },
         {
-            CLEAR_CONSOLE;
-            (void) printf("Error 16: Failure to read into buffer.\n");
-            exit(16);
+            "|***                              ***|",
+            "|   ***                        ***   |",
+            "|      **                    **      |",
+            "|        **                **        |",
+            "|          **            **          |",
+            "|            **        **            |",
+            "|              **    **              |",
+            "|                *  *                |",
+            "|                 **                 |"
+        },
+        {
+            "| **                                 |",
+            "|   **                               |",
+            "|     **                             |",
+            "|       **                           |",
+            "|         **                         |",
+            "|           **                       |",
+            "|             **                     |",
+            "|               **                   |",
+            "|                 **                 |",
+            "|                 **                 |",
+            "|                 **                 |"
+        },
+        {
+            "|                 **                 |",
+            "|                 **                 |",
+            "|                 **                 |",
+            "|                 **                 |",
+            "|                   **               |",
+            "|                     **             |",
+            "|                       **           |",
+            "|                         **         |",
+            "|                           **       |",
+            "|                             **     |",
+            "|                               **   |"
+        },
+        {NULL},
+        {
+            "|                 **                 |",
+            "|                 **                 |",
+            "|                 **                 |",
+            "|                 **                 |",
+            "|               **                   |",
+            "|             **                     |",
+            "|           **                       |",
+            "|         **                         |",
+            "|       **                           |",
+            "|     **                             |",
+            "|   **                               |"
+        },
+        {
+            "|                                   *|"
+        },
+        {
+            NULL,
+            "|*                                  *|",
+            "| **                              ** |",
+            "|   **                          **   |",
+            "|     **                      **     |",
+            "|       **                  **       |",
+            "|         **              **         |",
+            "|           **          **           |",
+            "|             **      **             |",
+            "|               **  **               |",
+            "|                 **                 |"
+        },
+        {
+            "|*                                   |"
         }
+    };
+    char *tile;
 
-        (void) strcat(strcpy(interlaced_rows[outer_counter], buffer), "\0");
-
-        inner_counter++;
-        outer_counter++;
+    *size = (Panel_Size) {.width = DEFAULT_PANEL_WIDTH, .height = DEFAULT_PANEL_HEIGHT};
+    for (int t = 0; t < NUM_PANELS; t++)
+    {
+        tile = tiles + (size_t) t * PANEL_BYTES(*size);
+        blank_panel(tile, *size, true, true);
+        for (int r = 1; r < DEFAULT_PANEL_HEIGHT; r++)
+            if (heart[t][r - 1] != NULL)
+                (void) memcpy(PANEL_LINE(tile, r, *size), heart[t][r - 1], DEFAULT_PANEL_WIDTH);
     }
-    
-    Panel_Row top = assemble_panel_row(*panel0, *panel1, *panel2);
-    Panel_Row middle = assemble_panel_row(*panel3, *panel4, *panel5);
-    Panel_Row bottom = assemble_panel_row(*panel6, *panel7, *panel8);
 
-    return assemble_panel_all(top, middle, bottom);
+    return grid_of(DEFAULT_SIDE, DEFAULT_SIDE);
 }
 
 
-/*************************************************************************************
- * print_panel_all():   Purpose: Receives a Panel_All and prints it to the screen.   *
- *                      Parameters: - Panel_All pa --> the Panel_All to be printed.  *
- *                      Return value: none                                           *
- *                      Side effects: - prints to stdout                             *
- *************************************************************************************/
-void print_panel_all(Panel_All pa)
+/***************************************************************************************************************************
+ * blank_panel():    Purpose: Stores blanked out graphics in a panel: a top line (or spaces), and lines of spaces between  *
+ *                              vertical bars (or just spaces)                                                             *
+ *                   Parameters: - char *panel --> pointer to the panel                                                    *
+ *                               - Panel_Size size --> the panel's size                                                    *
+ *                               - bool top --> whether to draw its top line                                               *
+ *                               - bool sides --> whether to draw its sides                                                *
+ *                   Return value: none                                                                                    *
+ *                   Side effects: - alters the panel pointed to by "char *panel"                                          *
+ ***************************************************************************************************************************/
+void blank_panel(char *panel, Panel_Size size, bool top, bool sides)
 {
-    print_panel_row(pa.top);
-    print_panel_row(pa.middle);
-    print_panel_row(pa.bottom);
-    (void) printf("%s\n", pa.final_row);
-
-    return;
+    (void) memset(panel, ' ', PANEL_BYTES(size));
+    if (top)
+        panel_top(panel, size.width);
+    for (int r = 1; r < size.height && sides; r++)
+        PANEL_LINE(panel, r, size)[0] = PANEL_LINE(panel, r, size)[size.width - 1] = '|';
 }
 
 
-/*************************************************************************************
- * print_panel_row():   Purpose: Receives a Panel_Row and prints it to the screen.   *
- *                      Parameters: - Panel_Row pr --> the Panel_Row to be printed.  *
- *                      Return value: none                                           *
- *                      Side effects: - prints to stdout                             *
- *************************************************************************************/
-void print_panel_row(Panel_Row pr)
+/******************************************************************************************************************************
+ * panel_top():      Purpose: Stores the top line of a panel (which is also the bottom line of the panel above it): a space,  *
+ *                              underscores, and another space                                                                *
+ *                   Parameters: - char *line --> pointer to the line                                                         *
+ *                               - int width --> the width of the panel                                                       *
+ *                   Return value: none                                                                                       *
+ *                   Side effects: - alters the line pointed to by "char *line"                                               *
+ ******************************************************************************************************************************/
+void panel_top(char *line, int width)
 {
-    (void) printf("%s\n%s\n%s\n%s\n%s\n%s\n%s\n%s\n%s\n%s\n%s\n%s\n", pr.row0, pr.row1, pr.row2, pr.row3, pr.row4, pr.row5, pr.row6, pr.row7, pr.row8, pr.row9, pr.row10, pr.row11);
-    return;
+    line[0] = ' ';
+    (void) memset(line + 1, '_', (size_t) width - 2);
+    line[width - 1] = ' ';
 }
 
 
-/***************************************************************************************************************************************
- * scramble_puzzle():   Purpose: Receives, in passed panel variable pointers, the strings making up a puzzle's graphics,               *
- *                                 randomly scrambles which panels go in which variables, randomly flips panels horizontally or        *
- *                                 vertically, stores the newly-scrambled panels in the original variables, stores the sidebar         *
- *                                 graphics in the passed pointers to final_piece and final_piece_text, assembles the puzzle into      *
- *                                 row pointers, and returns the combined, completed, scrambled puzzle for display.                    *
- *                      Parameters: - Panel *panel0 --> pointer to the variable containing the 0th panel                               *
- *                                  - Panel *panel1 --> pointer to the variable containing the 1st panel                               *
- *                                  - Panel *panel2 --> pointer to the variable containing the 2nd panel                               *
- *                                  - Panel *panel3 --> pointer to the variable containing the 3rd panel                               *
- *                                  - Panel *panel4 --> pointer to the variable containing the 4th panel                               *
- *                                  - Panel *panel5 --> pointer to the variable containing the 5th panel                               *
- *                                  - Panel *panel6 --> pointer to the variable containing the 6th panel                               *
- *                                  - Panel *panel7 --> pointer to the variable containing the 7th panel                               *
- *                                  - Panel *panel8 --> pointer to the variable containing the 8th panel                               *
- *                                  - Panel_Row *top --> pointer to the variable for storing the post-scramble top three panels        *
- *                                  - Panel_Row *middle --> pointer to the variable for storing the post-scramble middle three panels  *
- *                                  - Panel_Row *bottom --> pointer to the variable for storing the post-scramble bottom three panels  *
- *                                  - Panel_Row_Plus_Side_Panel *middle_and_side --> pointer to the variable for storing               *
- *                                      the post-scramble middle three panels plus the top portion of the sidebar graphics             *
- *                                  - Panel_Row_Plus_Side_Panel *bottom_and_side --> pointer to the variable for storing               *
- *                                      the post-scramble bottom three panels plus the bottom portion of the sidebar graphics          *
- *                                  - Panel *final_piece_text --> pointer to the variable for storing the top portion of the sidebar   *
- *                                  - Panel *final_piece --> pointer to the variable for storing the bottom portion of the sidebar     *
- *                      Return value: Panel_All_Plus_Side_Panel                                                                        *
- *                      Side effects: - alters the variables pointed to by every single parameter                                      *
- ***************************************************************************************************************************************/
-Panel_All_Plus_Side_Panel scramble_puzzle(Panel *panel0, Panel *panel1, Panel *panel2,
-                                          Panel *panel3, Panel *panel4, Panel *panel5,
-                                          Panel *panel6, Panel *panel7, Panel *panel8,
-                                          Panel_Row *top, Panel_Row *middle, Panel_Row *bottom,
-                                          Panel_Row_Plus_Side_Panel *middle_and_side, Panel_Row_Plus_Side_Panel *bottom_and_side,
-                                          Panel *final_piece_text, Panel *final_piece)
-{
-    int new_position;
-    bool position_options[8] = {true, true, true, true, true, true, true, true}; // Array represents whether a position (0-7) is available.
-    bool should_flip_over_x = false, should_flip_over_y = false;
-    Panel *panel_set[8] = {panel0, panel1, panel2, panel3, panel4, panel5, panel6, panel7};
-    Panel assembly_panel0, assembly_panel1, assembly_panel2,
-          assembly_panel3, assembly_panel4, assembly_panel5,
-          assembly_panel6, assembly_panel7, assembly_panel8;
-
-    // Creating the display's side panel:
-    *final_piece = *panel8;
-    *final_piece_text = (Panel) {
-                                    .row0 = GAP "\0",
-                                    .row1 = GAP "\0",
-                                    .row2 = GAP "\0",
-                                    .row3 = GAP "\0",
-                                    .row4 = GAP "\0",
-                                    .row5 = GAP "\0",
-                                    .row6 = GAP "\0",
-                                    .row7 = GAP "\0",
-                                    .row8 = GAP "\0",
-                                    .row9 = GAP "\0",
-                                    .row10 = GAP "\0",
-                                    .row11 = "  Final Piece:                        \0"
-                                };
-
-    // Seeding rand():
-    srand(time(NULL));
-
-    // Randomizing panel positions:
-    for (int i = 0; i < 8; i++)
-    {
-        do
+/*******************************************************************************************************************************************
+ * store_picture_from_file():   Purpose: Stores the graphics of a custom puzzle in the passed array of tiles                               *
+ *                              Parameters: - const Mapped_File *picture_file --> pointer to the mapped file containing the custom puzzle  *
+ *                                          - long offset --> the file offset which indicates the beginning of the custom puzzle           *
+ *                                                          (as found by check_formatting())                                               *
+ *                                          - const Grid *grid --> the puzzle's size (as found by check_formatting())                      *
+ *                                          - Panel_Size size --> the size of its panels (as found by check_formatting())                  *
+ *                                          - char tiles[] --> the array in which to store each tile's art, indexed by tile                *
+ *                              Return value: none                                                                                         *
+ *                              Side effects: - alters the array "char tiles[]"                                                            *
+ *******************************************************************************************************************************************/
+void store_picture_from_file(const Mapped_File *picture_file, long offset, const Grid *grid, Panel_Size size, char tiles[])
+{
+    size_t line_length = (size_t) FILE_LINE_LENGTH(grid->columns, size);
+    const char *source;
+
+    // Slice each panel's lines straight out of the mapped file; panel p's line r is on line (p / columns) * height + r of the
+    //     puzzle, width * (p % columns) characters in:
+    for (int p = 0; p < grid->cells; p++)
+        for (int r = 0; r < size.height; r++)
         {
-            new_position = rand() % (9 - 1); // 9 positions, but the 9th (position 8) is where the blank space will be, so it's invalid.
-        } while (position_options[new_position] == false); // Select new unused position.
-        position_options[new_position] = false; // Mark position as used.
-        panel_set[i]->position = new_position; // Assign position to panel.
-    }
-
-    // Randomizing panel orientations:
-    for (int i = 0; i < 8; i++)
-    {
-        should_flip_over_x = rand() % 2;
-        if (should_flip_over_x)
-            *panel_set[i] = flip_panel_over_x(*panel_set[i]);
-        should_flip_over_y = rand() % 2;
-        if (should_flip_over_y)
-            *panel_set[i] = flip_panel_over_y(*panel_set[i]);
-    }
-
-    // Loop to rename (through duplication) panel variables for assembly.
-    for (int i = 0; i < 8; i++)
-    {
-        if (panel_set[i]->position == 0)
-            assembly_panel0 = *panel_set[i];
-        else if (panel_set[i]->position == 1)
-            assembly_panel1 = *panel_set[i];
-        else if (panel_set[i]->position == 2)
-            assembly_panel2 = *panel_set[i];
-        else if (panel_set[i]->position == 3)
-            assembly_panel3 = *panel_set[i];
-        else if (panel_set[i]->position == 4)
-            assembly_panel4 = *panel_set[i];
-        else if (panel_set[i]->position == 5)
-            assembly_panel5 = *panel_set[i];
-        else if (panel_set[i]->position == 6)
-            assembly_panel6 = *panel_set[i];
-        else
-            assembly_panel7 = *panel_set[i];
-    }
-    assembly_panel8 = (Panel) {
-                                .position = 8,
-                                .row0 = PANEL_TOP "\0",
-                                .row1 = GAP "\0",
-                                .row2 = GAP "\0",
-                                .row3 = GAP "\0",
-                                .row4 = GAP "\0",
-                                .row5 = GAP "\0",
-                                .row6 = GAP "\0",
-                                .row7 = GAP "\0",
-                                .row8 = GAP "\0",
-                                .row9 = GAP "\0",
-                                .row10 = GAP "\0",
-                                .row11 = GAP "\0"
-                              }; //  assembly_panel8 is just a blank space (plus a top line, which serves as the bottom for the panel above it),
-                                 //     because it's the 'gap' used to slide other panels into.
-    
-    // This assignment section updates the actual panel variables with the scrambled versions to allow the player to manipulate them during play:
-    *panel0 = assembly_panel0;
-    *panel1 = assembly_panel1;
-    *panel2 = assembly_panel2;
-    *panel3 = assembly_panel3;
-    *panel4 = assembly_panel4;
-    *panel5 = assembly_panel5;
-    *panel6 = assembly_panel6;
-    *panel7 = assembly_panel7;
-    *panel8 = assembly_panel8;
-
-    panel0->is_gap = false;
-    panel1->is_gap = false;
-    panel2->is_gap = false;
-    panel3->is_gap = false;
-    panel4->is_gap = false;
-    panel5->is_gap = false;
-    panel6->is_gap = false;
-    panel7->is_gap = false;
-    panel8->is_gap = true;
-
-    // Assemble and return:
-    *top = assemble_panel_row(assembly_panel0, assembly_panel1, assembly_panel2);
-    *middle = assemble_panel_row(assembly_panel3, assembly_panel4, assembly_panel5);
-    *bottom = assemble_panel_row(assembly_panel6, assembly_panel7, assembly_panel8);
-    *middle_and_side = add_side_panel(*middle, *final_piece_text);
-    *bottom_and_side = add_side_panel(*bottom, *final_piece);
-
-    return assemble_all_plus_side(*top, *middle_and_side, *bottom_and_side, 8);
+            source = picture_file->data + offset + (size_t) ((p / grid->columns) * size.height + r) * line_length
+                     + (size_t) (p % grid->columns) * (size_t) size.width;
+            (void) memcpy(PANEL_LINE(tiles + (size_t) p * PANEL_BYTES(size), r, size), source, (size_t) size.width);
+        }
 }
 
 
-/*****************************************************************************************************************************
- * flip_panel_over_x():   Purpose: Flips a panel vertically (meaning, 'across the x-axis') and returns the flipped version.  *
- *                        Parameters: - Panel p --> a passed-by-value copy of the panel to be flipped                        *
- *                        Return value: Panel                                                                                *
- *                        Side effects: none                                                                                 *
- *****************************************************************************************************************************/
-Panel flip_panel_over_x(Panel p)
-{
-    Panel flipped_p = blank_panel();
-    flipped_p.position = p.position;
-    flipped_p.is_gap = p.is_gap;
-    (void) strcpy(flipped_p.row1, p.row11);
-    (void) strcpy(flipped_p.row2, p.row10);
-    (void) strcpy(flipped_p.row3, p.row9);
-    (void) strcpy(flipped_p.row4, p.row8);
-    (void) strcpy(flipped_p.row5, p.row7);
-    (void) strcpy(flipped_p.row6, p.row6);
-    (void) strcpy(flipped_p.row7, p.row5);
-    (void) strcpy(flipped_p.row8, p.row4);
-    (void) strcpy(flipped_p.row9, p.row3);
-    (void) strcpy(flipped_p.row10, p.row2);
-    (void) strcpy(flipped_p.row11, p.row1);
-    return flipped_p;
-}
+/*************************************************************************************************************************************
+ * store_picture_from_pack():   Purpose: Stores the graphics of one puzzle of a puzzle pack in the passed array of tiles, and        *
+ *                                          returns the puzzle's size. Only that puzzle's index entry, layout, and tile blocks are   *
+ *                                          read, so only their pages of the mapped pack are ever faulted in.                        *
+ *                              Parameters: - const Mapped_File *pack --> pointer to the mapped puzzle pack (already checked)        *
+ *                                          - uint32_t puzzle --> which puzzle of the pack to store, counting from 0                 *
+ *                                          - char tiles[] --> the array in which to store each tile's art, indexed by tile          *
+ *                                          - Panel_Size *size --> pointer to the variable in which to store the size of its panels  *
+ *                              Return value: const Grid                                                                             *
+ *                              Side effects: - alters the array "char tiles[]" and the variable pointed to by "Panel_Size *size"    *
+ *************************************************************************************************************************************/
+const Grid *store_picture_from_pack(const Mapped_File *pack, uint32_t puzzle, char tiles[], Panel_Size *size)
+{
+    const char *entry = pack_entry(pack, puzzle);
+    const Grid *grid = grid_of((unsigned char) entry[PACK_NAME_LENGTH], (unsigned char) entry[PACK_NAME_LENGTH + 1]);
+    const char *layout = pack->data + read_le32(entry + PACK_NAME_LENGTH + 4);
+    const char *tile_blocks = pack->data + read_le32(pack->data + 24);
 
+    // A tile block is laid out just as a tile is in memory:
+    *size = (Panel_Size) {.width = (unsigned char) entry[PACK_NAME_LENGTH + 2], .height = (unsigned char) entry[PACK_NAME_LENGTH + 3]};
+    for (int p = 0; p < grid->cells; p++)
+        (void) memcpy(tiles + (size_t) p * PANEL_BYTES(*size), tile_blocks + read_le32(layout + 4 * p), PANEL_BYTES(*size));
 
-/*******************************************************************************************************************************
- * flip_panel_over_y():   Purpose: Flips a panel horizontally (meaning, 'across the y-axis') and returns the flipped version.  *
- *                        Parameters: - Panel p --> a passed-by-value copy of the panel to be flipped                          *
- *                        Return value: Panel                                                                                  *
- *                        Side effects: none                                                                                   *
- *******************************************************************************************************************************/
-Panel flip_panel_over_y(Panel p) // flips a panel horizontally (meaning, 'across the y-axis')
-{
-    Panel flipped_p = blank_panel();
-    char reversed[ROW_WIDTH + 1] = {0};
-    flipped_p.position = p.position;
-    flipped_p.is_gap = p.is_gap;
-    (void) strcpy(flipped_p.row1, reverse(reversed, p.row1));
-    (void) strcpy(flipped_p.row2, reverse(reversed, p.row2));
-    (void) strcpy(flipped_p.row3, reverse(reversed, p.row3));
-    (void) strcpy(flipped_p.row4, reverse(reversed, p.row4));
-    (void) strcpy(flipped_p.row5, reverse(reversed, p.row5));
-    (void) strcpy(flipped_p.row6, reverse(reversed, p.row6));
-    (void) strcpy(flipped_p.row7, reverse(reversed, p.row7));
-    (void) strcpy(flipped_p.row8, reverse(reversed, p.row8));
-    (void) strcpy(flipped_p.row9, reverse(reversed, p.row9));
-    (void) strcpy(flipped_p.row10, reverse(reversed, p.row10));
-    (void) strcpy(flipped_p.row11, reverse(reversed, p.row11));
-    return flipped_p;
+    return grid;
 }
 
 
-/*******************************************************************************************************************************************
- * reverse():   Purpose: Reverses a passed string and returns a pointer to the reverse (like how strcpy() returns a pointer to the copy).  *
- *              Parameters: - char *reversed_string_holder --> a pointer to the array to hold the reversed string                          *
- *                          - char *string --> a pointer to the string to be reversed                                                      *
- *              Return value: char *                                                                                                       *
- *              Side effects: - alters the variable pointed to by char *reversed_string_holder                                             *
- *******************************************************************************************************************************************/
-char *reverse(char *reversed_string_holder, char *string)
-{
-    int length = strlen(string);
-    for (int i = 0; i < length; i++)
-    {
-        reversed_string_holder[i] = string[(length - 1) - i];
-    }
-    reversed_string_holder[length] = '\0';
-    return reversed_string_holder;
-}
-
-
-/**************************************************************************************************************************************************
- * add_side_panel():   Purpose: Accepts a Panel_Row and a desired extra Panel, and appends the extra Panel to the Panel_Row with a gap inbetween. *
- *                     Parameters: - Panel_Row pr --> the Panel_Row to be added to                                                                *
- *                                 - Panel side_panel --> the Panel to be appended                                                                *
- *                     Return value: Panel_Row_Plus_Side_Panel                                                                                    *
- *                     Side effects: none                                                                                                         *
- **************************************************************************************************************************************************/
-Panel_Row_Plus_Side_Panel add_side_panel(Panel_Row pr, Panel side_panel)
-{
-    Panel_Row_Plus_Side_Panel prplus = {
-                                        .row0 = *strcat(strcat(strcpy(prplus.row0, pr.row0), "   "), side_panel.row0),
-                                        .row1 = *strcat(strcat(strcpy(prplus.row1, pr.row1), "   "), side_panel.row1),
-                                        .row2 = *strcat(strcat(strcpy(prplus.row2, pr.row2), "   "), side_panel.row2),
-                                        .row3 = *strcat(strcat(strcpy(prplus.row3, pr.row3), "   "), side_panel.row3),
-                                        .row4 = *strcat(strcat(strcpy(prplus.row4, pr.row4), "   "), side_panel.row4),
-                                        .row5 = *strcat(strcat(strcpy(prplus.row5, pr.row5), "   "), side_panel.row5),
-                                        .row6 = *strcat(strcat(strcpy(prplus.row6, pr.row6), "   "), side_panel.row6),
-                                        .row7 = *strcat(strcat(strcpy(prplus.row7, pr.row7), "   "), side_panel.row7),
-                                        .row8 = *strcat(strcat(strcpy(prplus.row8, pr.row8), "   "), side_panel.row8),
-                                        .row9 = *strcat(strcat(strcpy(prplus.row9, pr.row9), "   "), side_panel.row9),
-                                        .row10 = *strcat(strcat(strcpy(prplus.row10, pr.row10), "   "), side_panel.row10),
-                                        .row11 = *strcat(strcat(strcpy(prplus.row11, pr.row11), "   "), side_panel.row11)
-                                       };
-    return prplus;
-}
-
-
-/**************************************************************************************************************************************************
- * asssemble_all_plus_side():   Purpose: assembles a Panel_Row variable and two Panel_Row_Plus_Side_Panel variables into a single unit.           *
- *                              Parameters: - Panel_Row top --> the Panel_Row intended to go on top                                               *
- *                                          - Panel_Row_Plus_Side_Panel middle --> the Panel_Row intended to go in the middle, plus a sidebar     *
- *                                          - Panel_Row_Plus_Side_Panel bottom --> the Panel_Row intended to go on the bottom, plus a sidebar     *
- *                                          - int gap --> the current position of the gap in the puzzle (needed to choose the correct final line) *
- *                     Return value: Panel_All_Plus_Side_Panel                                                                                    *
- *                     Side effects: none                                                                                                         *
- **************************************************************************************************************************************************/
-Panel_All_Plus_Side_Panel assemble_all_plus_side(Panel_Row top, Panel_Row_Plus_Side_Panel middle, Panel_Row_Plus_Side_Panel bottom, int gap)
-{
-    Panel_All_Plus_Side_Panel paplus = {
-                                        .top = top,
-                                        .middle = middle,
-                                        .bottom = bottom
-                                       };
-    if (gap == 6)
-        (void) strcpy(paplus.final_row, GAP PANEL_TOP PANEL_TOP "   " PANEL_TOP "\0");
-    else if (gap == 7)
-        (void) strcpy(paplus.final_row, PANEL_TOP GAP PANEL_TOP "   " PANEL_TOP "\0");
-    else if (gap == 8)
-        (void) strcpy(paplus.final_row, PANEL_TOP PANEL_TOP GAP "   " PANEL_TOP "\0");
-    else
-        (void) strcpy(paplus.final_row, PANEL_TOP PANEL_TOP PANEL_TOP "   " PANEL_TOP "\0");
-    return paplus;
+/************************************************************************************************************************
+ * print_picture():     Purpose: Prints a picture made of panels (in position order, a row of panels at a time) to the  *
+ *                                 passed file, with a new-line after every line but the last one                       *
+ *                      Parameters: - FILE *file --> the file to print to (such as stdout)                              *
+ *                                  - const Grid *grid --> the picture's size                                           *
+ *                                  - Panel_Size size --> the size of its panels                                        *
+ *                                  - const char *panels[] --> pointer to the panel in each position                    *
+ *                      Return value: int --> the number of characters printed, or a negative number on a write error   *
+ *                      Side effects: - prints to the passed file                                                       *
+ ************************************************************************************************************************/
+int print_picture(FILE *file, const Grid *grid, Panel_Size size, const char *panels[])
+{
+    char line[MAX_DISPLAY_WIDTH + 1];
+    int count = 0;
+    size_t length;
+
+    for (int l = 0; l <= size.height * grid->rows; l++)
+    {
+        // Each line is a row of every panel across, or, at the very end, a top line closing off the picture:
+        for (int c = 0; c < grid->columns; c++)
+            if (l < size.height * grid->rows)
+                (void) memcpy(line + size.width * c, PANEL_LINE(panels[l / size.height * grid->columns + c], l % size.height, size),
+                              (size_t) size.width);
+            else
+                panel_top(line + size.width * c, size.width);
+        length = (size_t) (size.width * grid->columns);
+        if (l < size.height * grid->rows)
+            line[length++] = '\n';
+        if (fwrite(line, 1, length, file) != length)
+            return -1;
+        count += (int) length;
+    }
+
+    return count;
 }
 
 
-/****************************************************************************************************************************
- * print_all_plus_side():   Purpose: prints a Panel_All_Plus_Side_Panel to the screen                                       *
- *                          Parameters: - Panel_All_Plus_Side_Panel paplus --> the Panel_All_Plus_Side_Panel to be printed  *
- *                          Return value: none                                                                              *
- *                          Side effects: - prints to stdout                                                                  *
- ****************************************************************************************************************************/
-void print_all_plus_side(Panel_All_Plus_Side_Panel paplus)
+/**********************************************************************************
+ * print_solution():    Purpose: Prints a puzzle's solved picture to the screen   *
+ *                      Parameters: - const Tile_Atlas *atlas --> pointer to the  *
+ *                                      puzzle's art                              *
+ *                      Return value: none                                        *
+ *                      Side effects: - prints to stdout                          *
+ **********************************************************************************/
+void print_solution(const Tile_Atlas *atlas)
 {
-    print_panel_row(paplus.top);
-    print_row_plus_side(paplus.middle);
-    print_row_plus_side(paplus.bottom);
-    (void) printf("%s\n", paplus.final_row);
+    const char *panels[MAX_CELLS];
+
+    for (int p = 0; p < atlas->grid->cells; p++)
+        panels[p] = atlas_panel(atlas, p * NUM_ORIENTATIONS);
+    (void) print_picture(stdout, atlas->grid, atlas->size, panels);
+    (void) printf("\n");
 
     return;
 }
 
 
-/****************************************************************************************************************************
- * print_row_plus_side():   Purpose: prints a Panel_Row_Plus_Side_Panel to the screen                                       *
- *                          Parameters: - Panel_Row_Plus_Side_Panel prplus --> the Panel_Row_Plus_Side_Panel to be printed  *
- *                          Return value: none                                                                              *
- *                          Side effects: - prints to stdout                                                                  *
- ****************************************************************************************************************************/
-void print_row_plus_side(Panel_Row_Plus_Side_Panel prplus)
+/********************************************************************************************************************************************
+ * scramble_puzzle():   Purpose: Randomly scrambles which tiles go in which positions and randomly flips tiles horizontally or vertically,  *
+ *                                 storing the result in the passed board, stores the sidebar graphics in the passed pointers to            *
+ *                                 final_piece and final_piece_text, and composes the scrambled puzzle into the passed display.             *
+ *                                 The scramble is always solvable: with the gap starting in the last position, only even                   *
+ *                                 permutations of the tiles can be reached by sliding, so an odd shuffle has its first two tiles           *
+ *                                 swapped. If a difficulty is given, the board is instead drawn by board_at_difficulty(), and the          *
+ *                                 gap may start anywhere.                                                                                  *
+ *                      Parameters: - const Tile_Atlas *atlas --> pointer to the puzzle's art in every orientation                          *
+ *                                  - Board *board --> pointer to the variable for storing the scrambled board                              *
+ *                                  - const char **final_piece_text --> pointer to the variable for storing the top portion of the sidebar  *
+ *                                  - const char **final_piece --> pointer to the variable for storing the bottom portion of the sidebar    *
+ *                                  - Display *display --> pointer to the variable for storing the scrambled puzzle                         *
+ *                                  - Rng *rng --> pointer to the random number generator to draw the scramble from                         *
+ *                                  - const Distance_Table *table --> pointer to the distance table (used only with a difficulty, and only  *
+ *                                      on 3x3 boards; NULL otherwise)                                                                      *
+ *                                  - int difficulty --> the number of moves the scramble should be from solved                             *
+ *                                      (or -1 for a uniformly random scramble)                                                             *
+ *                      Return value: none                                                                                                  *
+ *                      Side effects: - alters the variables pointed to by every parameter save "atlas" and "table"                         *
+ ********************************************************************************************************************************************/
+void scramble_puzzle(const Tile_Atlas *atlas, Board *board, const char **final_piece_text, const char **final_piece,
+                     Display *display, Rng *rng, const Distance_Table *table, int difficulty)
 {
-    (void) printf("%s\n%s\n%s\n%s\n%s\n%s\n%s\n%s\n%s\n%s\n%s\n%s\n", prplus.row0, prplus.row1, prplus.row2,
-                                                                      prplus.row3, prplus.row4, prplus.row5,
-                                                                      prplus.row6, prplus.row7, prplus.row8,
-                                                                      prplus.row9, prplus.row10, prplus.row11);
-    return;
-}
+    int tile_count = atlas->grid->cells - 1; // Every tile but the gap.
+    Viewport view = full_view(atlas->grid);
+    int positions[MAX_CELLS - 1]; // The position of each tile; the last position is where the blank space will be.
+    int swap, temp;
+    int parity = 0; // Whether the shuffle so far is an odd permutation.
+    uint32_t bits = 0;
 
+    make_sidebar(atlas, final_piece_text, final_piece);
 
-/********************************************************************************************************
- * read_line():   Purpose: reads and stores user input, and returns the number of characters stored     *
- *                Parameters: - char input[] --> the array in which to store user input                 *
- *                            - int n --> the maximum amount of characters that can be stored           *
+    if (difficulty >= 0)
+    {
+        *board = board_at_difficulty(atlas, table, rng, difficulty);
+        update_display(atlas, board, *final_piece_text, *final_piece, &view, display);
+        return;
+    }
+
+    // The gap always starts in the last position:
+    *board = solved_board(atlas->grid);
+
+    // Randomizing tile positions (Fisher-Yates shuffle, counting the swaps' parity as it goes):
+    for (int i = 0; i < tile_count; i++)
+        positions[i] = i;
+    for (int i = tile_count - 1; i > 0; i--)
+    {
+        swap = (int) rng_below(rng, (uint32_t) i + 1);
+        if (swap != i)
+        {
+            temp = positions[i];
+            positions[i] = positions[swap];
+            positions[swap] = temp;
+            parity ^= 1;
+        }
+    }
+    if (parity) // Unreachable by sliding, so one more swap makes it solvable.
+    {
+        temp = positions[0];
+        positions[0] = positions[1];
+        positions[1] = temp;
+    }
+    for (int i = 0; i < tile_count; i++)
+        board->tiles[positions[i]] = (uint8_t) i; // Assign tile to position.
+
+    // Randomizing tile orientations (two bits for each tile, sixteen tiles to a random number; any orientation can be
+    //     flipped back):
+    for (int i = 0; i < tile_count; i++)
+    {
+        if (i % 16 == 0)
+            bits = rng_next(rng);
+        board->orientations[i] = (uint8_t) (bits >> (2 * (i % 16)) & 3);
+    }
+    update_display(atlas, board, *final_piece_text, *final_piece, &view, display);
+
+    return;
+}
+
+
+/******************************************************************************************************************************
+ * flip_panel_over_x():   Purpose: Flips a panel vertically (meaning, 'across the x-axis'), storing the flipped version; its  *
+ *                                   top line stays on top                                                                    *
+ *                        Parameters: - char *flipped --> pointer to the panel for storing the flipped version                *
+ *                                    - const char *panel --> pointer to the panel to be flipped                              *
+ *                                    - Panel_Size size --> the size of both                                                  *
+ *                        Return value: none                                                                                  *
+ *                        Side effects: - alters the panel pointed to by "char *flipped"                                      *
+ ******************************************************************************************************************************/
+void flip_panel_over_x(char *flipped, const char *panel, Panel_Size size)
+{
+    (void) memcpy(flipped, panel, (size_t) size.width);
+    for (int r = 1; r < size.height; r++)
+        (void) memcpy(PANEL_LINE(flipped, r, size), PANEL_LINE(panel, size.height - r, size), (size_t) size.width);
+}
+
+
+/***************************************************************************************************************************
+ * flip_panel_over_y():   Purpose: Flips a panel horizontally (meaning, 'across the y-axis'), storing the flipped version  *
+ *                        Parameters: - char *flipped --> pointer to the panel for storing the flipped version             *
+ *                                    - const char *panel --> pointer to the panel to be flipped                           *
+ *                                    - Panel_Size size --> the size of both                                               *
+ *                        Return value: none                                                                               *
+ *                        Side effects: - alters the panel pointed to by "char *flipped"                                   *
+ ***************************************************************************************************************************/
+void flip_panel_over_y(char *flipped, const char *panel, Panel_Size size) // flips a panel horizontally (meaning, 'across the y-axis')
+{
+    for (int r = 0; r < size.height; r++)
+        mirror_line(PANEL_LINE(flipped, r, size), PANEL_LINE(panel, r, size), size.width);
+}
+
+
+/********************************************************************************************************************************
+ * mirror_line():         Purpose: Stores a line of characters reversed, a vector at a time (32 bytes with AVX2, 16 with SSE2;  *
+ *                                   see KERNEL_SET): each vector is taken from the far end of the line, its bytes reversed     *
+ *                                   with shuffles, and stored at the near end. What is left over is reversed byte by byte.     *
+ *                        Parameters: - char *mirrored --> pointer to the line for storing the reversed version                 *
+ *                                    - const char *line --> pointer to the line to be reversed (not overlapping the other)     *
+ *                                    - int width --> the number of characters in each                                          *
+ *                        Return value: none                                                                                    *
+ *                        Side effects: - alters the line pointed to by "char *mirrored"                                        *
+ ********************************************************************************************************************************/
+void mirror_line(char *mirrored, const char *line, int width)
+{
+    int done = 0; // Characters of "mirrored" stored so far; they come from the last "done" characters of "line".
+#if defined(AVX2_KERNELS)
+    const __m256i reverse = _mm256_setr_epi8(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0,
+                                             15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+    __m256i v;
+
+    // Reverse the bytes within each 16-byte lane, then swap the lanes:
+    for (; width - done >= 32; done += 32)
+    {
+        v = _mm256_loadu_si256((const __m256i *) (line + width - done - 32));
+        v = _mm256_permute4x64_epi64(_mm256_shuffle_epi8(v, reverse), _MM_SHUFFLE(1, 0, 3, 2));
+        _mm256_storeu_si256((__m256i *) (mirrored + done), v);
+    }
+#endif
+#if defined(AVX2_KERNELS) || defined(SSE2_KERNELS)
+    __m128i u;
+
+    // SSE2 has no byte shuffle, so swap the bytes of each 16-bit word, reverse the words of each half, and swap the halves:
+    for (; width - done >= 16; done += 16)
+    {
+        u = _mm_loadu_si128((const __m128i *) (line + width - done - 16));
+        u = _mm_or_si128(_mm_slli_epi16(u, 8), _mm_srli_epi16(u, 8));
+        u = _mm_shufflehi_epi16(_mm_shufflelo_epi16(u, _MM_SHUFFLE(0, 1, 2, 3)), _MM_SHUFFLE(0, 1, 2, 3));
+        _mm_storeu_si128((__m128i *) (mirrored + done), _mm_shuffle_epi32(u, _MM_SHUFFLE(1, 0, 3, 2)));
+    }
+#endif
+    mirror_line_scalar(mirrored + done, line, width - done);
+}
+
+
+/*******************************************************************************************************************************
+ * mirror_line_scalar():  Purpose: Stores a line of characters reversed, byte by byte: mirror_line()'s portable fallback, and  *
+ *                                   the baseline "--bench-kernels" measures it against                                        *
+ *                        Parameters: - char *mirrored --> pointer to the line for storing the reversed version                *
+ *                                    - const char *line --> pointer to the line to be reversed (not overlapping the other)    *
+ *                                    - int width --> the number of characters in each                                         *
+ *                        Return value: none                                                                                   *
+ *                        Side effects: - alters the line pointed to by "char *mirrored"                                       *
+ *******************************************************************************************************************************/
+void mirror_line_scalar(char *mirrored, const char *line, int width)
+{
+    for (int c = 0; c < width; c++)
+        mirrored[c] = line[width - 1 - c];
+}
+
+
+/********************************************************************************************************
+ * read_line():   Purpose: reads and stores user input, and returns the number of characters stored     *
+ *                Parameters: - char input[] --> the array in which to store user input                 *
+ *                            - int n --> the maximum amount of characters that can be stored           *
  *                Return value: int                                                                     *
  *                Side effects: - fetches from stdin                                                    *
  *                              - modifies the array input[]                                            *
@@ -1306,39 +1815,33 @@ int read_line(char input[], int n)
  * parse_command():   Purpose: Receives and acts upon the command previously entered by the user, and returns whether command was valid  *
  *                    Parameters: - char *command --> the string containing the user's command                                           *
  *                                - int n --> the length (in characters) of the user's command                                           *
- *                                - Panel_All solution --> the completed puzzle, to be shown on the screen                               *
- *                                - Panel *panel0 --> pointer to the variable containing the 0th panel                                   *
- *                                - Panel *panel1 --> pointer to the variable containing the 1st panel                                   *
- *                                - Panel *panel2 --> pointer to the variable containing the 2nd panel                                   *
- *                                - Panel *panel3 --> pointer to the variable containing the 3rd panel                                   *
- *                                - Panel *panel4 --> pointer to the variable containing the 4th panel                                   *
- *                                - Panel *panel5 --> pointer to the variable containing the 5th panel                                   *
- *                                - Panel *panel6 --> pointer to the variable containing the 6th panel                                   *
- *                                - Panel *panel7 --> pointer to the variable containing the 7th panel                                   *
- *                                - Panel *panel8 --> pointer to the variable containing the 8th panel                                   *
+ *                                - Sp_State *state --> pointer to the puzzle being played                                               *
+ *                                - Solution *autoplay --> pointer to the variable for storing moves to be played back                   *
  *                                - bool *submit --> pointer to the variable stating whether the user wishes to submit the puzzle        *
  *                                      for win/loss verification                                                                        *
+ *                                - bool *repaint --> pointer to the variable stating whether the command took over the screen,          *
+ *                                      so that the puzzle must be redrawn in full                                                       *
  *                    Return value: bool                                                                                                 *
- *                    Side effects: - alters the variables pointed to by the Panel * parameters and the bool * parameter                 *
+ *                    Side effects: - alters the variables pointed to by the Sp_State *, Solution *, and bool * parameters               *
  *                                  - prints to stdout                                                                                   *
  *                                  - clears CLI screen and scrollback                                                                   *
  *                                  - terminates program                                                                                 *
  *****************************************************************************************************************************************/
-bool parse_command(char *command, int n, Panel_All solution,
-                   Panel *panel0, Panel *panel1, Panel *panel2,
-                   Panel *panel3, Panel *panel4, Panel *panel5,
-                   Panel *panel6, Panel *panel7, Panel *panel8,
-                   bool *submit)
+bool parse_command(char *command, int n, Sp_State *state, Solution *autoplay, bool *submit, bool *repaint)
 {
     bool valid = true;
-    int panel_number;
-    Panel *gap_panel = NULL;
-    Panel *panel_set[9] = {panel0, panel1, panel2, panel3, panel4, panel5, panel6, panel7, panel8};
+    uint8_t move;
+    const char *refusals[4] = {"below", "above", "to the right of", "to the left of"}; // Indexed by slide direction
+    uint8_t sequence[MAX_LINE]; // The moves of a multi-move command
+    int count, possible;
+    Solution hint;
+    char hint_command[MAX_LINE];
 
     if (caseless_cmp(command, "help"))
     {
         CLEAR_CONSOLE;
         print_command_listing();
+        *repaint = true;
     }
     else if (caseless_cmp(command, "quit") || caseless_cmp(command, "q"))
     {
@@ -1348,188 +1851,88 @@ bool parse_command(char *command, int n, Panel_All solution,
     else if (caseless_cmp(command, "show numbering"))
     {
         CLEAR_CONSOLE;
-        print_numbers();
+        print_numbers(state->atlas.grid, state->atlas.size);
+        *repaint = true;
     }
     else if (caseless_cmp(command, "show solution"))
     {
         CLEAR_CONSOLE;
         (void) printf("Solution:\n");
-        print_panel_all(solution);
+        print_solution(&state->atlas);
         (void) printf("\n\n----PRESS ENTER----\n\n");
         while (getchar() != '\n');
+        *repaint = true;
     }
-    else if (caseless_skip_digit_cmp_no9(command, "flip panel 0 horizontally") || caseless_skip_digit_cmp_no9(command, "0 h"))
+    else if (command_to_move(command, n, &move))
     {
-        for (int i = 0; i < n; i++)
-            if (isdigit(*(command + i)))
-            {
-                panel_number = atoi(command + i);
-                break;
-            }
-        if (SELECTED_PANEL->is_gap)
+        if (sp_apply_moves(state, &move, 1) == 0)
         {
-            (void) printf("Cannot flip gap.\n");
+            if ((move & 3) && move >> 2 >= state->atlas.grid->cells)
+                (void) printf("There is no panel %d on this board.\n", move >> 2);
+            else if ((move & 3) == ROTATE)
+                (void) printf("Cannot rotate gap.\n");
+            else if (move & 3)
+                (void) printf("Cannot flip gap.\n");
+            else
+                (void) printf("Cannot comply--no panel exists %s the gap.\n", refusals[move >> 2]);
             valid = !valid;
         }
-        if (valid)
-        {
-            *SELECTED_PANEL = flip_panel_over_y(*SELECTED_PANEL);
-        }
     }
-    else if (caseless_skip_digit_cmp_no9(command, "flip panel 0 vertically") || caseless_skip_digit_cmp_no9(command, "0 v"))
+    else if (caseless_cmp(command, "undo") || caseless_cmp(command, "u"))
     {
-        for (int i = 0; i < n; i++)
-            if (isdigit(*(command + i)))
-            {
-                panel_number = atoi(command + i);
-                break;
-            }
-        if (SELECTED_PANEL->is_gap)
+        if (!sp_undo(state))
         {
-            (void) printf("Cannot flip gap.\n");
+            (void) printf("Nothing to undo.\n");
             valid = !valid;
         }
-        if (valid)
-        {
-            *SELECTED_PANEL = flip_panel_over_x(*SELECTED_PANEL);
-        }
     }
-    else if (caseless_skip_digit_cmp_no9(command, "rotate panel 0") || caseless_skip_digit_cmp_no9(command, "0 r"))
+    else if (caseless_cmp(command, "redo") || caseless_cmp(command, "y"))
     {
-        for (int i = 0; i < n; i++)
-            if (isdigit(*(command + i)))
-            {
-                panel_number = atoi(command + i);
-                break;
-            }
-        if (SELECTED_PANEL->is_gap)
+        if (!sp_redo(state))
         {
-            (void) printf("Cannot rotate gap.\n");
+            (void) printf("Nothing to redo.\n");
             valid = !valid;
         }
-        if (valid)
-        {
-            *SELECTED_PANEL = flip_panel_over_y(*SELECTED_PANEL);
-            *SELECTED_PANEL = flip_panel_over_x(*SELECTED_PANEL);
-        }
-    }
-    else if (caseless_cmp(command, "down") || caseless_cmp(command, "s"))
-    {
-        for (int i = 0; i < 9; i++)
-        {
-            if (panel_set[i]->is_gap)
-            {
-                gap_panel = panel_set[i];
-                if (gap_panel->position == 0 || gap_panel->position == 1 || gap_panel->position == 2)
-                {
-                    (void) printf("Cannot comply--no panel exists above the gap.\n");
-                    valid = !valid;
-                }
-                break;
-            }
-        }
-        if (valid)
-        {
-            for (int i = 0; i < 9; i++)
-            {
-                if (panel_set[i]->position == gap_panel->position - 3) // "gap_panel->position - 3" equates to the position of the panel above the gap.
-                {
-                    panel_set[i]->position = gap_panel->position;
-                    gap_panel->position = gap_panel->position - 3;
-                    if (gap_panel->position == 0 || gap_panel->position == 1 || gap_panel->position == 2)
-                        (void) strcpy(gap_panel->row0, GAP "\0");
-                    break;
-                }
-            }
-        }
     }
-    else if (caseless_cmp(command, "right") || caseless_cmp (command, "d"))
+    else if (caseless_cmp(command, "submit"))
+        *submit = true;
+    else if (caseless_cmp(command, "hint"))
     {
-        for (int i = 0; i < 9; i++)
-        {
-            if (panel_set[i]->is_gap)
-            {
-                gap_panel = panel_set[i];
-                if (gap_panel->position == 0 || gap_panel->position == 3 || gap_panel->position == 6)
-                {
-                    (void) printf("Cannot comply--no panel exists to the left of the gap.\n");
-                    valid = !valid;
-                }
-                break;
-            }
-        }
-        if (valid)
-        {
-            for (int i = 0; i < 9; i++)
-            {
-                if (panel_set[i]->position == gap_panel->position - 1)
-                {
-                    panel_set[i]->position = gap_panel->position;
-                    gap_panel->position = gap_panel->position - 1;
-                    break;
-                }
-            }
-        }
+        CLEAR_CONSOLE;
+        if (!solve_board(&state->atlas, state_table(state), &state->board, &hint))
+            (void) printf("%s\n", board_solvable(&state->atlas, &state->board) ? TOO_FAR_MESSAGE : "No solution exists for this board.");
+        else if (hint.length == 0)
+            (void) printf("Hint: the puzzle is already solved.\n");
+        else
+            (void) printf("Hint: \"%s\" (%d move%s from solved).\n", move_to_command(hint_command, hint.moves[0]),
+                          hint.length, hint.length == 1 ? "" : "s");
+        (void) printf("\n\n----PRESS ENTER----\n\n");
+        while (getchar() != '\n');
+        *repaint = true;
     }
-    else if (caseless_cmp(command, "up") || caseless_cmp(command, "w"))
+    else if (caseless_cmp(command, "solve"))
     {
-        for (int i = 0; i < 9; i++)
-        {
-            if (panel_set[i]->is_gap)
-            {
-                gap_panel = panel_set[i];
-                if (gap_panel->position == 6 || gap_panel->position == 7 || gap_panel->position == 8)
-                {
-                    (void) printf("Cannot comply--no panel exists below the gap.\n");
-                    valid = !valid;
-                }
-                break;
-            }
-        }
-        if (valid)
+        if (!solve_board(&state->atlas, state_table(state), &state->board, autoplay))
         {
-            for (int i = 0; i < 9; i++)
-            {
-                if (panel_set[i]->position == gap_panel->position + 3)
-                {
-                    panel_set[i]->position = gap_panel->position;
-                    gap_panel->position = gap_panel->position + 3;
-                    (void) strcpy(gap_panel->row0, PANEL_TOP "\0");
-                    break;
-                }
-            }
+            (void) printf("%s\n", board_solvable(&state->atlas, &state->board) ? TOO_FAR_MESSAGE : "No solution exists for this board.");
+            valid = !valid;
         }
+        else if (autoplay->length == 0)
+            *submit = true;
     }
-    else if (caseless_cmp(command, "left") || caseless_cmp(command, "a"))
+    else if ((count = command_to_moves(command, sequence, MAX_LINE)) > 0)
     {
-        for (int i = 0; i < 9; i++)
+        // All the moves are made, or none of them, and the puzzle is redrawn just once:
+        possible = (int) sp_check_moves(state, sequence, (size_t) count);
+        if (possible < count)
         {
-            if (panel_set[i]->is_gap)
-            {
-                gap_panel = panel_set[i];
-                if (gap_panel->position == 2 || gap_panel->position == 5 || gap_panel->position == 8)
-                {
-                    (void) printf("Cannot comply--no panel exists to the right of the gap.\n");
-                    valid = !valid;
-                }
-                break;
-            }
-        }
-        if (valid)
-        {
-            for (int i = 0; i < 9; i++)
-            {
-                if (panel_set[i]->position == gap_panel->position + 1)
-                {
-                    panel_set[i]->position = gap_panel->position;
-                    gap_panel->position = gap_panel->position + 1;
-                    break;
-                }
-            }
+            (void) printf("Move %d of %d (\"%s\") cannot be made; none of the moves were made.\n", possible + 1, count,
+                          move_to_command(hint_command, sequence[possible]));
+            valid = !valid;
         }
+        else
+            (void) sp_apply_moves(state, sequence, (size_t) count);
     }
-    else if (caseless_cmp(command, "submit"))
-        *submit = true;
     else
     {
         (void) printf("Command not recognized.\n");
@@ -1578,7 +1981,12 @@ void print_command_listing(void)
     (void) printf("'Right' or 'd': Shifts the panel left of the gap rightward to fill the gap.\n");
     (void) printf("'Up' or 'w': Shifts the panel below the gap upward to fill the gap.\n");
     (void) printf("'Left' or 'a': Shifts the panel right of the gap leftward to fill the gap.\n");
-    (void) printf("'Submit': Checks puzzle against solution in order to win.\n");
+    (void) printf("Several short moves on one line, such as 'wwaasd 2h 5r': Makes all of them, or none if any can't be made.\n");
+    (void) printf("'Submit': Checks puzzle against solution (the puzzle is won as soon as it is complete, in any case).\n");
+    (void) printf("'Hint': Shows the next move of an optimal solution.\n");
+    (void) printf("'Solve': Plays out an optimal solution from the current board.\n");
+    (void) printf("'Undo' or 'u': Takes back the last move (as many times as there have been moves).\n");
+    (void) printf("'Redo' or 'y': Makes again the last move taken back, until a new move is made.\n");
 
     (void) printf("\n\n");
     (void) printf("Commands are not case-sensitive.\n\n");
@@ -1590,33 +1998,31 @@ void print_command_listing(void)
 
 /************************************************************************************
  * print_numbers():   Purpose: prints a display showing the panel numbering system  *
- *                    Parameters: none                                              *
+ *                    Parameters: - const Grid *grid --> the puzzle's size          *
+ *                                - Panel_Size size --> the size of its panels      *
  *                    Return value: none                                            *
  *                    Side effects: - prints to stdout                              *
  ************************************************************************************/
-void print_numbers(void)
-{
-    Panel p0, p1, p2, p3, p4, p5, p6, p7, p8;
-    Panel_Row top, middle, bottom;
-    Panel_All number_display;
-    p0 = p1 = p2 = p3 = p4 = p5 = p6 = p7 = p8 = blank_panel();
-    (void) strcpy(p0.row6, "|              Panel 0               |");
-    (void) strcpy(p1.row6, "|              Panel 1               |");
-    (void) strcpy(p2.row6, "|              Panel 2               |");
-    (void) strcpy(p3.row6, "|              Panel 3               |");
-    (void) strcpy(p4.row6, "|              Panel 4               |");
-    (void) strcpy(p5.row6, "|              Panel 5               |");
-    (void) strcpy(p6.row6, "|              Panel 6               |");
-    (void) strcpy(p7.row6, "|              Panel 7               |");
-    (void) strcpy(p8.row6, "|              Panel 8               |");
-
-    top = assemble_panel_row(p0, p1, p2);
-    middle = assemble_panel_row(p3, p4, p5);
-    bottom = assemble_panel_row(p6, p7, p8);
-
-    number_display = assemble_panel_all(top, middle, bottom);
+void print_numbers(const Grid *grid, Panel_Size size)
+{
+    char numbered[MAX_PICTURE_SIZE];
+    const char *panels[MAX_CELLS];
+    char label[16];
+    int length;
+
+    for (int p = 0; p < grid->cells; p++)
+    {
+        // Centred halfway down the panel, as "Panel 7" if there is room, or else just "7":
+        panels[p] = numbered + (size_t) p * PANEL_BYTES(size);
+        blank_panel(numbered + (size_t) p * PANEL_BYTES(size), size, true, true);
+        length = sprintf(label, size.width - 2 >= 8 ? "Panel %-2d" : "%-2d", p);
+        (void) memcpy(PANEL_LINE(numbered + (size_t) p * PANEL_BYTES(size), size.height / 2, size) + (size.width - length) / 2,
+                      label, (size_t) length);
+    }
+
     (void) printf("Numbering:\n");
-    print_panel_all(number_display);
+    (void) print_picture(stdout, grid, size, panels);
+    (void) printf("\n");
 
     (void) printf("\n\n----PRESS ENTER----\n\n");
     while (getchar() != '\n');
@@ -1626,200 +2032,268 @@ void print_numbers(void)
 
 
 /******************************************************************************************************************************
- * caseless_skip_digit_cmp_no9():   Purpose: Compares two strings irrespective of case, while ignoring differences in digits. *
- *                                             Returns false if str1[] contains the digit '9'                                 *
- *                                  Parameters: - char str1[] --> the first string to be compared ('9'-sensitive)             *
- *                                              - char str2[] --> the second string to be compared ('9'-insensitive)          *
- *                                  Return value: bool                                                                        *
- *                                  Side effects: none                                                                        *
+ * update_display():    Purpose: Composes the display for the part of the current board in view, copying each panel line      *
+ *                                 straight from the atlas to its known place in the display, with no intermediate rows;      *
+ *                                 panels out of view are never touched, so the work is bounded by the terminal's size        *
+ *                      Parameters: - const Tile_Atlas *atlas --> pointer to the puzzle's art in every orientation            *
+ *                                  - const Board *board --> pointer to the variable containing the current board             *
+ *                                  - const char *final_piece_text --> pointer to the top portion of the sidebar              *
+ *                                  - const char *final_piece --> pointer to the bottom portion of the sidebar                *
+ *                                  - const Viewport *view --> pointer to the part of the board to compose (see full_view())  *
+ *                                  - Display *display --> pointer to the variable for storing the display                    *
+ *                      Return value: none                                                                                    *
+ *                      Side effects: - alters the variable pointed to by "Display *display"                                  *
  ******************************************************************************************************************************/
-bool caseless_skip_digit_cmp_no9(char str1[], char str2[])
+void update_display(const Tile_Atlas *atlas, const Board *board, const char *final_piece_text, const char *final_piece,
+                    const Viewport *view, Display *display)
 {
-    if (strlen(str1) != strlen(str2))
-        return false;
-    for (int i = 0; str1[i]; i++)
+    const Grid *grid = board->grid;
+    Panel_Size size = atlas->size;
+    const char *assembly_panels[MAX_GRID_SIDE];
+    const char *side_panel;
+    int width = size.width * view->columns; // Characters in a row of panels, without the sidebar
+    int last_row = view->first_row + view->rows; // The row below the last one shown
+    int line = 0;
+    int position, tile;
+
+    // Copy in each line of each row of panels in view, followed by the sidebar (beside the board's last two rows):
+    for (int row = view->first_row; row < last_row; row++)
     {
-        if (isdigit(str1[i]))
+        // Point at the atlas entry of whichever tile sits in each position, in its current orientation:
+        for (int j = 0; j < view->columns; j++)
         {
-            if (str1[i] == '9') // This bizarre check prevents a bug wherein commands with the number 9 are interpreted as using the number 8 instead,
-                                //      due to the implementation of the "SELECTED_PANEL" macro.
-            {
-                return false;
-            }
-            else if (isdigit(str2[i]))
-            {
-                continue;
-            }
+            position = row * grid->columns + view->first_column + j;
+            tile = board_tile_at(board, position);
+            if (tile == grid->cells - 1)
+                assembly_panels[j] = atlas_panel(atlas, ATLAS_GAP(grid, position < grid->columns));
             else
+                assembly_panels[j] = atlas_panel(atlas, tile * NUM_ORIENTATIONS + board_orientation(board, tile));
+        }
+        side_panel = !view->sidebar ? NULL : row == grid->rows - 2 ? final_piece_text : row == grid->rows - 1 ? final_piece : NULL;
+        for (int i = 0; i < size.height; i++, line++)
+        {
+            for (int j = 0; j < view->columns; j++)
+                (void) memcpy(display->text[line] + j * size.width, PANEL_LINE(assembly_panels[j], i, size), (size_t) size.width);
+            display->lengths[line] = width;
+            if (side_panel != NULL)
             {
-                return false;
+                (void) memcpy(display->text[line] + width, "   ", 3);
+                (void) memcpy(display->text[line] + width + 3, PANEL_LINE(side_panel, i, size), (size_t) size.width);
+                display->lengths[line] = width + 3 + size.width;
             }
+            display->text[line][display->lengths[line]] = '\0';
         }
-        else if (tolower(str1[i]) != tolower(str2[i]))
-            return false;
     }
-    return true;
+
+    // The final line closes off the last row shown, except under the gap (and is just the top line of the row below, if
+    //     there is one):
+    for (int j = 0; j < view->columns; j++)
+        if (last_row == grid->rows && board->gap == grid->cells - grid->columns + view->first_column + j)
+            (void) memset(display->text[line] + j * size.width, ' ', (size_t) size.width);
+        else
+            panel_top(display->text[line] + j * size.width, size.width);
+    display->lengths[line] = width;
+    if (view->sidebar && last_row == grid->rows)
+    {
+        (void) memcpy(display->text[line] + width, "   ", 3);
+        panel_top(display->text[line] + width + 3, size.width);
+        display->lengths[line] = width + 3 + size.width;
+    }
+    display->text[line][display->lengths[line]] = '\0';
+    display->lines = line + 1;
+    display->panel_width = size.width;
+    display->view = *view;
+
+    return;
 }
 
 
-/***************************************************************************************************************************************
- * update_display():    Purpose: Updates the display based on the effects of the player's commands                                     *
- *                      Parameters: - Panel *panel0 --> pointer to the variable containing the 0th panel                               *
- *                                  - Panel *panel1 --> pointer to the variable containing the 1st panel                               *
- *                                  - Panel *panel2 --> pointer to the variable containing the 2nd panel                               *
- *                                  - Panel *panel3 --> pointer to the variable containing the 3rd panel                               *
- *                                  - Panel *panel4 --> pointer to the variable containing the 4th panel                               *
- *                                  - Panel *panel5 --> pointer to the variable containing the 5th panel                               *
- *                                  - Panel *panel6 --> pointer to the variable containing the 6th panel                               *
- *                                  - Panel *panel7 --> pointer to the variable containing the 7th panel                               *
- *                                  - Panel *panel8 --> pointer to the variable containing the 8th panel                               *
- *                                  - Panel_Row *top --> pointer to the variable for storing the top three panels                      *
- *                                  - Panel_Row *middle --> pointer to the variable for storing the middle three panels                *
- *                                  - Panel_Row *bottom --> pointer to the variable for storing the bottom three panels                *
- *                                  - Panel_Row_Plus_Side_Panel *middle_and_side --> pointer to the variable for storing               *
- *                                      the middle three panels plus the top portion of the sidebar graphics                           *
- *                                  - Panel_Row_Plus_Side_Panel *bottom_and_side --> pointer to the variable for storing               *
- *                                      the bottom three panels plus the bottom portion of the sidebar graphics                        *
- *                                  - Panel *final_piece_text --> pointer to the variable containing the top portion of the sidebar    *
- *                                  - Panel *final_piece --> pointer to the variable containing the bottom portion of the sidebar      *
- *                      Return value: Panel_All_Plus_Side_Panel                                                                        *
- *                      Side effects: - alters the variables pointed to by every single parameter save the "final_piece" parameters    *
- ***************************************************************************************************************************************/
-Panel_All_Plus_Side_Panel update_display(Panel *panel0, Panel *panel1, Panel *panel2,
-                                         Panel *panel3, Panel *panel4, Panel *panel5,
-                                         Panel *panel6, Panel *panel7, Panel *panel8,
-                                         Panel_Row *top, Panel_Row *middle, Panel_Row *bottom,
-                                         Panel_Row_Plus_Side_Panel *middle_and_side, Panel_Row_Plus_Side_Panel *bottom_and_side,
-                                         Panel *final_piece_text, Panel *final_piece)
-{
-    Panel *panel_set[9] = {panel0, panel1, panel2, panel3, panel4, panel5, panel6, panel7, panel8};
-    Panel assembly_panel0, assembly_panel1, assembly_panel2,
-          assembly_panel3, assembly_panel4, assembly_panel5,
-          assembly_panel6, assembly_panel7, assembly_panel8;
-    int gap;
-
-    // Loop to rename (through duplication) panel variables for assembly.
-    for (int i = 0; i < 9; i++)
-    {
-        if (panel_set[i]->position == 0)
-            assembly_panel0 = *panel_set[i];
-        else if (panel_set[i]->position == 1)
-            assembly_panel1 = *panel_set[i];
-        else if (panel_set[i]->position == 2)
-            assembly_panel2 = *panel_set[i];
-        else if (panel_set[i]->position == 3)
-            assembly_panel3 = *panel_set[i];
-        else if (panel_set[i]->position == 4)
-            assembly_panel4 = *panel_set[i];
-        else if (panel_set[i]->position == 5)
-            assembly_panel5 = *panel_set[i];
-        else if (panel_set[i]->position == 6)
-            assembly_panel6 = *panel_set[i];
-        else if (panel_set[i]->position == 7)
-            assembly_panel7 = *panel_set[i];
-        else
-            assembly_panel8 = *panel_set[i];
-    }
-
-    *panel0 = assembly_panel0;
-    *panel1 = assembly_panel1;
-    *panel2 = assembly_panel2;
-    *panel3 = assembly_panel3;
-    *panel4 = assembly_panel4;
-    *panel5 = assembly_panel5;
-    *panel6 = assembly_panel6;
-    *panel7 = assembly_panel7;
-    *panel8 = assembly_panel8;
-
-    for (int i = 0; i < 9; i++)
-    {
-        if (panel_set[i]->is_gap)
-        {
-            gap = i;
-        }
-    }
-
-    // Assemble and return:
-    *top = assemble_panel_row(assembly_panel0, assembly_panel1, assembly_panel2);
-    *middle = assemble_panel_row(assembly_panel3, assembly_panel4, assembly_panel5);
-    *bottom = assemble_panel_row(assembly_panel6, assembly_panel7, assembly_panel8);
-    *middle_and_side = add_side_panel(*middle, *final_piece_text);
-    *bottom_and_side = add_side_panel(*bottom, *final_piece);
-
-    return assemble_all_plus_side(*top, *middle_and_side, *bottom_and_side, gap);
-}
-
-
-/***************************************************************************************************************************************
- * check_answer():      Purpose: Compares the panels of the player's submission to the panels containing the solution                  *
- *                      Parameters: - Panel *panel0 --> pointer to the variable containing the 0th panel                               *
- *                                  - Panel *panel1 --> pointer to the variable containing the 1st panel                               *
- *                                  - Panel *panel2 --> pointer to the variable containing the 2nd panel                               *
- *                                  - Panel *panel3 --> pointer to the variable containing the 3rd panel                               *
- *                                  - Panel *panel4 --> pointer to the variable containing the 4th panel                               *
- *                                  - Panel *panel5 --> pointer to the variable containing the 5th panel                               *
- *                                  - Panel *panel6 --> pointer to the variable containing the 6th panel                               *
- *                                  - Panel *panel7 --> pointer to the variable containing the 7th panel                               *
- *                                  - Panel *panel8 --> pointer to the variable containing the 8th panel                               *
- *                                  - Panel *solution_panel0 --> pointer to the variable containing the 0th solution panel             *
- *                                  - Panel *solution_panel1 --> pointer to the variable containing the 1st solution panel             *
- *                                  - Panel *solution_panel2 --> pointer to the variable containing the 2nd solution panel             *
- *                                  - Panel *solution_panel3 --> pointer to the variable containing the 3rd solution panel             *
- *                                  - Panel *solution_panel4 --> pointer to the variable containing the 4th solution panel             *
- *                                  - Panel *solution_panel5 --> pointer to the variable containing the 5th solution panel             *
- *                                  - Panel *solution_panel6 --> pointer to the variable containing the 6th solution panel             *
- *                                  - Panel *solution_panel7 --> pointer to the variable containing the 7th solution panel             *
- *                                  - Panel *solution_panel8 --> pointer to the variable containing the 8th solution panel             *
- *                      Return value: bool                                                                                             *
- *                      Side effects: none                                                                                             *
- ***************************************************************************************************************************************/
-bool check_answer(Panel *panel0, Panel *panel1, Panel *panel2,
-                  Panel *panel3, Panel *panel4, Panel *panel5,
-                  Panel *panel6, Panel *panel7, Panel *panel8,
-                  Panel *solution_panel0, Panel *solution_panel1, Panel *solution_panel2,
-                  Panel *solution_panel3, Panel *solution_panel4, Panel *solution_panel5,
-                  Panel *solution_panel6, Panel *solution_panel7, Panel *solution_panel8)
-{
-    bool correct;
-    Panel *player_panels[9] = {panel0, panel1, panel2, panel3, panel4, panel5, panel6, panel7, panel8};
-    Panel *solution_panels[9] = {solution_panel0, solution_panel1, solution_panel2,
-                                 solution_panel3, solution_panel4, solution_panel5,
-                                 solution_panel6, solution_panel7, solution_panel8};
-    correct = true;
-
-    for (int i = 0; i < 9; i++)
-        if (!compare_panels(*solution_panels[i], *player_panels[i]))
-        {
-            correct = false;
-            break;
-        }
+/*****************************************************************************************************************************
+ * full_view():         Purpose: Returns a viewport showing the whole of a board and its sidebar, as the display had before  *
+ *                                 there were viewports (and as anything not drawn on a terminal still has)                  *
+ *                      Parameters: - const Grid *grid --> the board's size                                                  *
+ *                      Return value: Viewport                                                                               *
+ *                      Side effects: none                                                                                   *
+ *****************************************************************************************************************************/
+Viewport full_view(const Grid *grid)
+{
+    return (Viewport) {.grid = grid, .first_row = 0, .rows = grid->rows, .first_column = 0, .columns = grid->columns,
+                       .sidebar = true};
+}
 
-    return correct;
+
+/******************************************************************************************************************************
+ * update_viewport():   Purpose: Fits a viewport to the terminal's current size (asked for with TIOCGWINSZ each time, so a    *
+ *                                 resized window is followed on the next frame), in whole panels, and scrolls it as little   *
+ *                                 as it can to keep a given panel in view. The whole board is shown whenever it fits, and    *
+ *                                 always when standard output isn't a terminal.                                              *
+ *                      Parameters: - Viewport *view --> pointer to the viewport, as last updated (or set by full_view())     *
+ *                                  - const Grid *grid --> the board's size                                                   *
+ *                                  - Panel_Size size --> the size of its panels                                              *
+ *                                  - int focus --> the position to keep in view (the gap, or the panel about to be flipped)  *
+ *                      Return value: none                                                                                    *
+ *                      Side effects: - alters the variable pointed to by "Viewport *view"                                    *
+ ******************************************************************************************************************************/
+void update_viewport(Viewport *view, const Grid *grid, Panel_Size size, int focus)
+{
+    struct winsize terminal;
+    int lines, width;
+
+    *view = (Viewport) {.grid = grid, .first_row = view->grid == grid ? view->first_row : 0, .rows = grid->rows,
+                        .first_column = view->grid == grid ? view->first_column : 0, .columns = grid->columns, .sidebar = true};
+    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &terminal) != 0 || terminal.ws_row == 0 || terminal.ws_col == 0)
+    {
+        *view = full_view(grid);
+        return;
+    }
+
+    // As many whole rows as leave room for the final line and the prompt, and as many whole columns as fit across
+    //     (with the sidebar only when every column fits beside it), but never less than one panel:
+    lines = terminal.ws_row - (DISPLAY_FIRST_LINE - 1) - PROMPT_LINES;
+    width = terminal.ws_col;
+    if ((lines - 1) / size.height < view->rows)
+        view->rows = (lines - 1) / size.height > 1 ? (lines - 1) / size.height : 1;
+    if (size.width * (grid->columns + 1) + 3 > width)
+    {
+        view->sidebar = false;
+        if (width / size.width < view->columns)
+            view->columns = width / size.width > 1 ? width / size.width : 1;
+    }
+
+    // Scroll just far enough to bring the focus into view, without ever showing past the board's edges:
+    if (focus / grid->columns < view->first_row)
+        view->first_row = focus / grid->columns;
+    if (focus / grid->columns >= view->first_row + view->rows)
+        view->first_row = focus / grid->columns - view->rows + 1;
+    if (view->first_row > grid->rows - view->rows)
+        view->first_row = grid->rows - view->rows;
+    if (focus % grid->columns < view->first_column)
+        view->first_column = focus % grid->columns;
+    if (focus % grid->columns >= view->first_column + view->columns)
+        view->first_column = focus % grid->columns - view->columns + 1;
+    if (view->first_column > grid->columns - view->columns)
+        view->first_column = grid->columns - view->columns;
+
+    return;
 }
 
 
-/************************************************************************************
- * compare_panels():    Purpose: Compares two panels                                *
- *                      Parameters: - Panel a --> the first Panel to be compared    *
- *                                  - Panel b --> the second Panel to be compared   *
- *                      Return value: bool                                          *
- *                      Side effects: none                                          *
- ************************************************************************************/
-bool compare_panels(Panel a, Panel b)
+/********************************************************************************************************
+ * same_view():         Purpose: Determines whether two viewports show the same part of the same board  *
+ *                      Parameters: - const Viewport *a --> pointer to the first viewport               *
+ *                                  - const Viewport *b --> pointer to the second viewport              *
+ *                      Return value: bool                                                              *
+ *                      Side effects: none                                                              *
+ ********************************************************************************************************/
+bool same_view(const Viewport *a, const Viewport *b)
+{
+    return a->grid == b->grid && a->first_row == b->first_row && a->rows == b->rows && a->first_column == b->first_column
+           && a->columns == b->columns && a->sidebar == b->sidebar;
+}
+
+
+/****************************************************************************************************************************
+ * check_answer():      Purpose: Compares the player's board to the solution, from scratch. Since the atlas's matches come  *
+ *                                 from the panels' art, tiles whose (oriented) art is identical are interchangeable.       *
+ *                      Parameters: - const Tile_Atlas *atlas --> pointer to the puzzle's art in every orientation          *
+ *                                      (tile n belongs in position n)                                                      *
+ *                                  - const Board *board --> pointer to the variable containing the current board           *
+ *                      Return value: bool                                                                                  *
+ *                      Side effects: none                                                                                  *
+ ****************************************************************************************************************************/
+bool check_answer(const Tile_Atlas *atlas, const Board *board)
+{
+    return count_correct(atlas, board) == atlas->grid->cells;
+}
+
+
+/****************************************************************************************************
+ * compare_panels():    Purpose: Compares two panels of an atlas (see panels_equal())               *
+ *                      Parameters: - const char *a --> pointer to the first panel to be compared   *
+ *                                  - const char *b --> pointer to the second panel to be compared  *
+ *                                  - Panel_Size size --> the size of both                          *
+ *                      Return value: bool                                                          *
+ *                      Side effects: none                                                          *
+ ****************************************************************************************************/
+bool compare_panels(const char *a, const char *b, Panel_Size size)
+{
+    return panels_equal(a, b, PANEL_STRIDE(size));
+}
+
+
+/*****************************************************************************************************************************
+ * panels_equal():      Purpose: Determines whether two cache-aligned, zero-padded panels (as an atlas stores them) are the  *
+ *                                 same, a cache line at a time with aligned vector loads (see KERNEL_SET), stopping at the  *
+ *                                 first cache line that differs. The padding is compared along with the art, so no panel    *
+ *                                 size needs a partial vector.                                                              *
+ *                      Parameters: - const char *a --> pointer to the first panel, on a CACHE_LINE boundary                 *
+ *                                  - const char *b --> pointer to the second panel, on a CACHE_LINE boundary                *
+ *                                  - size_t stride --> the bytes in each, padding included (a multiple of CACHE_LINE)       *
+ *                      Return value: bool                                                                                   *
+ *                      Side effects: none                                                                                   *
+ *****************************************************************************************************************************/
+bool panels_equal(const char *a, const char *b, size_t stride)
 {
-    bool same = true;
+#if defined(AVX2_KERNELS)
+    __m256i low, high;
+
+    for (size_t i = 0; i < stride; i += CACHE_LINE)
+    {
+        low = _mm256_xor_si256(_mm256_load_si256((const __m256i *) (a + i)), _mm256_load_si256((const __m256i *) (b + i)));
+        high = _mm256_xor_si256(_mm256_load_si256((const __m256i *) (a + i + 32)),
+                                _mm256_load_si256((const __m256i *) (b + i + 32)));
+        if (!_mm256_testz_si256(_mm256_or_si256(low, high), _mm256_or_si256(low, high)))
+            return false;
+    }
+
+    return true;
+#elif defined(SSE2_KERNELS)
+    __m128i same;
+
+    for (size_t i = 0; i < stride; i += CACHE_LINE)
+    {
+        same = _mm_cmpeq_epi8(_mm_load_si128((const __m128i *) (a + i)), _mm_load_si128((const __m128i *) (b + i)));
+        for (size_t j = 16; j < CACHE_LINE; j += 16)
+            same = _mm_and_si128(same, _mm_cmpeq_epi8(_mm_load_si128((const __m128i *) (a + i + j)),
+                                                      _mm_load_si128((const __m128i *) (b + i + j))));
+        if (_mm_movemask_epi8(same) != 0xFFFF)
+            return false;
+    }
+
+    return true;
+#else
+    return panels_equal_scalar(a, b, stride);
+#endif
+}
+
 
-    char *a_rows[NUM_ROWS] = {a.row0, a.row1, a.row2, a.row3, a.row4, a.row5, a.row6, a.row7, a.row8, a.row9, a.row10, a.row11};
-    char *b_rows[NUM_ROWS] = {b.row0, b.row1, b.row2, b.row3, b.row4, b.row5, b.row6, b.row7, b.row8, b.row9, b.row10, b.row11};
+/**************************************************************************************************************************
+ * panels_equal_scalar(): Purpose: panels_equal()'s portable fallback, comparing eight bytes at a time, and the baseline  *
+ *                                   "--bench-kernels" measures it against                                                *
+ *                        Parameters: - const char *a --> pointer to the first panel, on a CACHE_LINE boundary            *
+ *                                    - const char *b --> pointer to the second panel, on a CACHE_LINE boundary           *
+ *                                    - size_t stride --> the bytes in each, padding included (a multiple of CACHE_LINE)  *
+ *                        Return value: bool                                                                              *
+ *                        Side effects: none                                                                              *
+ **************************************************************************************************************************/
+bool panels_equal_scalar(const char *a, const char *b, size_t stride)
+{
+    uint64_t x, y, differ;
 
-    for (int i = 0; i < NUM_ROWS; i++)
-        if (strcmp(a_rows[i], b_rows[i]) != 0)
+    for (size_t i = 0; i < stride; i += CACHE_LINE)
+    {
+        differ = 0;
+        for (size_t j = 0; j < CACHE_LINE; j += sizeof(uint64_t))
         {
-            same = false;
-            break;
+            (void) memcpy(&x, a + i + j, sizeof(x));
+            (void) memcpy(&y, b + i + j, sizeof(y));
+            differ |= x ^ y;
         }
-    
-    return same;
+        if (differ != 0)
+            return false;
+    }
+
+    return true;
 }
 
 
@@ -1843,6 +2317,8 @@ void export_template(void)
     char yn = 0;
     int returnval = 0;
     int fclose_return;
+    int rows, columns;
+    Panel_Size size;
 
     // Test whether a file with the name "template.txt" already exists:
     template_file = fopen(filename, "r");
@@ -1869,6 +2345,38 @@ void export_template(void)
             return;
         }
     }
+
+    // Ask for the puzzle's size:
+    do
+    {
+        rows = 0; // Without this line, nonnumeric input would cause the size from the previous loop to be reused,
+                  //     due to scanf()'s call ignoring nonnumeric input.
+        (void) printf("How many rows of panels should the puzzle have? (%d-%d)\n", MIN_GRID_SIDE, MAX_GRID_SIDE);
+        (void) scanf("%d", &rows); while (getchar() != '\n');
+    } while (rows < MIN_GRID_SIDE || rows > MAX_GRID_SIDE);
+    do
+    {
+        columns = 0;
+        (void) printf("How many columns of panels should the puzzle have? (%d-%d)\n", MIN_GRID_SIDE, MAX_GRID_SIDE);
+        (void) scanf("%d", &columns); while (getchar() != '\n');
+    } while (columns < MIN_GRID_SIDE || columns > MAX_GRID_SIDE);
+
+    // Ask for the size of its panels, as much as fits in the display (the defaults fit any number of rows and columns):
+    do
+    {
+        size.width = 0;
+        (void) printf("How wide should each panel be, counting both sides? (%d-%d; %d by default)\n", MIN_PANEL_WIDTH,
+                      (MAX_DISPLAY_WIDTH - 3) / (columns + 1), DEFAULT_PANEL_WIDTH);
+        (void) scanf("%d", &size.width); while (getchar() != '\n');
+    } while (size.width < MIN_PANEL_WIDTH || size.width > (MAX_DISPLAY_WIDTH - 3) / (columns + 1));
+    do
+    {
+        size.height = 0;
+        (void) printf("How tall should each panel be, counting its top line? (%d-%d; %d by default)\n", MIN_PANEL_HEIGHT,
+                      (MAX_DISPLAY_LINES - 1) / rows, DEFAULT_PANEL_HEIGHT);
+        (void) scanf("%d", &size.height); while (getchar() != '\n');
+    } while (size.height < MIN_PANEL_HEIGHT || size.height > (MAX_DISPLAY_LINES - 1) / rows);
+
     // Create file:
     template_file = fopen(filename, "w+");
 
@@ -1886,8 +2394,17 @@ void export_template(void)
         exit(1);
     }
 
-    returnval = print_panel_all_to_file(template_file, make_template());
-    if (returnval != FILE_PANEL_ALL_CHAR_NUM)
+    returnval = fprintf(template_file, PANEL_SIZE_HEADER "%dx%d\n", size.width, size.height);
+    if (returnval < 0)
+    {
+        CLEAR_CONSOLE;
+        (void) printf("Error 1: Template instructions could not be written correctly.\n");
+        (void) printf("returnval: %d\n", returnval);
+        exit(1);
+    }
+
+    returnval = print_template(template_file, grid_of(rows, columns), size);
+    if (returnval != FILE_PUZZLE_LENGTH(rows, columns, size))
     {
         CLEAR_CONSOLE;
         (void) printf("Error 2: Template could not be written correctly.\n");
@@ -1907,66 +2424,4618 @@ void export_template(void)
 }
 
 
-/********************************************************************************
- * make_template():     Purpose: creates and returns a blank puzzle template    *
- *                      Parameters: none                                        *
- *                      Return value: Panel_All                                 *
- *                      Side effects: none                                      *
- ********************************************************************************/
-Panel_All make_template(void)
+/************************************************************************************************************************
+ * print_template():    Purpose: Prints a blank puzzle template of a given size to a given file. Returns the number of  *
+ *                                 characters written (negative on a write error).                                      *
+ *                      Parameters: - FILE *file --> pointer to the file to be written to                               *
+ *                                  - const Grid *grid --> the template's size                                          *
+ *                                  - Panel_Size size --> the size of its panels                                        *
+ *                      Return value: int                                                                               *
+ *                      Side effects: - prints to file                                                                  *
+ ************************************************************************************************************************/
+int print_template(FILE *file, const Grid *grid, Panel_Size size)
 {
-    Panel p0, p1, p2, p3, p4, p5, p6, p7, p8;
-    Panel_Row top, middle, bottom;
+    char blank[MAX_PICTURE_SIZE];
+    const char *panels[MAX_CELLS];
+
+    blank_panel(blank, size, true, true);
+    for (int p = 0; p < grid->cells; p++)
+        panels[p] = blank;
+
+    return print_picture(file, grid, size, panels);
+}
 
-    p0 = p1 = p2 = p3 = p4 = p5 = p6 = p7 = p8 = blank_panel();
 
-    top = assemble_panel_row(p0, p1, p2);
-    middle = assemble_panel_row(p3, p4, p5);
-    bottom = assemble_panel_row(p6, p7, p8);
+/***************************************************************************************
+ * solved_board():      Purpose: Returns a board with every tile in its solved place,  *
+ *                                 unflipped, and the gap in the last position         *
+ *                      Parameters: - const Grid *grid --> the board's size            *
+ *                      Return value: Board                                            *
+ *                      Side effects: none                                             *
+ ***************************************************************************************/
+Board solved_board(const Grid *grid)
+{
+    Board board = {.grid = grid, .gap = grid->cells - 1};
+
+    for (int i = 0; i < grid->cells; i++)
+        board.tiles[i] = (uint8_t) i;
 
-    return assemble_panel_all(top, middle, bottom);
+    return board;
 }
 
 
-/********************************************************************************************************
- * print_panel_all_to_file():   Purpose: prints a given Panel_All to a given file.                      *
- *                                         Returns the number of characters written.                    *
- *                              Parameters: - FILE *filename --> pointer to the file to be written to   *
- *                                          - Panel_All pa --> the Panel_All to be printed              *
- *                              Return value: int                                                       *
- *                              Side effects: - prints to file                                          *
- *                                            - modifies file pointed to by FILE *filename              *
- ********************************************************************************************************/
-int print_panel_all_to_file(FILE *filename, Panel_All pa)
+/**************************************************************************************************
+ * board_tile_at():     Purpose: Returns the index of the tile in a given position of a board     *
+ *                      Parameters: - const Board *board --> pointer to the board to be examined  *
+ *                                  - int position --> the position to be examined                *
+ *                      Return value: int                                                         *
+ *                      Side effects: none                                                        *
+ **************************************************************************************************/
+int board_tile_at(const Board *board, int position)
 {
-    int returnval = 0;
+    return board->tiles[position];
+}
 
-    returnval += print_panel_row_to_file(filename, pa.top);
-    returnval += print_panel_row_to_file(filename, pa.middle);
-    returnval += print_panel_row_to_file(filename, pa.bottom);
-    returnval += fprintf(filename, "%s", pa.final_row);
 
-    return returnval;
+/**************************************************************************************************
+ * board_orientation(): Purpose: Returns the orientation bits (FLIP_HORIZONTAL and/or             *
+ *                                 FLIP_VERTICAL) of a given tile on a board                      *
+ *                      Parameters: - const Board *board --> pointer to the board to be examined  *
+ *                                  - int tile --> the index of the tile to be examined           *
+ *                      Return value: int                                                         *
+ *                      Side effects: none                                                        *
+ **************************************************************************************************/
+int board_orientation(const Board *board, int tile)
+{
+    return board->orientations[tile];
 }
 
 
-/********************************************************************************************************
- * print_panel_row_to_file():   Purpose: prints a given Panel_Row to a given file.                      *
- *                                         Returns the number of characters written.                    *
- *                              Parameters: - FILE *filename --> pointer to the file to be written to   *
- *                                          - Panel_Row pr --> the Panel_Row to be printed              *
- *                              Return value: int                                                       *
- *                              Side effects: - prints to file                                          *
- *                                            - modifies file pointed to by FILE *filename              *
- ********************************************************************************************************/
-int print_panel_row_to_file(FILE *filename, Panel_Row pr)
+/*************************************************************************************************
+ * board_same():        Purpose: Returns whether two boards of the same size have every tile in  *
+ *                                 the same place and the same way up                            *
+ *                      Parameters: - const Board *a --> pointer to the first board              *
+ *                                  - const Board *b --> pointer to the second board             *
+ *                      Return value: bool                                                       *
+ *                      Side effects: none                                                       *
+ *************************************************************************************************/
+bool board_same(const Board *a, const Board *b)
 {
-    return fprintf(filename, "%s\n%s\n%s\n%s\n%s\n%s\n%s\n%s\n%s\n%s\n%s\n%s\n", pr.row0, pr.row1, pr.row2,
-                                                                                 pr.row3, pr.row4, pr.row5,
-                                                                                 pr.row6, pr.row7, pr.row8,
-                                                                                 pr.row9, pr.row10, pr.row11);
+    size_t cells = (size_t) a->grid->cells;
+
+    return a->gap == b->gap && memcmp(a->tiles, b->tiles, cells) == 0
+           && memcmp(a->orientations, b->orientations, cells) == 0;
 }
 
+
+/*********************************************************************************************************************
+ * board_apply():       Purpose: Applies a single move code (see SLIDE_MOVE() and FLIP_MOVE()) to a board,           *
+ *                                 and returns whether the move was legal. Illegal moves leave the board untouched.  *
+ *                                 Slides look up the panel to move in the grid's neighbour table, so no move ever   *
+ *                                 checks the board's edges.                                                         *
+ *                      Parameters: - Board *board --> pointer to the board to be altered                            *
+ *                                  - uint8_t move --> the move code to be applied                                   *
+ *                      Return value: bool                                                                           *
+ *                      Side effects: - alters the variable pointed to by "Board *board"                             *
+ *********************************************************************************************************************/
+bool board_apply(Board *board, uint8_t move)
+{
+    int argument = move >> 2;
+    int flip = move & 3;
+    int from;
+
+    // Flips and rotations toggle the orientation bits of the tile in the given position:
+    if (flip)
+    {
+        if (argument >= board->grid->cells || argument == board->gap)
+            return false;
+        board->orientations[board->tiles[argument]] ^= (uint8_t) flip;
+        return true;
+    }
+
+    // Slides exchange the gap with the neighbouring tile on the side opposite the direction of travel:
+    if (argument > SLIDE_RIGHT)
+        return false;
+    from = board->grid->neighbours[board->gap][argument];
+    if (from < 0) // no panel exists on that side of the gap
+        return false;
+    board->tiles[board->gap] = board->tiles[from];
+    board->tiles[from] = (uint8_t) (board->grid->cells - 1);
+    board->gap = from;
+
+    return true;
+}
+
+
+/****************************************************************************************************************************
+ * grid_of():           Purpose: Returns the grid (size and neighbour table) for boards of a given size, or NULL if boards  *
+ *                                 can't be that size. Every size's grid is built once, on first use, and shared by every   *
+ *                                 board of that size from then on.                                                         *
+ *                      Parameters: - int rows --> the number of rows of panels                                             *
+ *                                  - int columns --> the number of columns of panels                                       *
+ *                      Return value: const Grid *                                                                          *
+ *                      Side effects: none                                                                                  *
+ ****************************************************************************************************************************/
+const Grid *grid_of(int rows, int columns)
+{
+    static pthread_once_t built = PTHREAD_ONCE_INIT;
+
+    if (rows < MIN_GRID_SIDE || rows > MAX_GRID_SIDE || columns < MIN_GRID_SIDE || columns > MAX_GRID_SIDE)
+        return NULL;
+    (void) pthread_once(&built, build_grids);
+
+    return &grids[rows - MIN_GRID_SIDE][columns - MIN_GRID_SIDE];
+}
+
+
+/****************************************************************************************************************************
+ * build_grids():       Purpose: Builds the grid of every size boards can be, for grid_of(): for the gap in each position,  *
+ *                                 the position of the panel each slide direction moves into it                             *
+ *                      Parameters: none                                                                                    *
+ *                      Return value: none                                                                                  *
+ *                      Side effects: - alters the external variable "grids"                                                *
+ ****************************************************************************************************************************/
+void build_grids(void)
+{
+    Grid *grid;
+    int row, column;
+
+    for (int r = MIN_GRID_SIDE; r <= MAX_GRID_SIDE; r++)
+        for (int c = MIN_GRID_SIDE; c <= MAX_GRID_SIDE; c++)
+        {
+            grid = &grids[r - MIN_GRID_SIDE][c - MIN_GRID_SIDE];
+            grid->rows = r;
+            grid->columns = c;
+            grid->cells = r * c;
+            for (int p = 0; p < grid->cells; p++)
+            {
+                row = p / c;
+                column = p % c;
+                grid->neighbours[p][SLIDE_UP] = (int8_t) (row < r - 1 ? p + c : -1); // The panel below moves up,
+                grid->neighbours[p][SLIDE_DOWN] = (int8_t) (row > 0 ? p - c : -1); //     the one above down,
+                grid->neighbours[p][SLIDE_LEFT] = (int8_t) (column < c - 1 ? p + 1 : -1); //     the one to the right left,
+                grid->neighbours[p][SLIDE_RIGHT] = (int8_t) (column > 0 ? p - 1 : -1); //     and the one to the left right.
+            }
+        }
+
+    return;
+}
+
+
+/***********************************************************************************************************************************
+ * build_atlas():       Purpose: Precomputes, into a single contiguous, cache-aligned block, all four orientations of every tile,  *
+ *                                 the gap's graphics and the sidebar's text, so that flips and rotations during play only change  *
+ *                                 orientation bits, and records which tiles and orientations can fill each position of the        *
+ *                                 solution. Returns false if the block can't be allocated.                                        *
+ *                      Parameters: - Tile_Atlas *atlas --> pointer to the atlas to be filled                                      *
+ *                                  - const Grid *grid --> the puzzle's size                                                       *
+ *                                  - Panel_Size size --> the size of its panels                                                   *
+ *                                  - const char tiles[] --> the puzzle's art, indexed by tile                                     *
+ *                      Return value: bool                                                                                         *
+ *                      Side effects: - alters the variable pointed to by "Tile_Atlas *atlas"                                      *
+ *                                    - allocates memory for the atlas's art, to be freed with it                                  *
+ ***********************************************************************************************************************************/
+bool build_atlas(Tile_Atlas *atlas, const Grid *grid, Panel_Size size, const char tiles[])
+{
+    int gap_tile = grid->cells - 1;
+    size_t bytes = (size_t) ATLAS_PANELS(grid) * PANEL_STRIDE(size);
+    const char *text = size.width - 2 >= 14 ? "  Final Piece:" : "Final Piece:";
+    char *sidebar;
+
+    atlas->art = aligned_alloc(CACHE_LINE, bytes);
+    if (atlas->art == NULL)
+        return false;
+    (void) memset(atlas->art, 0, bytes); // The padding after each panel is compared along with it.
+    atlas->grid = grid;
+    atlas->size = size;
+    for (int i = 0; i < grid->cells; i++)
+    {
+        (void) memcpy(atlas_panel(atlas, i * NUM_ORIENTATIONS), tiles + (size_t) i * PANEL_BYTES(size), PANEL_BYTES(size));
+        flip_panel_over_y(atlas_panel(atlas, i * NUM_ORIENTATIONS + FLIP_HORIZONTAL), atlas_panel(atlas, i * NUM_ORIENTATIONS),
+                          size);
+        flip_panel_over_x(atlas_panel(atlas, i * NUM_ORIENTATIONS + FLIP_VERTICAL), atlas_panel(atlas, i * NUM_ORIENTATIONS),
+                          size);
+        flip_panel_over_x(atlas_panel(atlas, i * NUM_ORIENTATIONS + ROTATE),
+                          atlas_panel(atlas, i * NUM_ORIENTATIONS + FLIP_HORIZONTAL), size);
+    }
+
+    // The gap is a blank space, plus a top line (serving as the bottom of the panel above it) unless it is in the top row:
+    blank_panel(atlas_panel(atlas, ATLAS_GAP(grid, false)), size, true, false);
+    blank_panel(atlas_panel(atlas, ATLAS_GAP(grid, true)), size, false, false);
+
+    // The sidebar's text sits on its last line, just above the final piece (cut short if the panels are too narrow for it):
+    sidebar = atlas_panel(atlas, ATLAS_SIDEBAR(grid));
+    blank_panel(sidebar, size, false, false);
+    (void) memcpy(PANEL_LINE(sidebar, size.height - 1, size), text,
+                  strlen(text) < (size_t) size.width ? strlen(text) : (size_t) size.width);
+
+    // Record which orientations of which tiles reproduce each position's solution art (only the gap fits the last position):
+    for (int i = 0; i < grid->cells; i++)
+        for (int j = 0; j < grid->cells; j++)
+        {
+            atlas->matches[i][j] = 0;
+            for (int k = 0; k < NUM_ORIENTATIONS; k++)
+                if (i != gap_tile && j != gap_tile
+                    && compare_panels(atlas_panel(atlas, j * NUM_ORIENTATIONS), atlas_panel(atlas, i * NUM_ORIENTATIONS + k), size))
+                    atlas->matches[i][j] |= 1 << k;
+        }
+    atlas->matches[gap_tile][gap_tile] = (1 << NUM_ORIENTATIONS) - 1;
+
+    return true;
+}
+
+
+/*************************************************************************************************************************
+ * atlas_panel():       Purpose: Returns a pointer to one of the panels of an atlas (see ATLAS_PANELS)                   *
+ *                      Parameters: - const Tile_Atlas *atlas --> pointer to the atlas                                   *
+ *                                  - int panel --> the panel's index: tile * NUM_ORIENTATIONS + orientation for a tile  *
+ *                      Return value: char                                                                               *
+ *                      Side effects: none                                                                               *
+ *************************************************************************************************************************/
+char *atlas_panel(const Tile_Atlas *atlas, int panel)
+{
+    return atlas->art + (size_t) panel * PANEL_STRIDE(atlas->size);
+}
+
+
+/********************************************************************************************************************************
+ * solve_board():       Purpose: Finds an optimal (fewest commands) solution for a board by IDA* search, counting each flip or  *
+ *                                 rotation needed at the end as one move, and stores it in the passed Solution.                *
+ *                                 Tiles with identical art are treated as interchangeable, just as check_answer() does.        *
+ *                                 Given the distance table, a 3x3 board's slides are looked up rather than searched for,       *
+ *                                 unless its art has too many identical tiles for each arrangement to be tried in turn.        *
+ *                                 Returns false if no solution exists, or if the search examines SOLVER_NODE_LIMIT boards      *
+ *                                 (PATTERN_NODE_LIMIT with pattern databases) without finding one, which only happens on       *
+ *                                 boards larger than 3x3; board_solvable() tells the two apart.                                *
+ *                      Parameters: - const Tile_Atlas *atlas --> pointer to the puzzle's art in every orientation              *
+ *                                  - const Distance_Table *table --> pointer to the distance table (or NULL to search)         *
+ *                                  - const Board *board --> pointer to the board to be solved                                  *
+ *                                  - Solution *solution --> pointer to the variable for storing the solution                   *
+ *                      Return value: bool                                                                                      *
+ *                      Side effects: - alters the variable pointed to by "Solution *solution"                                  *
+ ********************************************************************************************************************************/
+bool solve_board(const Tile_Atlas *atlas, const Distance_Table *table, const Board *board, Solution *solution)
+{
+    Search search;
+    const Grid *grid = board->grid;
+    int gap_tile = grid->cells - 1;
+    int columns = grid->columns;
+    int tile_positions[MAX_CELLS];
+    int target[MAX_CELLS];
+    bool used[MAX_CELLS] = {false};
+    int distances[MAX_GOALS] = {0};
+    int gap_distance = abs(board->gap / columns - gap_tile / columns) + abs(board->gap % columns - gap_tile % columns);
+    int orientation, cost, estimate, distance, direction;
+    int nearest = 0, fewest = MAX_SOLUTION_LENGTH;
+    bool found = false;
+    Board next;
+
+    solution->length = 0;
+    solution->next = 0;
+    search.atlas = atlas;
+    search.board = *board;
+    search.nodes = 0;
+
+    // Collect every arrangement the board can reach that check_answer() would accept:
+    for (int i = 0; i < grid->cells; i++)
+        tile_positions[board_tile_at(board, i)] = i;
+    target[gap_tile] = gap_tile;
+    used[gap_tile] = true;
+    search.goal_count = 0;
+    (void) assign_positions(atlas, tile_positions, target, used, 0, gap_distance % 2, &search);
+    if (search.goal_count == 0)
+        return false;
+
+    // On 3x3 the table gives the slides to every goal (see goal_distance()), so no search is needed: the goal needing the
+    //     fewest slides and flips is reached a slide at a time, each to an arrangement one slide nearer:
+    if (table != NULL && grid == grid_of(DEFAULT_SIDE, DEFAULT_SIDE) && search.goal_count <= MAX_GOALS)
+    {
+        for (int g = 0; g < search.goal_count; g++)
+        {
+            cost = goal_distance(table, board, search.goals[g]);
+            for (int i = 0; i < gap_tile; i++)
+                cost += !(atlas->matches[i][search.goals[g][i]] & (1 << board_orientation(board, i)));
+            if (cost < fewest)
+            {
+                nearest = g;
+                fewest = cost;
+            }
+        }
+        search.length = 0;
+        for (distance = goal_distance(table, board, search.goals[nearest]); distance > 0; distance--)
+        {
+            for (direction = SLIDE_UP; direction <= SLIDE_RIGHT; direction++)
+            {
+                next = search.board;
+                if (board_apply(&next, SLIDE_MOVE(direction)) && goal_distance(table, &next, search.goals[nearest]) == distance - 1)
+                    break;
+            }
+            search.board = next;
+            search.path[search.length++] = SLIDE_MOVE(direction);
+        }
+        finish_solution(&search, solution);
+        return true;
+    }
+
+    // With too many arrangements to track, fall back on a single goal in which tiles whose art fits several positions
+    //     have no fixed position (and so no place in the pattern databases):
+    search.patterns = pattern_database(grid);
+    if (search.goal_count > MAX_GOALS)
+    {
+        search.patterns = NULL;
+        search.goal_count = 1;
+        for (int i = 0; i < gap_tile; i++)
+        {
+            search.goals[0][i] = -1;
+            for (int j = 0; j < grid->cells; j++)
+                if (atlas->matches[i][j])
+                    search.goals[0][i] = search.goals[0][i] == -1 ? j : -2;
+            if (search.goals[0][i] == -2)
+                search.goals[0][i] = -1;
+        }
+    }
+
+    // A tile needs at least as many slides as it is away from its goal position (the nearest position its art fits,
+    //     if it has no fixed goal), plus a flip if it is wrongly oriented there. Orientations never change during the search:
+    for (int g = 0; g < search.goal_count; g++)
+    {
+        search.goals[g][gap_tile] = -1;
+        for (int i = 0; i < grid->cells; i++)
+        {
+            orientation = board_orientation(board, i);
+            for (int j = 0; j < grid->cells; j++)
+            {
+                search.cost[g][i][j] = i == gap_tile ? 0 : MAX_SOLUTION_LENGTH;
+                for (int k = 0; k < grid->cells && i != gap_tile; k++)
+                    if (atlas->matches[i][k] && (search.goals[g][i] == -1 || search.goals[g][i] == k))
+                    {
+                        cost = abs(j / columns - k / columns) + abs(j % columns - k % columns)
+                               + !(atlas->matches[i][k] & (1 << orientation));
+                        if (cost < search.cost[g][i][j])
+                            search.cost[g][i][j] = (uint8_t) cost;
+                    }
+            }
+        }
+        for (int i = 0; i < grid->cells; i++)
+            distances[g] += search.cost[g][board_tile_at(board, i)][i];
+        search.flips[g] = 0;
+        for (int i = 0; i < gap_tile && search.patterns != NULL; i++)
+            search.flips[g] += search.cost[g][i][search.goals[g][i]];
+    }
+
+    // The flips that would finish the board, and where each goal's tiles are for the pattern databases, are then kept up
+    //     to date slide by slide (see solver_slide()):
+    search.misfits = 0;
+    search.fit_flips = 0;
+    for (int i = 0; i < grid->cells; i++)
+    {
+        orientation = board_orientation(board, i);
+        for (int j = 0; j < grid->cells; j++)
+            search.fits[i][j] = (int8_t) (atlas->matches[i][j] ? !(atlas->matches[i][j] & (1 << orientation)) : -1);
+        search.misfits += search.fits[i][tile_positions[i]] < 0;
+        search.fit_flips += search.fits[i][tile_positions[i]] > 0;
+    }
+    if (search.patterns != NULL)
+    {
+        (void) memset(search.pattern_groups, -1, sizeof(search.pattern_groups));
+        for (int g = 0; g < search.patterns->layout->group_count; g++)
+            for (int i = 0; i < search.patterns->layout->sizes[g]; i++)
+                search.pattern_groups[search.patterns->layout->tiles[g][i]] = (int8_t) g;
+        for (int g = 0; g < search.goal_count; g++)
+        {
+            for (int i = 0; i < gap_tile; i++)
+                search.homes[g][search.goals[g][i]] = tile_positions[i];
+            (void) memset(search.group_costs[g], 0, sizeof(search.group_costs[g]));
+            search.pattern_sums[g][0] = 0;
+            search.pattern_sums[g][1] = 0;
+            search.stale[g][0] = (uint8_t) ((1 << search.patterns->layout->group_count) - 1); // All looked up when first needed,
+            search.stale[g][1] = grid->rows == columns ? search.stale[g][0] : 0; //     reflected only on square boards.
+        }
+    }
+
+    // Deepen the bound until a solution fits within it:
+    search.bound = MAX_SOLUTION_LENGTH;
+    for (int g = 0; g < search.goal_count; g++)
+    {
+        estimate = search.patterns != NULL ? pattern_estimate(&search, g) : distances[g] + linear_conflicts(&search, g);
+        if (estimate < search.bound)
+            search.bound = estimate;
+    }
+    search.node_limit = search.patterns != NULL ? PATTERN_NODE_LIMIT : SOLVER_NODE_LIMIT;
+    for (; !found && search.bound < MAX_SOLUTION_LENGTH && search.nodes <= search.node_limit;
+         search.bound = search.next_bound)
+    {
+        search.next_bound = MAX_SOLUTION_LENGTH;
+        found = solver_search(&search, 0, distances, -1);
+    }
+    if (!found)
+        return false;
+    finish_solution(&search, solution);
+
+    return true;
+}
+
+
+/**************************************************************************************************************************
+ * finish_solution():   Purpose: Stores the slides solve_board() found, followed by whichever flips the arrangement they  *
+ *                                 reach needs, as a Solution                                                             *
+ *                      Parameters: - const Search *search --> pointer to the finished search (its board left solved but  *
+ *                                        for orientations)                                                               *
+ *                                  - Solution *solution --> pointer to the variable for storing the solution             *
+ *                      Return value: none                                                                                *
+ *                      Side effects: - alters the variable pointed to by "Solution *solution"                            *
+ **************************************************************************************************************************/
+void finish_solution(const Search *search, Solution *solution)
+{
+    const Tile_Atlas *atlas = search->atlas;
+    int tile, orientation;
+
+    (void) memcpy(solution->moves, search->path, (size_t) search->length);
+    solution->length = search->length;
+    for (int i = 0; i < atlas->grid->cells; i++)
+    {
+        tile = board_tile_at(&search->board, i);
+        orientation = board_orientation(&search->board, tile);
+        if (!(atlas->matches[tile][i] & (1 << orientation)))
+            for (int k = 0; k < NUM_ORIENTATIONS; k++)
+                if (atlas->matches[tile][i] & (1 << k))
+                {
+                    solution->moves[solution->length++] = FLIP_MOVE(i, orientation ^ k);
+                    break;
+                }
+    }
+
+    return;
+}
+
+
+/**********************************************************************************************************************************
+ * board_solvable():    Purpose: Determines whether any arrangement that check_answer() would accept can be reached from a board  *
+ *                                 by sliding. An arrangement is reachable exactly when the parity of the permutation taking the  *
+ *                                 board to it matches the parity of the gap's distance from the last position.                   *
+ *                      Parameters: - const Tile_Atlas *atlas --> pointer to the puzzle's art in every orientation                *
+ *                                  - const Board *board --> pointer to the board to be examined                                  *
+ *                      Return value: bool                                                                                        *
+ *                      Side effects: none                                                                                        *
+ **********************************************************************************************************************************/
+bool board_solvable(const Tile_Atlas *atlas, const Board *board)
+{
+    const Grid *grid = board->grid;
+    int gap_tile = grid->cells - 1;
+    int tile_positions[MAX_CELLS];
+    int target[MAX_CELLS];
+    bool used[MAX_CELLS] = {false};
+    int gap_distance = abs(board->gap / grid->columns - gap_tile / grid->columns)
+                       + abs(board->gap % grid->columns - gap_tile % grid->columns);
+
+    for (int i = 0; i < grid->cells; i++)
+        tile_positions[board_tile_at(board, i)] = i;
+    target[gap_tile] = gap_tile;
+    used[gap_tile] = true;
+
+    return assign_positions(atlas, tile_positions, target, used, 0, gap_distance % 2, NULL);
+}
+
+
+/********************************************************************************************************************************
+ * table_solves():      Purpose: Determines whether solve_board() looks a puzzle's boards up in the distance table rather than  *
+ *                                 searching (given the table): only on 3x3, and only if the art's identical tiles leave no     *
+ *                                 more than MAX_GOALS arrangements that check_answer() would accept reachable from solved      *
+ *                      Parameters: - const Tile_Atlas *atlas --> pointer to the puzzle's art in every orientation              *
+ *                      Return value: bool                                                                                      *
+ *                      Side effects: none                                                                                      *
+ ********************************************************************************************************************************/
+bool table_solves(const Tile_Atlas *atlas)
+{
+    Search search; // Only for counting the arrangements.
+    int gap_tile = atlas->grid->cells - 1;
+    int tile_positions[MAX_CELLS];
+    int target[MAX_CELLS];
+    bool used[MAX_CELLS] = {false};
+
+    if (atlas->grid != grid_of(DEFAULT_SIDE, DEFAULT_SIDE))
+        return false;
+    for (int i = 0; i < atlas->grid->cells; i++)
+        tile_positions[i] = i;
+    target[gap_tile] = gap_tile;
+    used[gap_tile] = true;
+    search.goal_count = 0;
+
+    return !assign_positions(atlas, tile_positions, target, used, 0, 0, &search);
+}
+
+
+/*****************************************************************************************************************************
+ * assign_positions():  Purpose: Recursively assigns each remaining tile a free position its art fits, looking for complete  *
+ *                                 assignments reached by a permutation of the given parity. Without a search, returns true  *
+ *                                 at the first one found; with a search, records each one found as a goal of the search,    *
+ *                                 returning true only once more than MAX_GOALS have been seen.                              *
+ *                      Parameters: - const Tile_Atlas *atlas --> pointer to the puzzle's art in every orientation           *
+ *                                  - const int tile_positions[] --> the current position of each tile                       *
+ *                                  - int target[] --> the positions assigned so far, indexed by tile                        *
+ *                                  - bool used[] --> whether each position has been assigned yet                            *
+ *                                  - int tile --> the next tile to be assigned                                              *
+ *                                  - int parity --> the required permutation parity (0 for even, 1 for odd)                 *
+ *                                  - Search *search --> pointer to the search collecting goals (or NULL)                    *
+ *                      Return value: bool                                                                                   *
+ *                      Side effects: - alters the arrays target[] and used[]                                                *
+ *                                    - alters the variable pointed to by "Search *search"                                   *
+ *****************************************************************************************************************************/
+bool assign_positions(const Tile_Atlas *atlas, const int tile_positions[], int target[], bool used[], int tile, int parity,
+                      Search *search)
+{
+    int cells = atlas->grid->cells;
+    int mapping[MAX_CELLS];
+    bool seen[MAX_CELLS] = {false};
+    int transpositions = 0;
+
+    if (tile == cells - 1)
+    {
+        // Every tile is assigned, so count the transpositions making up the permutation, cycle by cycle:
+        for (int i = 0; i < cells; i++)
+            mapping[tile_positions[i]] = target[i];
+        for (int i = 0; i < cells; i++)
+            for (int j = i; !seen[j]; j = mapping[j])
+            {
+                seen[j] = true;
+                if (mapping[j] != i)
+                    transpositions++;
+            }
+        if (transpositions % 2 != parity)
+            return false;
+        if (search == NULL)
+            return true;
+        if (search->goal_count < MAX_GOALS)
+            (void) memcpy(search->goals[search->goal_count], target, sizeof(int) * (size_t) cells);
+        return ++search->goal_count > MAX_GOALS;
+    }
+
+    for (int i = 0; i < cells; i++)
+        if (!used[i] && atlas->matches[tile][i])
+        {
+            used[i] = true;
+            target[tile] = i;
+            if (assign_positions(atlas, tile_positions, target, used, tile + 1, parity, search))
+                return true;
+            used[i] = false;
+        }
+
+    return false;
+}
+
+
+/*****************************************************************************************************************************
+ * solver_search():     Purpose: One depth-first iteration of solve_board()'s IDA* search. Returns true (leaving the solved  *
+ *                                 board and its slides in the Search) once a solution fits within the current bound.        *
+ *                      Parameters: - Search *search --> pointer to the search in progress                                   *
+ *                                  - int depth --> the number of slides made so far                                         *
+ *                                  - const int distances[] --> for each goal, the sum of the tiles' cost[][][] entries      *
+ *                                      for the current board                                                                *
+ *                                  - int last_direction --> the direction of the previous slide (-1 for none),              *
+ *                                      so that it is never immediately undone                                               *
+ *                      Return value: bool                                                                                   *
+ *                      Side effects: - alters the variable pointed to by "Search *search"                                   *
+ *****************************************************************************************************************************/
+bool solver_search(Search *search, int depth, const int distances[], int last_direction)
+{
+    int next_distances[MAX_GOALS];
+    int estimate = MAX_SOLUTION_LENGTH;
+    int flips, old_gap, new_gap, tile, remaining;
+
+    if (++search->nodes > search->node_limit)
+        return false; // Given up on, so solve_board() stops deepening.
+
+    // The nearest goal arrangement bounds the moves still needed (neither estimate is ever below its distance):
+    for (int g = 0; g < search->goal_count; g++)
+        if (depth + distances[g] < estimate)
+        {
+            remaining = search->patterns != NULL ? pattern_estimate(search, g)
+                                                 : distances[g] + linear_conflicts(search, g);
+            if (depth + remaining < estimate)
+                estimate = depth + remaining;
+        }
+    if (estimate > search->bound)
+    {
+        if (estimate < search->next_bound)
+            search->next_bound = estimate;
+        return false;
+    }
+
+    // Where every tile fits its position, finishing with flips is one way out:
+    flips = placement_flips(search);
+    if (flips >= 0)
+    {
+        if (depth + flips <= search->bound)
+        {
+            search->length = depth;
+            return true;
+        }
+        if (depth + flips < search->next_bound)
+            search->next_bound = depth + flips;
+    }
+
+    for (int direction = SLIDE_UP; direction <= SLIDE_RIGHT; direction++)
+    {
+        if (direction == (last_direction ^ 1))
+            continue;
+        old_gap = search->board.gap;
+        if (!board_apply(&search->board, SLIDE_MOVE(direction)))
+            continue;
+        new_gap = search->board.gap;
+        tile = board_tile_at(&search->board, old_gap);
+        solver_slide(search, tile, new_gap, old_gap);
+        for (int g = 0; g < search->goal_count; g++)
+            next_distances[g] = distances[g] - search->cost[g][tile][new_gap] + search->cost[g][tile][old_gap];
+        search->path[depth] = SLIDE_MOVE(direction);
+        if (solver_search(search, depth + 1, next_distances, direction))
+            return true;
+        (void) board_apply(&search->board, SLIDE_MOVE(direction ^ 1));
+        solver_slide(search, tile, old_gap, new_gap);
+    }
+
+    return false;
+}
+
+
+/*********************************************************************************************************************************
+ * solver_slide():      Purpose: Brings the search's running counts up to date after a tile slides (and the gap the other way):  *
+ *                                 the tiles that don't fit where they are and the flips the rest need, and, with pattern        *
+ *                                 databases, where each goal arrangement's tiles are. A slide only moves one tile, so for each  *
+ *                                 goal only the entry of the group of the position it belongs in changes, and, reflected, that  *
+ *                                 of the group of that position's mirror in the main diagonal; they are marked stale, for       *
+ *                                 pattern_estimate() to look up again only for the goals it needs.                              *
+ *                      Parameters: - Search *search --> pointer to the search in progress                                       *
+ *                                  - int tile --> the tile that slid                                                            *
+ *                                  - int from --> the position it slid from, where the gap now is                               *
+ *                                  - int to --> the position it slid to, where the gap was                                      *
+ *                      Return value: none                                                                                       *
+ *                      Side effects: - alters the variable pointed to by "Search *search"                                       *
+ *********************************************************************************************************************************/
+void solver_slide(Search *search, int tile, int from, int to)
+{
+    int gap_tile = search->board.grid->cells - 1;
+    int side = search->board.grid->columns;
+    int lookups = search->board.grid->rows == side ? 2 : 1; // Only square boards are looked up reflected too.
+    int home, group;
+
+    search->misfits += (search->fits[tile][to] < 0) - (search->fits[tile][from] < 0)
+                       + (search->fits[gap_tile][from] < 0) - (search->fits[gap_tile][to] < 0);
+    search->fit_flips += (search->fits[tile][to] > 0) - (search->fits[tile][from] > 0)
+                         + (search->fits[gap_tile][from] > 0) - (search->fits[gap_tile][to] > 0);
+    if (search->patterns == NULL)
+        return;
+
+    for (int g = 0; g < search->goal_count; g++)
+    {
+        home = search->goals[g][tile];
+        search->homes[g][home] = to;
+        for (int r = 0; r < lookups; r++)
+        {
+            group = search->pattern_groups[r ? home % side * side + home / side : home];
+            if (group >= 0)
+                search->stale[g][r] |= (uint8_t) (1 << group);
+        }
+    }
+
+    return;
+}
+
+
+/**************************************************************************************************************************
+ * linear_conflicts():  Purpose: Returns the linear-conflict addition to the search's distance estimate for one goal      *
+ *                                 arrangement: two extra slides for every tile that must leave its goal row (or column)  *
+ *                                 to let another tile past it. Only tiles with a fixed goal position take part.          *
+ *                      Parameters: - const Search *search --> pointer to the search in progress                          *
+ *                                  - int goal --> the index of the goal arrangement                                      *
+ *                      Return value: int                                                                                 *
+ *                      Side effects: none                                                                                *
+ **************************************************************************************************************************/
+int linear_conflicts(const Search *search, int goal)
+{
+    const Grid *grid = search->board.grid;
+    int line[MAX_GRID_SIDE];
+    int count;
+    int position;
+    int conflicts = 0;
+
+    for (int i = 0; i < grid->rows; i++)
+    {
+        count = 0;
+        for (int j = 0; j < grid->columns; j++)
+        {
+            position = search->goals[goal][board_tile_at(&search->board, i * grid->columns + j)];
+            if (position >= 0 && position / grid->columns == i)
+                line[count++] = position % grid->columns;
+        }
+        conflicts += line_conflicts(line, count);
+    }
+    for (int i = 0; i < grid->columns; i++)
+    {
+        count = 0;
+        for (int j = 0; j < grid->rows; j++)
+        {
+            position = search->goals[goal][board_tile_at(&search->board, j * grid->columns + i)];
+            if (position >= 0 && position % grid->columns == i)
+                line[count++] = position / grid->columns;
+        }
+        conflicts += line_conflicts(line, count);
+    }
+
+    return 2 * conflicts;
+}
+
+
+/********************************************************************************************************************
+ * line_conflicts():    Purpose: Returns how many tiles must leave a line so that the rest are in goal order,       *
+ *                                 i.e. the line's length minus its longest increasing subsequence                  *
+ *                      Parameters: - const int line[] --> the goal coordinates of the tiles in the line, in order  *
+ *                                  - int count --> the number of tiles in the line                                 *
+ *                      Return value: int                                                                           *
+ *                      Side effects: none                                                                          *
+ ********************************************************************************************************************/
+int line_conflicts(const int line[], int count)
+{
+    int longest[MAX_GRID_SIDE];
+    int best = 0;
+
+    for (int i = 0; i < count; i++)
+    {
+        longest[i] = 1;
+        for (int j = 0; j < i; j++)
+            if (line[j] < line[i] && longest[j] + 1 > longest[i])
+                longest[i] = longest[j] + 1;
+        if (longest[i] > best)
+            best = longest[i];
+    }
+
+    return count - best;
+}
+
+
+/********************************************************************************************************************
+ * placement_flips():   Purpose: Returns how many flips or rotations would finish the search's current board,       *
+ *                                 or -1 if some tile's art does not fit its position in any orientation, from the  *
+ *                                 counts solver_slide() keeps                                                      *
+ *                      Parameters: - const Search *search --> pointer to the search in progress                    *
+ *                      Return value: int                                                                           *
+ *                      Side effects: none                                                                          *
+ ********************************************************************************************************************/
+int placement_flips(const Search *search)
+{
+    return search->misfits > 0 ? -1 : search->fit_flips;
+}
+
+
+/********************************************************************************************************************************
+ * pattern_estimate():  Purpose: Returns the search's estimate of the moves still needed to reach one goal arrangement from     *
+ *                                 the pattern databases: the sum of each group's entry for where its tiles are now (see        *
+ *                                 pattern_cost()), plus the flips the goal needs. On square boards the tables are looked up a  *
+ *                                 second time for the board reflected in its main diagonal (which leaves the solved gap where  *
+ *                                 it is, so the reflection needs exactly as many slides), and the larger of the two sums is    *
+ *                                 used. Never more than the moves needed, since no slide moves tiles of two groups. Both sums  *
+ *                                 are kept from board to board, so only the groups solver_slide() marked stale are looked up.  *
+ *                      Parameters: - Search *search --> pointer to the search in progress (with pattern databases)             *
+ *                                  - int goal --> the index of the goal arrangement                                            *
+ *                      Return value: int                                                                                       *
+ *                      Side effects: - alters the variable pointed to by "Search *search"                                      *
+ ********************************************************************************************************************************/
+int pattern_estimate(Search *search, int goal)
+{
+    int *sums = search->pattern_sums[goal];
+    int cost;
+
+    for (int r = 0; r < 2; r++)
+        for (int group = 0; search->stale[goal][r] != 0; group++)
+            if (search->stale[goal][r] & 1 << group)
+            {
+                cost = pattern_cost(search, goal, group, r);
+                sums[r] += cost - search->group_costs[goal][r][group];
+                search->group_costs[goal][r][group] = (uint8_t) cost;
+                search->stale[goal][r] &= (uint8_t) ~(1 << group);
+            }
+
+    return search->flips[goal] + (sums[1] > sums[0] ? sums[1] : sums[0]);
+}
+
+
+/*****************************************************************************************************************************
+ * pattern_cost():      Purpose: Returns one group's pattern database entry for where its tiles are now, for one goal        *
+ *                                 arrangement: the tile that belongs in each position stands in for the position's own      *
+ *                                 tile, so interchangeable tiles can use the same tables. Reflected, the tile that belongs  *
+ *                                 in position (r, c) stands where (c, r)'s tile does, but reflected too.                    *
+ *                      Parameters: - const Search *search --> pointer to the search in progress (with pattern databases)    *
+ *                                  - int goal --> the index of the goal arrangement                                         *
+ *                                  - int group --> the group of tiles                                                       *
+ *                                  - bool reflected --> whether to look the board up reflected in its main diagonal         *
+ *                      Return value: int                                                                                    *
+ *                      Side effects: none                                                                                   *
+ *****************************************************************************************************************************/
+int pattern_cost(const Search *search, int goal, int group, bool reflected)
+{
+    const Pattern_Layout *layout = search->patterns->layout;
+    int side = search->board.grid->columns;
+    int positions[MAX_PATTERN_SIZE];
+    int tile, home;
+
+    for (int i = 0; i < layout->sizes[group]; i++)
+    {
+        tile = layout->tiles[group][i];
+        home = search->homes[goal][reflected ? tile % side * side + tile / side : tile];
+        positions[i] = reflected ? home % side * side + home / side : home;
+    }
+
+    return search->patterns->costs[group][pattern_rank(positions, layout->sizes[group], search->board.grid->cells)];
+}
+
+
+/******************************************************************************************************************
+ * move_to_command():   Purpose: Writes the short command (such as "w" or "3 h") that performs a move code,       *
+ *                                 and returns a pointer to it (like how strcpy() returns a pointer to the copy)  *
+ *                      Parameters: - char *command --> a pointer to the array to hold the command                *
+ *                                  - uint8_t move --> the move code to be described                              *
+ *                      Return value: char                                                                        *
+ *                      Side effects: - alters the array pointed to by "char *command"                            *
+ ******************************************************************************************************************/
+char *move_to_command(char *command, uint8_t move)
+{
+    const char *slides[4] = {"w", "s", "a", "d"}; // Indexed by SLIDE_UP, SLIDE_DOWN, SLIDE_LEFT, and SLIDE_RIGHT
+    const char flips[NUM_ORIENTATIONS] = {' ', 'h', 'v', 'r'}; // Indexed by orientation bits
+
+    if (move & 3)
+        (void) sprintf(command, "%d %c", move >> 2, flips[move & 3]);
+    else
+        (void) strcpy(command, slides[move >> 2]);
+
+    return command;
+}
+
+
+/******************************************************************************************************************
+ * rng_seed():          Purpose: Seeds a PCG32 random number generator, so that equal seeds give equal sequences  *
+ *                      Parameters: - Rng *rng --> pointer to the generator to be seeded                          *
+ *                                  - uint64_t seed --> the seed                                                  *
+ *                      Return value: none                                                                        *
+ *                      Side effects: - alters the variable pointed to by "Rng *rng"                              *
+ ******************************************************************************************************************/
+void rng_seed(Rng *rng, uint64_t seed)
+{
+    rng->state = 0;
+    rng->increment = PCG_STREAM | 1;
+    (void) rng_next(rng);
+    rng->state += seed;
+    (void) rng_next(rng);
+
+    return;
+}
+
+
+/***************************************************************************************************************************
+ * rng_next():          Purpose: Returns the next 32 random bits from a PCG32 generator (permuted output of a 64-bit LCG)  *
+ *                      Parameters: - Rng *rng --> pointer to the generator                                                *
+ *                      Return value: uint32_t                                                                             *
+ *                      Side effects: - alters the variable pointed to by "Rng *rng"                                       *
+ ***************************************************************************************************************************/
+uint32_t rng_next(Rng *rng)
+{
+    uint64_t old_state = rng->state;
+    uint32_t shifted = (uint32_t) (((old_state >> 18) ^ old_state) >> 27);
+    uint32_t rotation = (uint32_t) (old_state >> 59);
+
+    rng->state = old_state * PCG_MULTIPLIER + rng->increment;
+
+    return (shifted >> rotation) | (shifted << ((-rotation) & 31));
+}
+
+
+/**********************************************************************************************************************
+ * rng_below():         Purpose: Returns a uniformly distributed random number from 0 up to (but excluding) a bound,  *
+ *                                 rejecting the few raw values that would make "% bound" favour small numbers        *
+ *                      Parameters: - Rng *rng --> pointer to the generator                                           *
+ *                                  - uint32_t bound --> one more than the largest number wanted (must not be zero)   *
+ *                      Return value: uint32_t                                                                        *
+ *                      Side effects: - alters the variable pointed to by "Rng *rng"                                  *
+ **********************************************************************************************************************/
+uint32_t rng_below(Rng *rng, uint32_t bound)
+{
+    uint32_t threshold = -bound % bound; // 2^32 % bound: the count of raw values in the incomplete final block
+    uint32_t value;
+
+    do
+    {
+        value = rng_next(rng);
+    } while (value < threshold);
+
+    return value % bound;
+}
+
+
+/*********************************************************************************************************************************
+ * board_rank():        Purpose: Numbers a 3x3 board's arrangement of tiles (ignoring orientations) from 0 to 9! - 1: the gap's  *
+ *                                 position times 8!, plus the lexicographic rank of the other tiles read in position order.     *
+ *                                 Swapping the last two of those tiles only changes the lowest bit of the rank and leaves the   *
+ *                                 gap alone, so of each pair of ranks 2k and 2k + 1 exactly one is reachable by sliding,        *
+ *                                 and "rank / 2" numbers the reachable arrangements without gaps.                               *
+ *                      Parameters: - const Board *board --> pointer to the board to be ranked                                   *
+ *                      Return value: uint32_t                                                                                   *
+ *                      Side effects: none                                                                                       *
+ *********************************************************************************************************************************/
+uint32_t board_rank(const Board *board)
+{
+    int tiles[GAP_TILE];
+    int count = 0;
+    uint32_t rank = (uint32_t) board->gap;
+    int smaller;
+
+    for (int i = 0; i < NUM_PANELS; i++)
+        if (i != board->gap)
+            tiles[count++] = board_tile_at(board, i);
+    for (int i = 0; i < GAP_TILE; i++)
+    {
+        smaller = 0;
+        for (int j = i + 1; j < GAP_TILE; j++)
+            if (tiles[j] < tiles[i])
+                smaller++;
+        rank = rank * (uint32_t) (GAP_TILE - i) + (uint32_t) smaller;
+    }
+
+    return rank;
+}
+
+
+/***********************************************************************************************************************************
+ * board_unrank():      Purpose: Returns the 3x3 board with the arrangement of the given board_rank(), every tile in its original  *
+ *                                 orientation                                                                                     *
+ *                      Parameters: - uint32_t rank --> the rank of the arrangement                                                *
+ *                      Return value: Board                                                                                        *
+ *                      Side effects: none                                                                                         *
+ ***********************************************************************************************************************************/
+Board board_unrank(uint32_t rank)
+{
+    Board board = solved_board(grid_of(DEFAULT_SIDE, DEFAULT_SIDE));
+    int digits[GAP_TILE];
+    bool used[GAP_TILE] = {false};
+    int tile, position = 0;
+
+    // Peel off the factorial-base digits, least significant (last tile) first; what is left is the gap's position:
+    for (int i = GAP_TILE - 1; i >= 0; i--)
+    {
+        digits[i] = (int) (rank % (uint32_t) (GAP_TILE - i));
+        rank /= (uint32_t) (GAP_TILE - i);
+    }
+    board.gap = (int) rank;
+    board.tiles[board.gap] = GAP_TILE;
+
+    // Each digit picks the how-manyth unused tile comes next:
+    for (int i = 0; i < GAP_TILE; i++, position++)
+    {
+        for (tile = 0; used[tile] || digits[i] > 0; tile++)
+            if (!used[tile])
+                digits[i]--;
+        used[tile] = true;
+        if (position == board.gap)
+            position++;
+        board.tiles[position] = (uint8_t) tile;
+    }
+
+    return board;
+}
+
+
+/***********************************************************************************************************************************
+ * build_distance_table(): Purpose: Fills a distance table by breadth-first search out from the solved board, recording how many   *
+ *                                    slides each of the 181,440 reachable arrangements needs, and listing them nearest first.     *
+ *                                    Takes a fraction of a second, so play_game() only builds it when a difficulty is requested.  *
+ *                         Parameters: - Distance_Table *table --> pointer to the table to be filled                               *
+ *                         Return value: none                                                                                      *
+ *                         Side effects: - alters the variable pointed to by "Distance_Table *table"                               *
+ ***********************************************************************************************************************************/
+void build_distance_table(Distance_Table *table)
+{
+    uint64_t visited[(NUM_REACHABLE_STATES + 63) / 64] = {0}; // Needed as well as the distances, since MAX_SLIDE_DISTANCE
+                                                              //     fills every bit of an entry.
+    Board board, next;
+    uint32_t rank, index;
+    int head = 0, tail = 0;
+    int distance;
+
+    for (size_t i = 0; i < sizeof(table->packed) / sizeof(table->packed[0]); i++)
+        table->packed[i] = 0;
+    for (int i = 0; i <= MAX_SLIDE_DISTANCE + 1; i++)
+        table->first[i] = NUM_REACHABLE_STATES;
+
+    // The queue doubles as the by_distance list, since breadth-first search visits arrangements nearest first:
+    board = solved_board(grid_of(DEFAULT_SIDE, DEFAULT_SIDE));
+    rank = board_rank(&board);
+    visited[rank / 2 / 64] |= 1ULL << (rank / 2 % 64);
+    table->by_distance[tail++] = rank;
+    while (head < tail)
+    {
+        board = board_unrank(table->by_distance[head]);
+        distance = table_distance(table, &board);
+        if (table->first[distance] > head)
+            table->first[distance] = head;
+        head++;
+        for (int direction = SLIDE_UP; direction <= SLIDE_RIGHT; direction++)
+        {
+            next = board;
+            if (!board_apply(&next, SLIDE_MOVE(direction)))
+                continue;
+            rank = board_rank(&next);
+            index = rank / 2;
+            if (visited[index / 64] & (1ULL << (index % 64)))
+                continue;
+            visited[index / 64] |= 1ULL << (index % 64);
+            table->packed[index / DISTANCES_PER_WORD] |= (uint64_t) (distance + 1) << (DISTANCE_BITS * (index % DISTANCES_PER_WORD));
+            table->by_distance[tail++] = rank;
+        }
+    }
+
+    return;
+}
+
+
+/************************************************************************************************************************
+ * table_distance():    Purpose: Looks up how many slides a board's arrangement needs to reach the solved arrangement,  *
+ *                                 taking every tile's art to be distinct and ignoring orientations                     *
+ *                      Parameters: - const Distance_Table *table --> pointer to the distance table                     *
+ *                                  - const Board *board --> pointer to the board to be looked up (must be solvable)    *
+ *                      Return value: int                                                                               *
+ *                      Side effects: none                                                                              *
+ ************************************************************************************************************************/
+int table_distance(const Distance_Table *table, const Board *board)
+{
+    uint32_t index = board_rank(board) / 2;
+
+    return (int) (table->packed[index / DISTANCES_PER_WORD] >> (DISTANCE_BITS * (index % DISTANCES_PER_WORD))) & ((1 << DISTANCE_BITS) - 1);
+}
+
+
+/****************************************************************************************************************************
+ * goal_distance():     Purpose: Looks up how many slides a board's arrangement needs to reach a goal arrangement, by       *
+ *                                 renumbering each tile as the tile that belongs in its goal position: the goal then       *
+ *                                 becomes the solved arrangement, which table_distance() measures from                     *
+ *                      Parameters: - const Distance_Table *table --> pointer to the distance table                         *
+ *                                  - const Board *board --> pointer to the board to be looked up                           *
+ *                                  - const int goal[] --> the goal position of each tile (as solve_board() collects them,  *
+ *                                        reachable from the board by sliding)                                              *
+ *                      Return value: int                                                                                   *
+ *                      Side effects: none                                                                                  *
+ ****************************************************************************************************************************/
+int goal_distance(const Distance_Table *table, const Board *board, const int goal[])
+{
+    Board renumbered = *board;
+
+    for (int i = 0; i < NUM_PANELS; i++)
+        if (i != board->gap)
+            renumbered.tiles[i] = (uint8_t) goal[board_tile_at(board, i)];
+
+    return table_distance(table, &renumbered);
+}
+
+
+/****************************************************************************************************************************************
+ * board_at_difficulty(): Purpose: Returns a random board the given number of moves from solved, or the closest to it that it finds     *
+ *                                   (the puzzle's art may not allow that many). Each sample splits the moves between slides (drawing   *
+ *                                   an arrangement at that distance straight from the table) and flips (wrongly orienting that many    *
+ *                                   tiles), and more moves than slides and flips can make are split every way. Tiles with identical    *
+ *                                   art can shorten a board's real solution, so each sample is checked with solve_board(). After       *
+ *                                   DIFFICULTY_ATTEMPTS misses, up to DIFFICULTY_STEPS changes are tried to the closest board so far   *
+ *                                   (only if table_solves(), as searching each would take seconds), and the closest board found is     *
+ *                                   returned. Boards other than 3x3 have no table, so they are scrambled by a random walk of that      *
+ *                                   many slides, never undoing the last one, which leaves them at most that many moves from solved.    *
+ *                        Parameters: - const Tile_Atlas *atlas --> pointer to the puzzle's art in every orientation                    *
+ *                                    - const Distance_Table *table --> pointer to the distance table (NULL for boards other than 3x3)  *
+ *                                    - Rng *rng --> pointer to the random number generator                                             *
+ *                                    - int difficulty --> the number of moves wanted, from 0 to MAX_DIFFICULTY                         *
+ *                        Return value: Board                                                                                           *
+ *                        Side effects: - alters the variable pointed to by "Rng *rng"                                                  *
+ ****************************************************************************************************************************************/
+Board board_at_difficulty(const Tile_Atlas *atlas, const Distance_Table *table, Rng *rng, int difficulty)
+{
+    Board board, closest = solved_board(atlas->grid);
+    Solution solution;
+    int flippable[GAP_TILE]; // Tiles that can be wrongly oriented (a blank tile, say, looks right every way up).
+    int flippable_count = 0;
+    int least_flips, most_flips, flips, slides, swap, temp, orientation;
+    int miss, closest_miss = MAX_DIFFICULTY + 1;
+    int direction, last_direction = -1;
+    int step, steps;
+
+    if (table == NULL || atlas->grid != grid_of(DEFAULT_SIDE, DEFAULT_SIDE))
+    {
+        for (int i = 0; i < difficulty; i++)
+        {
+            do
+            {
+                direction = (int) rng_below(rng, 4);
+            } while (direction == (last_direction ^ 1) || atlas->grid->neighbours[closest.gap][direction] < 0);
+            (void) board_apply(&closest, SLIDE_MOVE(direction));
+            last_direction = direction;
+        }
+        return closest;
+    }
+
+    for (int i = 0; i < GAP_TILE; i++)
+        if (atlas->matches[i][i] != (1 << NUM_ORIENTATIONS) - 1)
+            flippable[flippable_count++] = i;
+    least_flips = difficulty > MAX_SLIDE_DISTANCE ? difficulty - MAX_SLIDE_DISTANCE : 0;
+    most_flips = difficulty < flippable_count ? difficulty : flippable_count;
+    if (least_flips > most_flips) // More moves than slides and flips can make, so aim for the hardest board of any split.
+        least_flips = 0;
+
+    steps = table_solves(atlas) ? DIFFICULTY_STEPS : 0; // Searching each step instead would take seconds.
+
+    for (int attempt = 0; attempt < DIFFICULTY_ATTEMPTS + steps && closest_miss > 0; attempt++)
+    {
+        // Once the samples have all fallen short, work from the closest: keep its split but draw another arrangement at
+        //     the same distance, or slide its gap, or turn one of its tiles, keeping the change unless it lands farther
+        //     from the difficulty (so the search can wander across boards equally close):
+        if (attempt >= DIFFICULTY_ATTEMPTS)
+        {
+            board = closest;
+            step = (int) rng_below(rng, flippable_count > 0 ? 3 : 2); // 0 a slide, 1 another arrangement, 2 a turn.
+            if (step == 2)
+                board.orientations[flippable[rng_below(rng, (uint32_t) flippable_count)]] = (uint8_t) rng_below(rng, NUM_ORIENTATIONS);
+            else if (step == 1)
+            {
+                slides = table_distance(table, &closest) + (int) rng_below(rng, 2);
+                slides = slides > MAX_SLIDE_DISTANCE ? MAX_SLIDE_DISTANCE : slides;
+                board = board_unrank(table->by_distance[table->first[slides]
+                                     + (int) rng_below(rng, (uint32_t) (table->first[slides + 1] - table->first[slides]))]);
+                (void) memcpy(board.orientations, closest.orientations, sizeof(board.orientations));
+            }
+            else if (!board_apply(&board, SLIDE_MOVE(rng_below(rng, 4))))
+                continue;
+            if (solve_board(atlas, table, &board, &solution) && abs(solution.length - difficulty) <= closest_miss)
+            {
+                closest = board;
+                closest_miss = abs(solution.length - difficulty);
+            }
+            continue;
+        }
+
+        // Slides: any arrangement from the table's bucket for the remaining distance:
+        flips = least_flips + (int) rng_below(rng, (uint32_t) (most_flips - least_flips + 1));
+        slides = difficulty - flips > MAX_SLIDE_DISTANCE ? MAX_SLIDE_DISTANCE : difficulty - flips;
+        board = board_unrank(table->by_distance[table->first[slides]
+                             + (int) rng_below(rng, (uint32_t) (table->first[slides + 1] - table->first[slides]))]);
+
+        // Flips: a partial Fisher-Yates shuffle picks which tiles to turn, each to a random wrong orientation:
+        for (int i = 0; i < flips; i++)
+        {
+            swap = i + (int) rng_below(rng, (uint32_t) (flippable_count - i));
+            temp = flippable[i];
+            flippable[i] = flippable[swap];
+            flippable[swap] = temp;
+            do
+            {
+                orientation = 1 + (int) rng_below(rng, NUM_ORIENTATIONS - 1);
+            } while (atlas->matches[flippable[i]][flippable[i]] & (1 << orientation));
+            board.orientations[flippable[i]] = (uint8_t) orientation;
+        }
+
+        if (!solve_board(atlas, table, &board, &solution))
+            continue;
+        miss = abs(solution.length - difficulty);
+        if (miss < closest_miss)
+        {
+            closest = board;
+            closest_miss = miss;
+        }
+    }
+
+    return closest;
+}
+
+
+/*************************************************************************************************************************************
+ * draw_display():      Purpose: Brings the terminal up to date with the display. When the terminal still shows the previous frame,  *
+ *                                 only the panel-wide segments of each line that have changed are rewritten, using ANSI cursor      *
+ *                                 addressing, so a slide sends two panels rather than the whole ~5 KB puzzle and nothing            *
+ *                                 flickers. Otherwise (or when the viewport has moved) the screen is cleared and the puzzle         *
+ *                                 printed in full, under a heading saying which rows and columns are shown if not all of them.      *
+ *                                 Either way, the cursor is left on a cleared line below the puzzle, ready for the command prompt,  *
+ *                                 and the whole frame goes out in a single write().                                                 *
+ *                      Parameters: - Frame *frame --> pointer to the record of what the terminal shows                              *
+ *                                  - const Display *display --> pointer to the display to be shown                                  *
+ *                      Return value: none                                                                                           *
+ *                      Side effects: - prints to stdout                                                                             *
+ *                                    - clears CLI screen and scrollback (when the previous frame is not on screen)                  *
+ *                                    - alters the variable pointed to by "Frame *frame"                                             *
+ *************************************************************************************************************************************/
+void draw_display(Frame *frame, const Display *display)
+{
+    const char *new_line, *old_line;
+    char cursor[32];
+    char heading[96];
+    const Viewport *view = &display->view;
+    int length;
+    size_t width, start;
+    size_t segment = (size_t) display->panel_width;
+
+    frame->used = 0;
+    if (frame->synchronized)
+        frame_append(frame, SYNC_BEGIN, sizeof(SYNC_BEGIN) - 1);
+    if (!frame->valid || !same_view(&frame->shown.view, view))
+    {
+        if (view->rows == view->grid->rows && view->columns == view->grid->columns)
+            frame_append(frame, CLEAR_SEQUENCE "Puzzle:\n", sizeof(CLEAR_SEQUENCE "Puzzle:\n") - 1);
+        else
+            frame_append(frame, heading, (size_t) sprintf(heading, CLEAR_SEQUENCE "Puzzle (rows %d-%d, columns %d-%d of %dx%d):\n",
+                                                          view->first_row + 1, view->first_row + view->rows, view->first_column + 1,
+                                                          view->first_column + view->columns, view->grid->rows,
+                                                          view->grid->columns));
+        for (int i = 0; i < display->lines; i++)
+        {
+            frame_append(frame, display->text[i], (size_t) display->lengths[i]);
+            frame_append(frame, "\n", 1);
+        }
+        frame_append(frame, "\n\n", 2);
+    }
+    else
+    {
+        for (int i = 0; i < display->lines; i++)
+        {
+            new_line = display->text[i];
+            old_line = frame->shown.text[i];
+            length = display->lengths[i];
+            for (size_t column = 0; column < (size_t) length; column += segment)
+            {
+                // Neighbouring changed segments (both panels of a sideways slide, say) go out as one run:
+                for (start = column; column < (size_t) length; column += segment)
+                {
+                    width = (size_t) length - column < segment ? (size_t) length - column : segment;
+                    if (memcmp(new_line + column, old_line + column, width) == 0)
+                        break;
+                }
+                if (column > start)
+                {
+                    frame_append(frame, cursor, (size_t) sprintf(cursor, "\033[%d;%dH", DISPLAY_FIRST_LINE + i, (int) start + 1));
+                    frame_append(frame, new_line + start, (column < (size_t) length ? column : (size_t) length) - start);
+                }
+            }
+        }
+
+        // Move to the prompt's line (two blank lines below the puzzle) and clear whatever was typed or reported there:
+        frame_append(frame, cursor, (size_t) sprintf(cursor, "\033[%d;1H\033[J", DISPLAY_FIRST_LINE + display->lines + 2));
+    }
+    if (frame->synchronized)
+        frame_append(frame, SYNC_END, sizeof(SYNC_END) - 1);
+    frame_send(frame);
+
+    frame->shown = *display;
+    frame->valid = true;
+
+    return;
+}
+
+
+/**********************************************************************************************************************************
+ * frame_append():      Purpose: Adds text to the frame being composed, sending what is already there first if it would overflow  *
+ *                      Parameters: - Frame *frame --> pointer to the frame being composed                                        *
+ *                                  - const char *text --> pointer to the text to be added                                        *
+ *                                  - size_t length --> the number of characters to be added (at most FRAME_BUFFER_SIZE)          *
+ *                      Return value: none                                                                                        *
+ *                      Side effects: - alters the variable pointed to by "Frame *frame"                                          *
+ *                                    - prints to stdout (on overflow)                                                            *
+ **********************************************************************************************************************************/
+void frame_append(Frame *frame, const char *text, size_t length)
+{
+    if (frame->used + length > FRAME_BUFFER_SIZE)
+        frame_send(frame);
+    (void) memcpy(frame->out + frame->used, text, length);
+    frame->used += length;
+
+    return;
+}
+
+
+/************************************************************************************************************************************
+ * frame_send():        Purpose: Writes the composed frame to stdout with write() (retrying partial and interrupted writes), after  *
+ *                                 flushing anything printf() has left in stdout's buffer so that output stays in order             *
+ *                      Parameters: - Frame *frame --> pointer to the composed frame                                                *
+ *                      Return value: none                                                                                          *
+ *                      Side effects: - prints to stdout                                                                            *
+ *                                    - alters the variable pointed to by "Frame *frame"                                            *
+ *                                    - terminates program                                                                          *
+ ************************************************************************************************************************************/
+void frame_send(Frame *frame)
+{
+    size_t sent = 0;
+    ssize_t written;
+
+    (void) fflush(stdout);
+    while (sent < frame->used)
+    {
+        written = write(STDOUT_FILENO, frame->out + sent, frame->used - sent);
+        if (written < 0 && errno == EINTR)
+            continue;
+        if (written < 0)
+        {
+            (void) printf("Error 20: Failure to write to the terminal.\n");
+            exit(20);
+        }
+        sent += (size_t) written;
+    }
+    frame->used = 0;
+
+    return;
+}
+
+
+/***********************************************************************************************************************************
+ * map_file():          Purpose: Opens a file and maps its contents read-only into memory, returning false if it cannot be opened  *
+ *                                 or mapped. On failure, the mapping's data is NULL, and its size is the file's size if the file  *
+ *                                 was opened but could not be mapped (a directory, say), or 0 if it could not be opened.          *
+ *                      Parameters: - const char *filename --> the name of the file                                                *
+ *                                  - Mapped_File *file --> pointer to the variable for storing the mapping                        *
+ *                      Return value: bool                                                                                         *
+ *                      Side effects: - reads external files                                                                       *
+ *                                    - alters the variable pointed to by "Mapped_File *file"                                      *
+ ***********************************************************************************************************************************/
+bool map_file(const char *filename, Mapped_File *file)
+{
+    struct stat status;
+    int descriptor = open(filename, O_RDONLY);
+    void *data;
+
+    file->data = NULL;
+    file->size = 0;
+    if (descriptor < 0)
+        return false;
+    if (fstat(descriptor, &status))
+    {
+        (void) close(descriptor);
+        return false;
+    }
+
+    // An empty file can't be mapped, but it can stand in as one with no data:
+    file->size = (size_t) status.st_size;
+    file->data = "";
+    if (file->size > 0)
+    {
+        data = mmap(NULL, file->size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+        if (data == MAP_FAILED)
+        {
+            file->data = NULL;
+            (void) close(descriptor);
+            return false;
+        }
+        file->data = data;
+    }
+    (void) close(descriptor); // The mapping outlives the descriptor.
+
+    return true;
+}
+
+
+/***************************************************************************************************************
+ * unmap_file():        Purpose: Releases a file mapped by map_file(), returning 0 on success (like fclose())  *
+ *                      Parameters: - Mapped_File *file --> pointer to the mapping                             *
+ *                      Return value: int                                                                      *
+ *                      Side effects: - alters the variable pointed to by "Mapped_File *file"                  *
+ ***************************************************************************************************************/
+int unmap_file(Mapped_File *file)
+{
+    int munmap_return = 0;
+
+    if (file->size > 0)
+        munmap_return = munmap((void *) file->data, file->size);
+    file->data = NULL;
+    file->size = 0;
+
+    return munmap_return;
+}
+
+
+/****************************************************************************************************************************
+ * read_le32():         Purpose: Returns the little-endian 32-bit unsigned integer stored at the given bytes, whatever the  *
+ *                                 byte order or alignment requirements of the machine                                      *
+ *                      Parameters: - const char *bytes --> pointer to the first of the four bytes                          *
+ *                      Return value: uint32_t                                                                              *
+ *                      Side effects: none                                                                                  *
+ ****************************************************************************************************************************/
+uint32_t read_le32(const char *bytes)
+{
+    const unsigned char *b = (const unsigned char *) bytes;
+
+    return (uint32_t) b[0] | (uint32_t) b[1] << 8 | (uint32_t) b[2] << 16 | (uint32_t) b[3] << 24;
+}
+
+
+/*************************************************************************************************************************
+ * is_pack():           Purpose: Determines whether a mapped file is a puzzle pack (rather than a single custom puzzle)  *
+ *                      Parameters: - const Mapped_File *file --> pointer to the mapped file                             *
+ *                      Return value: bool                                                                               *
+ *                      Side effects: none                                                                               *
+ *************************************************************************************************************************/
+bool is_pack(const Mapped_File *file)
+{
+    return file->size >= PACK_MAGIC_LENGTH && memcmp(file->data, PACK_MAGIC, PACK_MAGIC_LENGTH) == 0;
+}
+
+
+/********************************************************************************************************************************
+ * check_pack():        Purpose: Determines whether a puzzle pack's header and index are sound: the version is understood, the  *
+ *                                 index, layouts, and tile blocks lie within the file, every puzzle's grid is a size boards    *
+ *                                 can be and its panels a size whose display fits, and every layout entry refers to a whole    *
+ *                                 block inside the tile area. The tile blocks themselves are not read.                         *
+ *                                 Pack layout: header (PACK_HEADER_SIZE bytes), index (PACK_ENTRY_SIZE bytes per puzzle),      *
+ *                                 layouts (a uint32 per panel of each puzzle, at the offset its entry gives: the byte offset   *
+ *                                 of the panel's tile block from the start of the tile area), and tile blocks (a panel's       *
+ *                                 lines back to back, PANEL_BYTES() of its puzzle's panel size), the index and tile area at    *
+ *                                 the offsets the header gives.                                                                *
+ *                      Parameters: - const Mapped_File *pack --> pointer to the mapped puzzle pack                             *
+ *                      Return value: bool                                                                                      *
+ *                      Side effects: none                                                                                      *
+ ********************************************************************************************************************************/
+bool check_pack(const Mapped_File *pack)
+{
+    uint64_t puzzle_count, index_offset, tile_offset, layout_offset;
+    const char *entry;
+    const Grid *grid;
+    Panel_Size size;
+
+    if (pack->size < PACK_HEADER_SIZE || read_le32(pack->data + 8) != PACK_VERSION)
+        return false;
+    puzzle_count = read_le32(pack->data + 12);
+    index_offset = read_le32(pack->data + 20);
+    tile_offset = read_le32(pack->data + 24);
+    if (index_offset + puzzle_count * PACK_ENTRY_SIZE > pack->size || tile_offset > pack->size)
+        return false;
+
+    for (uint32_t i = 0; i < puzzle_count; i++)
+    {
+        entry = pack_entry(pack, i);
+        grid = grid_of((unsigned char) entry[PACK_NAME_LENGTH], (unsigned char) entry[PACK_NAME_LENGTH + 1]);
+        size = (Panel_Size) {.width = (unsigned char) entry[PACK_NAME_LENGTH + 2], .height = (unsigned char) entry[PACK_NAME_LENGTH + 3]};
+        if (grid == NULL || !panel_size_fits(grid, size))
+            return false;
+        layout_offset = read_le32(entry + PACK_NAME_LENGTH + 4);
+        if (layout_offset + (uint64_t) grid->cells * 4 > pack->size)
+            return false;
+        for (int p = 0; p < grid->cells; p++)
+            if (tile_offset + read_le32(pack->data + layout_offset + 4 * p) + PANEL_BYTES(size) > pack->size)
+                return false;
+    }
+
+    return true;
+}
+
+
+/*****************************************************************************************************
+ * pack_entry():        Purpose: Returns a pointer to a puzzle's entry in a puzzle pack's index      *
+ *                      Parameters: - const Mapped_File *pack --> pointer to the mapped puzzle pack  *
+ *                                  - uint32_t puzzle --> which puzzle of the pack, counting from 0  *
+ *                      Return value: const char                                                     *
+ *                      Side effects: none                                                           *
+ *****************************************************************************************************/
+const char *pack_entry(const Mapped_File *pack, uint32_t puzzle)
+{
+    return pack->data + read_le32(pack->data + 20) + (size_t) puzzle * PACK_ENTRY_SIZE;
+}
+
+
+/**********************************************************************************************************************************
+ * locate_byte():       Purpose: Finds the line and column (both counting from 1) of a byte in a mapped file, for error messages  *
+ *                      Parameters: - const Mapped_File *file --> pointer to the mapped file                                      *
+ *                                  - long byte --> offset of the byte to locate                                                  *
+ *                                  - long *line --> pointer to the variable in which to store the line                           *
+ *                                  - long *column --> pointer to the variable in which to store the column                       *
+ *                      Return value: none                                                                                        *
+ *                      Side effects: - alters the variables pointed to by "long *line" and "long *column"                        *
+ **********************************************************************************************************************************/
+void locate_byte(const Mapped_File *file, long byte, long *line, long *column)
+{
+    *line = 1;
+    *column = 1;
+    for (long i = 0; i < byte; i++, (*column)++)
+        if (file->data[i] == '\n')
+        {
+            (*line)++;
+            *column = 0;
+        }
+}
+
+
+/******************************************************************************************************************************
+ * compile_pack():      Purpose: Validates custom puzzle files in parallel, one thread per core, and writes every one into a  *
+ *                                 single puzzle pack, storing each distinct tile only once however many puzzles use it.      *
+ *                                 Nothing is written unless every file is valid; each invalid file is reported instead.      *
+ *                      Parameters: - const char *pack_name --> the name of the pack file to write                            *
+ *                                  - int file_count --> the number of puzzle files                                           *
+ *                                  - char *filenames[] --> the names of the puzzle files, in the order to store them         *
+ *                      Return value: none                                                                                    *
+ *                      Side effects: - prints to stdout                                                                      *
+ *                                    - terminates program                                                                    *
+ *                                    - reads and writes external files                                                       *
+ ******************************************************************************************************************************/
+void compile_pack(const char *pack_name, int file_count, char *filenames[])
+{
+    Pack_Job job = {.count = file_count, .next = 0};
+    pthread_t threads[MAX_COMPILE_THREADS];
+    long thread_count = sysconf(_SC_NPROCESSORS_ONLN);
+    int failures = 0;
+    uint32_t tile_count = 0;
+    uint32_t tile_bytes = 0;
+    uint32_t next_offset;
+    size_t *starts; // Where each source's panels start in the flat arrays below (and, after the last, how many there are).
+    size_t panel_count;
+    const char **blocks; // For each source and panel, its tile block,
+    size_t *lengths; //     that block's length,
+    uint64_t *hashes; //     its hash,
+    uint32_t *tile_offsets; //     and the offset in the tile area of the block it is stored as.
+    uint32_t *buckets; // Open-addressed hash table of tile blocks seen so far (0 for empty, otherwise panel index + 1).
+    size_t bucket_mask = 1;
+    const Pack_Source *source;
+    size_t bucket;
+    uint32_t found;
+    char header[PACK_HEADER_SIZE] = PACK_MAGIC;
+    char entry[PACK_ENTRY_SIZE];
+    char layout_entry[4];
+    uint32_t layout_offset;
+    const char *name;
+    size_t name_length;
+    FILE *pack;
+    bool written;
+
+    job.sources = calloc((size_t) file_count, sizeof(Pack_Source));
+    starts = malloc((size_t) (file_count + 1) * sizeof(size_t));
+    if (job.sources == NULL || starts == NULL)
+    {
+        (void) printf("Error 25: Not enough memory to compile %d puzzle files.\n", file_count);
+        exit(25);
+    }
+    for (int i = 0; i < file_count; i++)
+        job.sources[i].filename = filenames[i];
+
+    // Validate on every core, each thread claiming the next unvalidated file as it finishes the last:
+    if (thread_count < 1)
+        thread_count = 1;
+    if (thread_count > MAX_COMPILE_THREADS)
+        thread_count = MAX_COMPILE_THREADS;
+    if (thread_count > file_count)
+        thread_count = file_count;
+    (void) pthread_mutex_init(&job.lock, NULL);
+    for (long t = 0; t < thread_count; t++)
+        if (pthread_create(&threads[t], NULL, validate_sources, &job))
+            thread_count = t; // Carry on with the threads already running; at worst this one does all the work.
+    if (thread_count == 0)
+        (void) validate_sources(&job);
+    for (long t = 0; t < thread_count; t++)
+        (void) pthread_join(threads[t], NULL);
+    (void) pthread_mutex_destroy(&job.lock);
+
+    // Report on each file that failed, in the order given:
+    for (int i = 0; i < file_count; i++)
+    {
+        source = &job.sources[i];
+        if (source->status == SOURCE_UNOPENED)
+            (void) printf("%s: could not be opened.\n", source->filename);
+        else if (source->status == SOURCE_NO_PUZZLE)
+            (void) printf("%s: no puzzle found (no top line of panels).\n", source->filename);
+        else if (source->status == SOURCE_FORMAT_ERROR)
+            (void) printf("%s: first formatting error at byte %ld (line %ld, column %ld).\n",
+                          source->filename, source->error_offset, source->line, source->column);
+        failures += source->status != SOURCE_VALID;
+    }
+    if (failures)
+    {
+        (void) printf("Error 23: %d of %d puzzle files are invalid; %s was not written.\n", failures, file_count, pack_name);
+        exit(23);
+    }
+
+    // Puzzles can be any size, so their panels are numbered one after another across all the sources:
+    starts[0] = 0;
+    for (int i = 0; i < file_count; i++)
+        starts[i + 1] = starts[i] + (size_t) job.sources[i].grid->cells;
+    panel_count = starts[file_count];
+    blocks = malloc(panel_count * sizeof(const char *));
+    lengths = malloc(panel_count * sizeof(size_t));
+    hashes = malloc(panel_count * sizeof(uint64_t));
+    tile_offsets = malloc(panel_count * sizeof(uint32_t));
+    while (bucket_mask < panel_count * 2)
+        bucket_mask <<= 1;
+    buckets = calloc(bucket_mask--, sizeof(uint32_t));
+    for (int i = 0; i < file_count; i++)
+        failures += job.sources[i].tiles == NULL;
+    if (blocks == NULL || lengths == NULL || hashes == NULL || tile_offsets == NULL || buckets == NULL || failures)
+    {
+        (void) printf("Error 25: Not enough memory to compile %d puzzle files.\n", file_count);
+        exit(25);
+    }
+    for (int i = 0; i < file_count; i++)
+        for (int p = 0; p < job.sources[i].grid->cells; p++)
+        {
+            blocks[starts[i] + (size_t) p] = job.sources[i].tiles + (size_t) p * PANEL_BYTES(job.sources[i].size);
+            lengths[starts[i] + (size_t) p] = PANEL_BYTES(job.sources[i].size);
+            hashes[starts[i] + (size_t) p] = job.sources[i].hashes[p];
+        }
+
+    // Place the distinct tiles one after another, comparing hashes first and contents only when the hashes agree:
+    for (size_t k = 0; k < panel_count; k++)
+    {
+        for (bucket = hashes[k] & bucket_mask; (found = buckets[bucket]) != 0; bucket = (bucket + 1) & bucket_mask)
+            if (hashes[found - 1] == hashes[k] && lengths[found - 1] == lengths[k]
+                && memcmp(blocks[found - 1], blocks[k], lengths[k]) == 0)
+                break;
+        if (found == 0)
+        {
+            // A new tile; the bucket remembers where its contents are, tile_offsets where it is stored:
+            buckets[bucket] = (uint32_t) (k + 1);
+            tile_offsets[k] = tile_bytes;
+            tile_bytes += (uint32_t) lengths[k];
+            tile_count++;
+        }
+        else
+            tile_offsets[k] = tile_offsets[found - 1];
+    }
+
+    pack = fopen(pack_name, "wb");
+    if (pack == NULL)
+    {
+        (void) printf("Error 24: Puzzle pack %s could not be written.\n", pack_name);
+        exit(24);
+    }
+
+    // Header, then the index, then each puzzle's layout, then each distinct tile in the order first seen:
+    layout_offset = PACK_HEADER_SIZE + (uint32_t) file_count * PACK_ENTRY_SIZE;
+    write_le32(header + 8, PACK_VERSION);
+    write_le32(header + 12, (uint32_t) file_count);
+    write_le32(header + 16, tile_count);
+    write_le32(header + 20, PACK_HEADER_SIZE);
+    write_le32(header + 24, layout_offset + (uint32_t) panel_count * 4);
+    written = fwrite(header, PACK_HEADER_SIZE, 1, pack) == 1;
+    for (int i = 0; i < file_count; i++)
+    {
+        // Name each puzzle after its file, leaving out any directories and extension:
+        name = strrchr(filenames[i], '/') ? strrchr(filenames[i], '/') + 1 : filenames[i];
+        name_length = strrchr(name, '.') && strrchr(name, '.') != name ? (size_t) (strrchr(name, '.') - name) : strlen(name);
+        (void) memset(entry, 0, PACK_ENTRY_SIZE);
+        (void) memcpy(entry, name, name_length < PACK_NAME_LENGTH ? name_length : PACK_NAME_LENGTH);
+        entry[PACK_NAME_LENGTH] = (char) job.sources[i].grid->rows;
+        entry[PACK_NAME_LENGTH + 1] = (char) job.sources[i].grid->columns;
+        entry[PACK_NAME_LENGTH + 2] = (char) job.sources[i].size.width;
+        entry[PACK_NAME_LENGTH + 3] = (char) job.sources[i].size.height;
+        write_le32(entry + PACK_NAME_LENGTH + 4, layout_offset + (uint32_t) starts[i] * 4);
+        written = written && fwrite(entry, PACK_ENTRY_SIZE, 1, pack) == 1;
+    }
+    for (size_t k = 0; k < panel_count; k++)
+    {
+        write_le32(layout_entry, tile_offsets[k]);
+        written = written && fwrite(layout_entry, 4, 1, pack) == 1;
+    }
+    next_offset = 0;
+    for (size_t k = 0; k < panel_count; k++)
+        if (tile_offsets[k] == next_offset) // Tiles were placed as first seen, so this is where each first appears.
+        {
+            written = written && fwrite(blocks[k], lengths[k], 1, pack) == 1;
+            next_offset += (uint32_t) lengths[k];
+        }
+    if (fclose(pack) || !written)
+    {
+        (void) printf("Error 24: Puzzle pack %s could not be written.\n", pack_name);
+        exit(24);
+    }
+
+    (void) printf("Wrote %d puzzles to %s, with %lu distinct tiles out of %lu.\n",
+                  file_count, pack_name, (unsigned long) tile_count, (unsigned long) panel_count);
+    for (int i = 0; i < file_count; i++)
+        free(job.sources[i].tiles);
+    free(buckets);
+    free(tile_offsets);
+    free(lengths);
+    free(hashes);
+    free(blocks);
+    free(starts);
+    free(job.sources);
+}
+
+
+/*********************************************************************************************************************************
+ * validate_sources():  Purpose: Thread body for compile_pack(): claims and validates source files one at a time until none are  *
+ *                                 left, so that a thread given quick files simply goes on to take more                          *
+ *                      Parameters: - void *job --> pointer to the Pack_Job shared by all the threads                            *
+ *                      Return value: void * --> always NULL                                                                     *
+ *                      Side effects: - alters the sources of the Pack_Job pointed to by "void *job"                             *
+ *                                    - reads external files                                                                     *
+ *********************************************************************************************************************************/
+void *validate_sources(void *job)
+{
+    Pack_Job *shared = job;
+    int claimed;
+
+    for (;;)
+    {
+        (void) pthread_mutex_lock(&shared->lock);
+        claimed = shared->next < shared->count ? shared->next++ : -1;
+        (void) pthread_mutex_unlock(&shared->lock);
+        if (claimed < 0)
+            return NULL;
+        validate_source(&shared->sources[claimed]);
+    }
+}
+
+
+/**************************************************************************************************************************************
+ * validate_source():   Purpose: Maps a single source file, checks it just as loading it to play would (with check_formatting()),     *
+ *                                 and, if it is valid, copies out and hashes its tile blocks (into memory freed by compile_pack()).  *
+ *                                 It runs on compile_pack()'s threads, so it records every failure in the source for                 *
+ *                                 compile_pack() to report, and never prints or terminates the program itself.                       *
+ *                      Parameters: - Pack_Source *source --> pointer to the source, with its filename set                            *
+ *                      Return value: none                                                                                            *
+ *                      Side effects: - alters the variable pointed to by "Pack_Source *source"                                       *
+ *                                    - allocates memory                                                                              *
+ *                                    - reads external files                                                                          *
+ **************************************************************************************************************************************/
+void validate_source(Pack_Source *source)
+{
+    Mapped_File file;
+    long offset;
+
+    if (!map_file(source->filename, &file))
+    {
+        source->status = SOURCE_UNOPENED;
+        return;
+    }
+
+    source->error_offset = check_formatting(&file, &offset, &source->grid, &source->size);
+    if (offset < 0)
+        source->status = SOURCE_NO_PUZZLE;
+    else if (source->error_offset >= 0)
+    {
+        source->status = SOURCE_FORMAT_ERROR;
+        locate_byte(&file, source->error_offset, &source->line, &source->column);
+    }
+    else
+    {
+        // Tile blocks are stored just as tiles are in memory, so they are copied out as if to play:
+        source->status = SOURCE_VALID;
+        source->tiles = malloc((size_t) source->grid->cells * PANEL_BYTES(source->size)); // compile_pack() reports it if this
+        if (source->tiles != NULL)                                                           //     fails.
+            store_picture_from_file(&file, offset, source->grid, source->size, source->tiles);
+        for (int p = 0; p < source->grid->cells && source->tiles != NULL; p++)
+            source->hashes[p] = hash_tile(source->tiles + (size_t) p * PANEL_BYTES(source->size), PANEL_BYTES(source->size));
+    }
+
+    (void) unmap_file(&file);
+}
+
+
+/**************************************************************************************
+ * hash_tile():         Purpose: Returns the 64-bit FNV-1a hash of a tile block       *
+ *                      Parameters: - const char *tile --> pointer to the tile block  *
+ *                                  - size_t length --> its length in bytes           *
+ *                      Return value: uint64_t                                        *
+ *                      Side effects: none                                            *
+ **************************************************************************************/
+uint64_t hash_tile(const char *tile, size_t length)
+{
+    uint64_t hash = FNV_OFFSET_BASIS;
+
+    for (size_t i = 0; i < length; i++)
+        hash = (hash ^ (unsigned char) tile[i]) * FNV_PRIME;
+
+    return hash;
+}
+
+
+/****************************************************************************************************************************
+ * write_le32():        Purpose: Stores a 32-bit unsigned integer as four little-endian bytes (the inverse of read_le32())  *
+ *                      Parameters: - char *bytes --> pointer to the first of the four bytes                                *
+ *                                  - uint32_t value --> the integer to store                                               *
+ *                      Return value: none                                                                                  *
+ *                      Side effects: - alters the four bytes pointed to by "char *bytes"                                   *
+ ****************************************************************************************************************************/
+void write_le32(char *bytes, uint32_t value)
+{
+    for (int i = 0; i < 4; i++)
+        bytes[i] = (char) (value >> (8 * i) & 0xFF);
+}
+
+
+/******************************************************************************************************************************
+ * command_to_move():   Purpose: Determines whether a command is a move (a slide, flip, or rotation, in long or short form),  *
+ *                                 storing its move code if so; the reverse of move_to_command()                              *
+ *                      Parameters: - char *command --> the string containing the command                                     *
+ *                                  - int n --> the length (in characters) of the command                                     *
+ *                                  - uint8_t *move --> pointer to the variable for storing the move code                     *
+ *                      Return value: bool                                                                                    *
+ *                      Side effects: - alters the variable pointed to by "uint8_t *move"                                     *
+ ******************************************************************************************************************************/
+bool command_to_move(char *command, int n, uint8_t *move)
+{
+    char pattern[MAX_LINE + 1]; // The command with its panel number (if any) written as "0", to compare against the forms below
+    int panel_number = 0;
+    int start, digits;
+    int flip;
+
+    // The panel number is the first run of digits (at most two, since no board has more than MAX_CELLS panels):
+    for (start = 0; start < n && !isdigit((unsigned char) command[start]); start++);
+    for (digits = 0; start + digits < n && isdigit((unsigned char) command[start + digits]); digits++)
+        panel_number = panel_number * 10 + command[start + digits] - '0';
+    if (digits > 2 || panel_number >= MAX_CELLS)
+        return false;
+    (void) memcpy(pattern, command, (size_t) start);
+    if (digits > 0)
+        pattern[start++] = '0';
+    (void) strcpy(pattern + start, command + start - (digits > 0) + digits);
+
+    if (caseless_cmp(pattern, "flip panel 0 horizontally") || caseless_cmp(pattern, "0 h"))
+        flip = FLIP_HORIZONTAL;
+    else if (caseless_cmp(pattern, "flip panel 0 vertically") || caseless_cmp(pattern, "0 v"))
+        flip = FLIP_VERTICAL;
+    else if (caseless_cmp(pattern, "rotate panel 0") || caseless_cmp(pattern, "0 r"))
+        flip = ROTATE;
+    else
+    {
+        if (caseless_cmp(command, "up") || caseless_cmp(command, "w"))
+            *move = SLIDE_MOVE(SLIDE_UP);
+        else if (caseless_cmp(command, "down") || caseless_cmp(command, "s"))
+            *move = SLIDE_MOVE(SLIDE_DOWN);
+        else if (caseless_cmp(command, "left") || caseless_cmp(command, "a"))
+            *move = SLIDE_MOVE(SLIDE_LEFT);
+        else if (caseless_cmp(command, "right") || caseless_cmp(command, "d"))
+            *move = SLIDE_MOVE(SLIDE_RIGHT);
+        else
+            return false;
+        return true;
+    }
+    *move = FLIP_MOVE(panel_number, flip);
+
+    return true;
+}
+
+
+/**********************************************************************************************************************************************************
+ * run_script():        Purpose: Plays a puzzle headlessly from a file of commands, one per line, with no screen clears, pauses,                          *
+ *                                 or display, for regression and load testing. Moves, "solve" (which applies the whole solution                          *
+ *                                 at once), "hint", "submit", "quit", and lines of several moves act as in the game; the commands that only show things  *
+ *                                 are ignored, as are blank lines and lines starting with '#'. The script stops at a correct                             *
+ *                                 submission, "quit", or end of file, and then a single result line is printed, such as                                  *
+ *                                 "result=solved moves=24 illegal=0 unrecognized=0 lines=25 seed=7", ending with the difficulty the scramble really      *
+ *                                 reached (such as " difficulty=37", which is short of the difficulty asked for when the art can't be scrambled that     *
+ *                                 far) if a 3x3 board was scrambled to one. Each "hint" prints a line such as "hint=3 h distance=9" (or                  *
+ *                                 "hint=none distance=-1" if the board can't be solved, with " reason=gave_up" added if the search                       *
+ *                                 gave up on a board that can).                                                                                          *
+ *                      Parameters: - const char *script_name --> the name of the command file ("-" for stdin)                                            *
+ *                                  - const char *puzzle_name --> the name of the puzzle file or pack (or NULL for the default puzzle)                    *
+ *                                  - long pack_puzzle --> which puzzle of a pack to play, counting from 1                                                *
+ *                                  - uint64_t seed --> seed for the scramble's random number generator                                                   *
+ *                                  - int difficulty --> the number of moves the scramble should be from solved                                           *
+ *                                      (or -1 for a uniformly random scramble)                                                                           *
+ *                      Return value: none                                                                                                                *
+ *                      Side effects: - prints to stdout                                                                                                  *
+ *                                    - reads from stdin                                                                                                  *
+ *                                    - terminates program                                                                                                *
+ *                                    - reads external files                                                                                              *
+ **********************************************************************************************************************************************************/
+void run_script(const char *script_name, const char *puzzle_name, long pack_puzzle, uint64_t seed, int difficulty)
+{
+    FILE *script = strcmp(script_name, "-") == 0 ? stdin : fopen(script_name, "r");
+    Sp_State *state;
+    uint8_t solution[SP_MAX_SOLUTION_LENGTH];
+    int solution_length;
+    char command[MAX_LINE + 1];
+    char hint_command[MAX_LINE];
+    int length;
+    uint8_t move;
+    uint8_t sequence[MAX_LINE];
+    int count;
+    long lines = 0, moves = 0, illegal = 0, unrecognized = 0;
+
+    if (script == NULL)
+    {
+        (void) printf("Error 26: Script %s could not be opened.\n", script_name);
+        exit(26);
+    }
+
+    // Load the puzzle, refusing anything the game itself would refuse:
+    state = sp_create(puzzle_name, pack_puzzle);
+    if (state == NULL)
+    {
+        (void) printf("Error 26: Puzzle %s could not be loaded (missing, misformatted, or no such puzzle in the pack).\n",
+                      puzzle_name == NULL ? "(default)" : puzzle_name);
+        exit(26);
+    }
+    if (!sp_scramble(state, seed, difficulty))
+    {
+        (void) printf("Error 27: Not enough memory to play.\n");
+        exit(27);
+    }
+
+    while ((length = read_script_line(script, command, MAX_LINE)) >= 0)
+    {
+        lines++;
+        if (length == 0 || command[0] == '#')
+            continue;
+        if (command_to_move(command, length, &move))
+        {
+            if (sp_apply_moves(state, &move, 1))
+                moves++;
+            else
+                illegal++;
+        }
+        else if ((count = command_to_moves(command, sequence, MAX_LINE)) > 0)
+        {
+            if (sp_check_moves(state, sequence, (size_t) count) < (size_t) count)
+                illegal++; // A line of moves counts as one illegal move, as none of it is made.
+            else
+                moves += (long) sp_apply_moves(state, sequence, (size_t) count);
+        }
+        else if (caseless_cmp(command, "undo") || caseless_cmp(command, "u"))
+        {
+            if (sp_undo(state))
+                moves++;
+            else
+                illegal++;
+        }
+        else if (caseless_cmp(command, "redo") || caseless_cmp(command, "y"))
+        {
+            if (sp_redo(state))
+                moves++;
+            else
+                illegal++;
+        }
+        else if (caseless_cmp(command, "submit"))
+        {
+            if (sp_is_solved(state))
+                break;
+        }
+        else if (caseless_cmp(command, "solve"))
+        {
+            solution_length = sp_solve(state, solution, SP_MAX_SOLUTION_LENGTH);
+            if (solution_length > 0)
+                moves += (long) sp_apply_moves(state, solution, (size_t) solution_length);
+        }
+        else if (caseless_cmp(command, "hint"))
+        {
+            solution_length = sp_solve(state, solution, SP_MAX_SOLUTION_LENGTH);
+            if (solution_length == SP_GAVE_UP)
+                (void) printf("hint=none distance=-1 reason=gave_up\n");
+            else if (solution_length < 0)
+                (void) printf("hint=none distance=-1\n");
+            else
+                (void) printf("hint=%s distance=%d\n", solution_length ? move_to_command(hint_command, solution[0]) : "submit",
+                              solution_length);
+        }
+        else if (caseless_cmp(command, "quit") || caseless_cmp(command, "q"))
+            break;
+        else if (!caseless_cmp(command, "help") && !caseless_cmp(command, "show numbering")
+                 && !caseless_cmp(command, "show solution"))
+            unrecognized++;
+    }
+    if (script != stdin)
+        (void) fclose(script);
+
+    (void) printf("result=%s moves=%ld illegal=%ld unrecognized=%ld lines=%ld seed=%llu",
+                  sp_is_solved(state) ? "solved" : "unsolved", moves, illegal, unrecognized, lines, (unsigned long long) seed);
+    if (state->distance >= 0)
+        (void) printf(" difficulty=%d", state->distance);
+    (void) printf("\n");
+    sp_destroy(state);
+}
+
+
+/******************************************************************************************************************************
+ * read_script_line():  Purpose: Reads a line from a script like read_line() does from stdin, but returns -1 at end of file   *
+ *                                 (so that an empty line can be told apart from the end) and drops a carriage return before  *
+ *                                 the new-line, so that scripts written on Windows work too                                  *
+ *                      Parameters: - FILE *script --> the script to read from                                                *
+ *                                  - char input[] --> the array in which to store the line                                   *
+ *                                  - int n --> the maximum amount of characters that can be stored                           *
+ *                      Return value: int                                                                                     *
+ *                      Side effects: - reads from the script (which may be stdin)                                            *
+ *                                    - modifies the array input[]                                                            *
+ ******************************************************************************************************************************/
+int read_script_line(FILE *script, char input[], int n)
+{
+    int i = 0, ch;
+
+    while ((ch = getc(script)) != '\n' && ch != EOF)
+        if (i < n)
+            input[i++] = ch;
+    input[i] = '\0';
+    if (i > 0 && input[i - 1] == '\r')
+        input[--i] = '\0';
+
+    return ch == EOF && i == 0 ? -1 : i;
+}
+
+
+/****************************************************************************************************************************************
+ * load_puzzle():       Purpose: Loads a puzzle without asking anything or printing anything, for the engine and headless               *
+ *                                 modes, and returns whether it could be loaded: files must pass check_formatting(), and packs         *
+ *                                 check_pack() and have the requested puzzle                                                           *
+ *                      Parameters: - const char *puzzle_name --> the name of the puzzle file or pack (or NULL for the default puzzle)  *
+ *                                  - long pack_puzzle --> which puzzle of a pack to load, counting from 1                              *
+ *                                  - char tiles[] --> the array for storing the puzzle's art, indexed by tile                          *
+ *                                  - const Grid **grid --> pointer to the variable for storing the puzzle's size                       *
+ *                                  - Panel_Size *size --> pointer to the variable for storing the size of its panels                   *
+ *                      Return value: bool                                                                                              *
+ *                      Side effects: - alters the array "char tiles[]" and the variables pointed to by "const Grid **grid" and         *
+ *                                      "Panel_Size *size"                                                                              *
+ *                                    - reads external files                                                                            *
+ ****************************************************************************************************************************************/
+bool load_puzzle(const char *puzzle_name, long pack_puzzle, char tiles[], const Grid **grid, Panel_Size *size)
+{
+    Mapped_File picture_file;
+    long offset;
+    bool loaded = true;
+
+    if (puzzle_name == NULL)
+    {
+        *grid = store_picture_heart(tiles, size);
+        return true;
+    }
+    if (!map_file(puzzle_name, &picture_file))
+        return false;
+
+    if (is_pack(&picture_file))
+    {
+        loaded = check_pack(&picture_file) && pack_puzzle >= 1 && pack_puzzle <= (long) read_le32(picture_file.data + 12);
+        if (loaded)
+            *grid = store_picture_from_pack(&picture_file, (uint32_t) pack_puzzle - 1, tiles, size);
+    }
+    else
+    {
+        loaded = check_formatting(&picture_file, &offset, grid, size) < 0;
+        if (loaded)
+            store_picture_from_file(&picture_file, offset, *grid, *size, tiles);
+    }
+    (void) unmap_file(&picture_file);
+
+    return loaded;
+}
+
+
+/*********************************************************************************************************************************
+ * create_state():      Purpose: Allocates an engine state for a loaded puzzle, with its atlas built, its board solved, and its  *
+ *                                 sidebar ready, returning NULL if there isn't enough memory                                    *
+ *                      Parameters: - const char tiles[] --> the puzzle's art, indexed by tile                                   *
+ *                                  - const Grid *grid --> the puzzle's size                                                     *
+ *                                  - Panel_Size size --> the size of its panels                                                 *
+ *                      Return value: Sp_State                                                                                   *
+ *                      Side effects: - allocates memory (freed by sp_destroy())                                                 *
+ *********************************************************************************************************************************/
+Sp_State *create_state(const char tiles[], const Grid *grid, Panel_Size size)
+{
+    Sp_State *state = aligned_alloc(_Alignof(Sp_State), sizeof(Sp_State)); // Keeps the match table on cache-line boundaries
+
+    if (state == NULL)
+        return NULL;
+    if (!build_atlas(&state->atlas, grid, size, tiles))
+    {
+        free(state);
+        return NULL;
+    }
+    state->board = solved_board(grid);
+    make_sidebar(&state->atlas, &state->final_piece_text, &state->final_piece);
+    state->table = NULL;
+    state->table_file = (Mapped_File) {.data = NULL, .size = 0};
+    state->distance = -1;
+    state->correct = grid->cells;
+    state->history = (History) {.moves = NULL, .capacity = 0, .first = 0, .count = 0, .undone = 0};
+    state->log = NULL;
+    rng_seed(&state->rng, 0);
+
+    return state;
+}
+
+
+/********************************************************************************************************************************************
+ * make_sidebar():      Purpose: Points to the sidebar graphics in the atlas: "Final Piece:" at the foot of the top portion, and            *
+ *                                 the art of the piece left out for the gap below it                                                       *
+ *                      Parameters: - const Tile_Atlas *atlas --> pointer to the puzzle's art in every orientation                          *
+ *                                  - const char **final_piece_text --> pointer to the variable for storing the top portion of the sidebar  *
+ *                                  - const char **final_piece --> pointer to the variable for storing the bottom portion of the sidebar    *
+ *                      Return value: none                                                                                                  *
+ *                      Side effects: - alters the variables pointed to by the const char ** parameters                                     *
+ ********************************************************************************************************************************************/
+void make_sidebar(const Tile_Atlas *atlas, const char **final_piece_text, const char **final_piece)
+{
+    *final_piece = atlas_panel(atlas, (atlas->grid->cells - 1) * NUM_ORIENTATIONS);
+    *final_piece_text = atlas_panel(atlas, ATLAS_SIDEBAR(atlas->grid));
+}
+
+
+/*********************************************************************************************************************************
+ * state_table():       Purpose: Returns the distance table for a state's 3x3 board, opening it (see open_distance_table()) the  *
+ *                                 first time it is needed, or NULL for other board sizes or if there isn't enough memory        *
+ *                      Parameters: - Sp_State *state --> pointer to the state                                                   *
+ *                      Return value: const Distance_Table                                                                       *
+ *                      Side effects: - alters the variable pointed to by "Sp_State *state"                                      *
+ *                                    - allocates memory (freed by sp_destroy())                                                 *
+ *                                    - reads external files                                                                     *
+ *********************************************************************************************************************************/
+const Distance_Table *state_table(Sp_State *state)
+{
+    if (state->table == NULL && state->atlas.grid == grid_of(DEFAULT_SIDE, DEFAULT_SIDE))
+        state->table = open_distance_table(&state->table_file);
+
+    return state->table;
+}
+
+
+/****************************************************************************************************************************************
+ * sp_create():         Purpose: Creates an engine state for a puzzle file, a puzzle of a pack, or the default puzzle, with the         *
+ *                                 board solved, returning NULL if the puzzle can't be loaded or there isn't enough memory              *
+ *                      Parameters: - const char *puzzle_name --> the name of the puzzle file or pack (or NULL for the default puzzle)  *
+ *                                  - long pack_puzzle --> which puzzle of a pack to load, counting from 1                              *
+ *                      Return value: Sp_State                                                                                          *
+ *                      Side effects: - allocates memory (freed by sp_destroy())                                                        *
+ *                                    - reads external files                                                                            *
+ ****************************************************************************************************************************************/
+Sp_State *sp_create(const char *puzzle_name, long pack_puzzle)
+{
+    char tiles[MAX_PICTURE_SIZE];
+    const Grid *grid;
+    Panel_Size size;
+
+    if (!load_puzzle(puzzle_name, pack_puzzle, tiles, &grid, &size))
+        return NULL;
+
+    return create_state(tiles, grid, size);
+}
+
+
+/*************************************************************************************************
+ * sp_destroy():        Purpose: Frees an engine state (a NULL pointer is ignored, like free())  *
+ *                      Parameters: - Sp_State *state --> pointer to the state                   *
+ *                      Return value: none                                                       *
+ *                      Side effects: - frees memory                                             *
+ *************************************************************************************************/
+void sp_destroy(Sp_State *state)
+{
+    if (state == NULL)
+        return;
+    close_distance_table(state->table, &state->table_file);
+    free(state->history.moves);
+    if (state->log != NULL)
+        (void) fclose(state->log);
+    free(state->atlas.art);
+    free(state);
+}
+
+
+/********************************************************************************************************************************
+ * sp_scramble():       Purpose: Scrambles the board as the game does, opening the distance table (see open_distance_table())   *
+ *                                 the first time a difficulty is given for a 3x3 board, and returns false only if there isn't  *
+ *                                 enough memory for it. A 3x3 board scrambled to a difficulty is then solved, to record how    *
+ *                                 many moves from solved it really is.                                                         *
+ *                      Parameters: - Sp_State *state --> pointer to the state                                                  *
+ *                                  - uint64_t seed --> seed for the scramble's random number generator                         *
+ *                                  - int difficulty --> the number of moves the scramble should be from solved                 *
+ *                                      (or -1 for a uniformly random scramble)                                                 *
+ *                      Return value: bool                                                                                      *
+ *                      Side effects: - alters the variable pointed to by "Sp_State *state"                                     *
+ *                                    - allocates memory (freed by sp_destroy())                                                *
+ *                                    - reads external files                                                                    *
+ ********************************************************************************************************************************/
+bool sp_scramble(Sp_State *state, uint64_t seed, int difficulty)
+{
+    Solution solution;
+
+    if (difficulty >= 0 && state->atlas.grid == grid_of(DEFAULT_SIDE, DEFAULT_SIDE) && state_table(state) == NULL)
+        return false;
+    rng_seed(&state->rng, seed);
+    scramble_puzzle(&state->atlas, &state->board, &state->final_piece_text, &state->final_piece, &state->display, &state->rng,
+                    state->table, difficulty);
+    state->distance = -1;
+    if (difficulty >= 0 && state->table != NULL && solve_board(&state->atlas, state->table, &state->board, &solution))
+        state->distance = solution.length;
+    state->correct = count_correct(&state->atlas, &state->board);
+    state->history.count = 0; // The scramble is not a move, so it can't be undone.
+    state->history.undone = 0;
+
+    return true;
+}
+
+
+/******************************************************************************************************************************
+ * sp_apply_moves():    Purpose: Applies a batch of move codes in order, stopping at the first illegal one (sliding from the  *
+ *                                 edge, or flipping the gap), and returns how many were applied. The count of correct        *
+ *                                 positions is updated by each move's difference, and each move is added to the undo         *
+ *                                 history (forgetting anything undone); the display is left alone until sp_render_into()     *
+ *                                 asks for it.                                                                               *
+ *                      Parameters: - Sp_State *state --> pointer to the state                                                *
+ *                                  - const uint8_t *moves --> pointer to the move codes                                      *
+ *                                  - size_t n --> the number of move codes                                                   *
+ *                      Return value: size_t                                                                                  *
+ *                      Side effects: - alters the variable pointed to by "Sp_State *state"                                   *
+ ******************************************************************************************************************************/
+size_t sp_apply_moves(Sp_State *state, const uint8_t *moves, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+    {
+        if (!apply_move(state, moves[i]))
+            return i;
+        history_push(&state->history, moves[i]);
+        if (state->log != NULL)
+            record_event(state, moves[i]);
+    }
+
+    return n;
+}
+
+
+/***************************************************************************************************************************
+ * sp_check_moves():    Purpose: Returns how many of a batch of move codes could be made in a row from the current board,  *
+ *                                 without making any of them; n means sp_apply_moves() would apply them all               *
+ *                      Parameters: - const Sp_State *state --> pointer to the state                                       *
+ *                                  - const uint8_t *moves --> pointer to the move codes                                   *
+ *                                  - size_t n --> the number of move codes                                                *
+ *                      Return value: size_t                                                                               *
+ *                      Side effects: none                                                                                 *
+ ***************************************************************************************************************************/
+size_t sp_check_moves(const Sp_State *state, const uint8_t *moves, size_t n)
+{
+    Board board = state->board;
+
+    for (size_t i = 0; i < n; i++)
+        if (!board_apply(&board, moves[i]))
+            return i;
+
+    return n;
+}
+
+
+/**********************************************************************************************************************************
+ * sp_undo():           Purpose: Takes back the last move not yet undone, by making its inverse, in constant time; returns false  *
+ *                                 if there is nothing left to undo                                                               *
+ *                      Parameters: - Sp_State *state --> pointer to the state                                                    *
+ *                      Return value: bool                                                                                        *
+ *                      Side effects: - alters the variable pointed to by "Sp_State *state"                                       *
+ **********************************************************************************************************************************/
+bool sp_undo(Sp_State *state)
+{
+    History *history = &state->history;
+    uint8_t move;
+
+    if (history->count == 0)
+        return false;
+    move = history->moves[(history->first + history->count - 1) & (history->capacity - 1)];
+    (void) apply_move(state, INVERSE_MOVE(move)); // Always legal: it only puts back what the move changed.
+    history->count--;
+    history->undone++;
+    if (state->log != NULL)
+        record_event(state, LOG_UNDO);
+
+    return true;
+}
+
+
+/********************************************************************************************************************************
+ * sp_redo():           Purpose: Makes again the last move undone, in constant time; returns false if there is nothing to redo  *
+ *                                 (none has been undone, or a move has been made since)                                        *
+ *                      Parameters: - Sp_State *state --> pointer to the state                                                  *
+ *                      Return value: bool                                                                                      *
+ *                      Side effects: - alters the variable pointed to by "Sp_State *state"                                     *
+ ********************************************************************************************************************************/
+bool sp_redo(Sp_State *state)
+{
+    History *history = &state->history;
+
+    if (history->undone == 0)
+        return false;
+    (void) apply_move(state, history->moves[(history->first + history->count) & (history->capacity - 1)]);
+    history->count++;
+    history->undone--;
+    if (state->log != NULL)
+        record_event(state, LOG_REDO);
+
+    return true;
+}
+
+
+/*********************************************************************************************************************************
+ * sp_is_solved():      Purpose: Determines whether the board shows the completed picture (as "submit" would), in constant time  *
+ *                      Parameters: - const Sp_State *state --> pointer to the state                                             *
+ *                      Return value: bool                                                                                       *
+ *                      Side effects: none                                                                                       *
+ *********************************************************************************************************************************/
+bool sp_is_solved(const Sp_State *state)
+{
+    return state->correct == state->atlas.grid->cells;
+}
+
+
+/********************************************************************************************************************
+ * sp_solve():          Purpose: Stores the move codes of a shortest solution of the board, and returns its length  *
+ *                                 (or -1 if there is none, or it won't fit, and SP_GAVE_UP if the search gave up   *
+ *                                 on a board that can be solved), opening the distance table (see state_table())   *
+ *                                 the first time a 3x3 board is solved                                             *
+ *                      Parameters: - Sp_State *state --> pointer to the state                                      *
+ *                                  - uint8_t *moves --> pointer to the array for storing the move codes            *
+ *                                  - int capacity --> the number of move codes the array can hold                  *
+ *                      Return value: int                                                                           *
+ *                      Side effects: - alters the array pointed to by "uint8_t *moves"                             *
+ *                                    - alters the variable pointed to by "Sp_State *state"                         *
+ *                                    - allocates memory (freed by sp_destroy())                                    *
+ *                                    - reads external files                                                        *
+ ********************************************************************************************************************/
+int sp_solve(Sp_State *state, uint8_t *moves, int capacity)
+{
+    Solution solution;
+
+    if (!solve_board(&state->atlas, state_table(state), &state->board, &solution))
+        return board_solvable(&state->atlas, &state->board) ? SP_GAVE_UP : -1;
+    if (solution.length > capacity)
+        return -1;
+    (void) memcpy(moves, solution.moves, (size_t) solution.length);
+
+    return solution.length;
+}
+
+
+/************************************************************************************************************************************
+ * sp_render_into():    Purpose: Composes the display for the board and writes it to a buffer as lines of text, as much as fits     *
+ *                                 (always null-terminated unless size is 0), returning the display's full length like snprintf();  *
+ *                                 a buffer of SP_RENDER_SIZE bytes always fits it                                                  *
+ *                      Parameters: - Sp_State *state --> pointer to the state                                                      *
+ *                                  - char *buffer --> pointer to the buffer                                                        *
+ *                                  - size_t size --> the size of the buffer in bytes                                               *
+ *                      Return value: size_t                                                                                        *
+ *                      Side effects: - alters the variable pointed to by "Sp_State *state" (its display)                           *
+ *                                    - alters the buffer pointed to by "char *buffer"                                              *
+ ************************************************************************************************************************************/
+size_t sp_render_into(Sp_State *state, char *buffer, size_t size)
+{
+    char text[MAX_DISPLAY_WIDTH + 1]; // A line of the display and its new-line
+    Viewport view = full_view(state->atlas.grid);
+    size_t used = 0;
+    size_t length;
+
+    update_display(&state->atlas, &state->board, state->final_piece_text, state->final_piece, &view, &state->display);
+    for (int line = 0; line < state->display.lines; line++)
+    {
+        length = (size_t) state->display.lengths[line];
+        (void) memcpy(text, state->display.text[line], length);
+        text[length++] = '\n';
+        if (used < size)
+            (void) memcpy(buffer + used, text, used + length < size ? length : size - used);
+        used += length;
+    }
+    if (size > 0)
+        buffer[used < size ? used : size - 1] = '\0';
+
+    return used;
+}
+
+
+/**********************************************************************************************************************************
+ * count_correct():     Purpose: Counts the positions of a board that show their solution art (the gap counting only in the last  *
+ *                                 position), which is the grid's number of cells exactly when the board is solved                *
+ *                      Parameters: - const Tile_Atlas *atlas --> pointer to the puzzle's art in every orientation                *
+ *                                  - const Board *board --> pointer to the variable containing the board                         *
+ *                      Return value: int                                                                                         *
+ *                      Side effects: none                                                                                        *
+ **********************************************************************************************************************************/
+int count_correct(const Tile_Atlas *atlas, const Board *board)
+{
+    int correct = 0;
+
+    for (int i = 0; i < atlas->grid->cells; i++)
+        correct += tile_correct(atlas, board, i);
+
+    return correct;
+}
+
+
+/******************************************************************************************************************************
+ * tile_correct():      Purpose: Returns 1 if whatever is in a position of a board (in its current orientation) shows that    *
+ *                                 position's solution art, otherwise 0, from the atlas's matches rather than the art itself  *
+ *                      Parameters: - const Tile_Atlas *atlas --> pointer to the puzzle's art in every orientation            *
+ *                                  - const Board *board --> pointer to the variable containing the board                     *
+ *                                  - int position --> the position, from 0 to the grid's cells less one                      *
+ *                      Return value: int                                                                                     *
+ *                      Side effects: none                                                                                    *
+ ******************************************************************************************************************************/
+int tile_correct(const Tile_Atlas *atlas, const Board *board, int position)
+{
+    int tile = board_tile_at(board, position);
+
+    return atlas->matches[tile][position] >> board_orientation(board, tile) & 1;
+}
+
+
+/**********************************************************************************************************************************
+ * command_to_moves():  Purpose: Splits a command of several short-form moves, such as "wwaasd 2h 5r" (slides as w, a, s, and d;  *
+ *                                 flips as a panel number and h, v, or r, with or without a space between), into move codes,     *
+ *                                 and returns how many there are, or -1 if anything else is in the command                       *
+ *                      Parameters: - const char *command --> the string containing the command                                   *
+ *                                  - uint8_t moves[] --> the array for storing the move codes                                    *
+ *                                  - int capacity --> the number of move codes the array can hold                                *
+ *                      Return value: int                                                                                         *
+ *                      Side effects: - alters the array moves[]                                                                  *
+ **********************************************************************************************************************************/
+int command_to_moves(const char *command, uint8_t moves[], int capacity)
+{
+    const char *slides = "wsad"; // Indexed by SLIDE_UP, SLIDE_DOWN, SLIDE_LEFT, and SLIDE_RIGHT
+    const char *flips = "hvr"; // Indexed by orientation bits, less one
+    const char *found;
+    int position;
+    int count = 0;
+
+    for (const char *c = command; *c; c++)
+    {
+        if (*c == ' ')
+            continue;
+        if (count == capacity)
+            return -1;
+        if ((found = strchr(slides, tolower((unsigned char) *c))) != NULL)
+            moves[count++] = SLIDE_MOVE(found - slides);
+        else if (isdigit((unsigned char) *c))
+        {
+            for (position = *c - '0'; isdigit((unsigned char) c[1]) && position < MAX_CELLS; c++)
+                position = position * 10 + c[1] - '0';
+            if (position >= MAX_CELLS)
+                return -1;
+            while (c[1] == ' ')
+                c++;
+            if (c[1] == '\0' || (found = strchr(flips, tolower((unsigned char) *++c))) == NULL)
+                return -1;
+            moves[count++] = FLIP_MOVE(position, found - flips + 1);
+        }
+        else
+            return -1;
+    }
+
+    return count;
+}
+
+
+/***********************************************************************************************************************************
+ * set_raw_input():     Purpose: Switches the terminal on stdin between raw input, where each keystroke can be read as soon as it  *
+ *                                 is typed (without echo, line editing, or Ctrl-C and Ctrl-D taking effect), and the settings it  *
+ *                                 had to begin with, which are restored on exit in any case                                       *
+ *                      Parameters: - bool raw --> true for raw input, false for the original settings                             *
+ *                      Return value: none                                                                                         *
+ *                      Side effects: - alters the settings of the terminal on stdin                                               *
+ ***********************************************************************************************************************************/
+void set_raw_input(bool raw)
+{
+    static struct termios original; // The terminal's settings before the first call.
+    static bool saved = false;
+    struct termios settings;
+
+    if (!saved)
+    {
+        if (tcgetattr(STDIN_FILENO, &original))
+            return; // Not a terminal, so there is nothing to switch.
+        saved = true;
+        (void) atexit(restore_input);
+    }
+
+    settings = original;
+    if (raw)
+    {
+        settings.c_lflag &= (tcflag_t) ~(ICANON | ECHO | ISIG);
+        settings.c_cc[VMIN] = 1; // read() waits for the first keystroke, then returns every one typed so far.
+        settings.c_cc[VTIME] = 0;
+    }
+    (void) tcsetattr(STDIN_FILENO, TCSANOW, &settings);
+}
+
+
+/********************************************************************************************************************************
+ * restore_input():     Purpose: Puts the terminal on stdin back as it was before set_raw_input(), so that the shell is usable  *
+ *                                 however the program exits                                                                    *
+ *                      Parameters: none                                                                                        *
+ *                      Return value: none                                                                                      *
+ *                      Side effects: - alters the settings of the terminal on stdin                                            *
+ ********************************************************************************************************************************/
+void restore_input(void)
+{
+    set_raw_input(false);
+}
+
+
+/***********************************************************************************************************************************
+ * read_keys():         Purpose: Waits for a keystroke in raw input, then takes every keystroke that has arrived since (so that    *
+ *                                 keys typed faster than the board is drawn are all handled before it is next drawn) and makes    *
+ *                                 the move each one asks for: arrow keys and W, A, S, and D slide, a panel number followed by     *
+ *                                 H, V, or R flips, and U and Y undo and redo. Moves that can't be made are skipped with a beep.  *
+ *                                 Enter or ':' stops at that key and asks for the command prompt; Q, Ctrl-C, or Ctrl-D asks to    *
+ *                                 quit. Other keys are ignored.                                                                   *
+ *                      Parameters: - Sp_State *state --> pointer to the puzzle being played                                       *
+ *                                  - int *panel --> pointer to a panel number typed without its flip yet (-1 for none),           *
+ *                                      carried from one call to the next                                                          *
+ *                      Return value: int --> KEYS_MOVED, KEYS_PROMPT, or KEYS_QUIT                                                *
+ *                      Side effects: - alters the variables pointed to by "Sp_State *state" and "int *panel"                      *
+ *                                    - reads from stdin                                                                           *
+ *                                    - prints to stdout                                                                           *
+ ***********************************************************************************************************************************/
+int read_keys(Sp_State *state, int *panel)
+{
+    const char *slides = "wsad"; // Indexed by SLIDE_UP, SLIDE_DOWN, SLIDE_LEFT, and SLIDE_RIGHT
+    const char *arrows = "ABDC"; // The final byte of each arrow key's escape sequence, in the same order
+    const char *flips = "hvr"; // Indexed by orientation bits, less one
+    const char *found;
+    char keys[KEY_BUFFER_SIZE];
+    ssize_t length;
+    uint8_t move;
+    int digit;
+    bool missed = false;
+
+    (void) fflush(stdout);
+    do
+        length = read(STDIN_FILENO, keys, sizeof(keys));
+    while (length < 0 && errno == EINTR);
+    if (length <= 0)
+        return KEYS_QUIT;
+
+    for (ssize_t i = 0; i < length; i++)
+    {
+        if (keys[i] == '\033' && i + 2 < length && (keys[i + 1] == '[' || keys[i + 1] == 'O')
+            && keys[i + 2] != '\0' && (found = strchr(arrows, keys[i + 2])) != NULL)
+        {
+            move = SLIDE_MOVE(found - arrows);
+            i += 2;
+        }
+        else if (*panel >= 0 && keys[i] != '\0' && (found = strchr(flips, tolower((unsigned char) keys[i]))) != NULL)
+            move = FLIP_MOVE(*panel, found - flips + 1);
+        else if (keys[i] != '\0' && (found = strchr(slides, keys[i])) != NULL)
+            move = SLIDE_MOVE(found - slides);
+        else if (isdigit((unsigned char) keys[i]))
+        {
+            // Digits add to the panel number while it stays on the board, so "1" then "2" is panel 12 on a 4x4 board:
+            digit = keys[i] - '0';
+            *panel = *panel >= 0 && *panel * 10 + digit < state->atlas.grid->cells ? *panel * 10 + digit : digit;
+            continue;
+        }
+        else if (keys[i] == 'u' || keys[i] == 'y')
+        {
+            *panel = -1;
+            if (!(keys[i] == 'u' ? sp_undo(state) : sp_redo(state)))
+                missed = true;
+            continue;
+        }
+        else if (keys[i] == '\n' || keys[i] == '\r' || keys[i] == ':')
+        {
+            *panel = -1;
+            return KEYS_PROMPT; // Anything typed after this is dropped, as it was meant for the prompt.
+        }
+        else if (tolower((unsigned char) keys[i]) == 'q' || keys[i] == CTRL_C || keys[i] == CTRL_D)
+            return KEYS_QUIT;
+        else
+            continue;
+
+        *panel = -1;
+        if (sp_apply_moves(state, &move, 1) == 0)
+            missed = true;
+    }
+    if (missed)
+        (void) printf("\a");
+
+    return KEYS_MOVED;
+}
+
+
+/*******************************************************************************************************************************
+ * apply_move():        Purpose: Makes a single move for sp_apply_moves(), sp_undo(), and sp_redo(), keeping the count of      *
+ *                                 correct positions up to date by the move's difference; returns false, changing nothing, if  *
+ *                                 the move is illegal (sliding from the edge, or flipping the gap)                            *
+ *                      Parameters: - Sp_State *state --> pointer to the state                                                 *
+ *                                  - uint8_t move --> the move code                                                           *
+ *                      Return value: bool                                                                                     *
+ *                      Side effects: - alters the variable pointed to by "Sp_State *state"                                    *
+ *******************************************************************************************************************************/
+bool apply_move(Sp_State *state, uint8_t move)
+{
+    Board *board = &state->board;
+    int gap = board->gap;
+    int gap_tile = board->grid->cells - 1;
+    int tile, orientation;
+
+    if (!board_apply(board, move))
+        return false;
+
+    if (move & 3)
+    {
+        // A flip only changes whether its own position is correct (the orientation before it is the one now, unflipped):
+        tile = board_tile_at(board, move >> 2);
+        orientation = board_orientation(board, tile);
+        state->correct += (state->atlas.matches[tile][move >> 2] >> orientation & 1)
+                          - (state->atlas.matches[tile][move >> 2] >> (orientation ^ (move & 3)) & 1);
+    }
+    else
+    {
+        // A slide swaps the gap with a tile, keeping their orientations, so only those two positions can change:
+        tile = board_tile_at(board, gap);
+        orientation = board_orientation(board, tile);
+        state->correct += (state->atlas.matches[tile][gap] >> orientation & 1)
+                          - (state->atlas.matches[tile][board->gap] >> orientation & 1)
+                          + (state->atlas.matches[gap_tile][board->gap] & 1) - (state->atlas.matches[gap_tile][gap] & 1);
+    }
+
+    return true;
+}
+
+
+/********************************************************************************************************************************
+ * history_push():      Purpose: Adds a move to the undo history, forgetting any moves undone before it. When the ring is full  *
+ *                                 it doubles; if there isn't memory for that, the oldest move is forgotten instead, so a long  *
+ *                                 game never runs out of memory because of its history.                                        *
+ *                      Parameters: - History *history --> pointer to the history                                               *
+ *                                  - uint8_t move --> the move code                                                            *
+ *                      Return value: none                                                                                      *
+ *                      Side effects: - alters the variable pointed to by "History *history"                                    *
+ *                                    - allocates memory (freed by sp_destroy())                                                *
+ ********************************************************************************************************************************/
+void history_push(History *history, uint8_t move)
+{
+    size_t capacity = history->capacity ? history->capacity * 2 : HISTORY_INITIAL_CAPACITY;
+    uint8_t *moves;
+
+    history->undone = 0;
+    if (history->count == history->capacity)
+    {
+        moves = malloc(capacity);
+        if (moves != NULL)
+        {
+            // Unwrap the ring into the new buffer, oldest first:
+            for (size_t i = 0; i < history->count; i++)
+                moves[i] = history->moves[(history->first + i) & (history->capacity - 1)];
+            free(history->moves);
+            history->moves = moves;
+            history->capacity = capacity;
+            history->first = 0;
+        }
+        else if (history->capacity == 0)
+            return; // Nothing can be remembered at all.
+        else
+        {
+            history->first = (history->first + 1) & (history->capacity - 1);
+            history->count--;
+        }
+    }
+    history->moves[(history->first + history->count) & (history->capacity - 1)] = move;
+    history->count++;
+}
+
+
+/*********************************************************************************************************************************
+ * write_varint():      Purpose: Writes an unsigned integer as a LEB128 varint: seven bits per byte, lowest first, with the top  *
+ *                                 bit set on every byte but the last, so that small values take a single byte                   *
+ *                      Parameters: - FILE *file --> the file to write to                                                        *
+ *                                  - uint64_t value --> the integer to write                                                    *
+ *                      Return value: bool --> whether it was written                                                            *
+ *                      Side effects: - writes to an external file                                                               *
+ *********************************************************************************************************************************/
+bool write_varint(FILE *file, uint64_t value)
+{
+    unsigned char bytes[MAX_VARINT_BYTES];
+    size_t length = 0;
+
+    do
+    {
+        bytes[length++] = (unsigned char) ((value & 0x7F) | (value > 0x7F ? 0x80 : 0));
+        value >>= 7;
+    } while (value);
+
+    return fwrite(bytes, length, 1, file) == 1;
+}
+
+
+/********************************************************************************************************************************
+ * read_varint():       Purpose: Reads a LEB128 varint written by write_varint() from memory, advancing past it; returns false  *
+ *                                 if it runs past the end or is too long for a uint64_t                                        *
+ *                      Parameters: - const char **cursor --> pointer to the pointer to the varint's first byte                 *
+ *                                  - const char *end --> pointer just past the last readable byte                              *
+ *                                  - uint64_t *value --> pointer to the variable in which to store the integer                 *
+ *                      Return value: bool                                                                                      *
+ *                      Side effects: - alters the variables pointed to by "const char **cursor" and "uint64_t *value"          *
+ ********************************************************************************************************************************/
+bool read_varint(const char **cursor, const char *end, uint64_t *value)
+{
+    unsigned char byte;
+
+    *value = 0;
+    for (int shift = 0; shift < MAX_VARINT_BYTES * 7 && *cursor < end; shift += 7)
+    {
+        byte = (unsigned char) *(*cursor)++;
+        *value |= (uint64_t) (byte & 0x7F) << shift;
+        if (!(byte & 0x80))
+            return true;
+    }
+
+    return false;
+}
+
+
+/*********************************************************************************************************************************
+ * start_recording():   Purpose: Opens a session log and writes its header: LOG_MAGIC and LOG_VERSION, then as varints the       *
+ *                                 scramble seed, the difficulty plus one (0 for a uniformly random scramble), the puzzle's      *
+ *                                 number in its pack (0 if not from a pack), and the length and characters of the puzzle's      *
+ *                                 filename (empty for the default puzzle). From then on, every move, undo, and redo made on     *
+ *                                 the state is logged by record_event(). Returns false if the log can't be written.             *
+ *                      Parameters: - Sp_State *state --> pointer to the state, freshly scrambled                                *
+ *                                  - const char *log_name --> the name of the log to write                                      *
+ *                                  - const char *puzzle_name --> the name of the puzzle file or pack (or NULL for the default)  *
+ *                                  - long pack_puzzle --> which puzzle of a pack is played, counting from 1 (0 if not a pack)   *
+ *                                  - uint64_t seed --> the seed the state was scrambled with                                    *
+ *                                  - int difficulty --> the difficulty the state was scrambled to (or -1)                       *
+ *                      Return value: bool                                                                                       *
+ *                      Side effects: - alters the variable pointed to by "Sp_State *state"                                      *
+ *                                    - writes external files                                                                    *
+ *********************************************************************************************************************************/
+bool start_recording(Sp_State *state, const char *log_name, const char *puzzle_name, long pack_puzzle, uint64_t seed,
+                     int difficulty)
+{
+    FILE *log = fopen(log_name, "wb");
+    size_t name_length = puzzle_name == NULL ? 0 : strlen(puzzle_name);
+    bool written;
+
+    if (log == NULL)
+        return false;
+    written = fwrite(LOG_MAGIC, LOG_MAGIC_LENGTH, 1, log) == 1 && fputc(LOG_VERSION, log) != EOF
+              && write_varint(log, seed) && write_varint(log, (uint64_t) (difficulty + 1))
+              && write_varint(log, (uint64_t) pack_puzzle) && write_varint(log, name_length)
+              && (name_length == 0 || fwrite(puzzle_name, name_length, 1, log) == 1) && fflush(log) == 0;
+    if (!written)
+    {
+        (void) fclose(log);
+        return false;
+    }
+
+    state->log = log;
+    (void) clock_gettime(CLOCK_MONOTONIC, &state->log_time);
+
+    return true;
+}
+
+
+/******************************************************************************************************************************
+ * record_event():      Purpose: Appends an event to the state's session log as a single varint: the milliseconds since the   *
+ *                                 last event (or the start of recording), shifted up past the event's code. With seven bits  *
+ *                                 to a byte, an event takes two bytes within 64 ms of the last and three within 8 seconds,   *
+ *                                 as most moves are. The log is flushed at once, so that it is complete however the program  *
+ *                                 ends; if it can't be written, recording simply stops.                                      *
+ *                      Parameters: - Sp_State *state --> pointer to the state being recorded                                 *
+ *                                  - uint8_t code --> a move code, LOG_UNDO, or LOG_REDO                                     *
+ *                      Return value: none                                                                                    *
+ *                      Side effects: - alters the variable pointed to by "Sp_State *state"                                   *
+ *                                    - writes external files                                                                 *
+ ******************************************************************************************************************************/
+void record_event(Sp_State *state, uint8_t code)
+{
+    struct timespec now;
+    uint64_t elapsed;
+
+    (void) clock_gettime(CLOCK_MONOTONIC, &now);
+    elapsed = (uint64_t) (now.tv_sec - state->log_time.tv_sec) * 1000
+              + (uint64_t) (now.tv_nsec / 1000000) - (uint64_t) (state->log_time.tv_nsec / 1000000);
+    state->log_time = now;
+    if (!write_varint(state->log, elapsed << LOG_CODE_BITS | code) || fflush(state->log))
+    {
+        (void) fclose(state->log);
+        state->log = NULL;
+    }
+}
+
+
+/**********************************************************************************************************************
+ * elapsed_seconds():   Purpose: Works out the time between two readings of the clock, as the batch modes report it.  *
+ *                      Parameters: - const struct timespec *started --> pointer to the earlier reading               *
+ *                                  - const struct timespec *finished --> pointer to the later reading                *
+ *                      Return value: double                                                                          *
+ *                      Side effects: none                                                                            *
+ **********************************************************************************************************************/
+double elapsed_seconds(const struct timespec *started, const struct timespec *finished)
+{
+    return (double) (finished->tv_sec - started->tv_sec) + (double) (finished->tv_nsec - started->tv_nsec) / 1e9;
+}
+
+
+/*********************************************************************************************************************************
+ * run_replay():        Purpose: Replays a session log, made with "--record", from the same scramble: headlessly at full speed,  *
+ *                                 or drawing each event at a multiple of the speed it was played at. The log's puzzle file      *
+ *                                 is used unless another is given. Prints one key=value line: whether the replay ends           *
+ *                                 solved, the events, moves, undos, and redos replayed, how many events could not be            *
+ *                                 replayed (which means the puzzle or program differs from the recording), the time the         *
+ *                                 session took, and the rate of the replay.                                                     *
+ *                      Parameters: - const char *log_name --> the name of the session log                                       *
+ *                                  - const char *puzzle_name --> the puzzle file or pack to use (or NULL for the log's own)     *
+ *                                  - long pack_puzzle --> which puzzle of a pack to use, counting from 1 (used only with        *
+ *                                      "puzzle_name")                                                                           *
+ *                                  - double speed --> the playback speed, as a multiple of real time (0 for headless)           *
+ *                      Return value: none                                                                                       *
+ *                      Side effects: - prints to stdout                                                                         *
+ *                                    - terminates program                                                                       *
+ *                                    - reads external files                                                                     *
+ *********************************************************************************************************************************/
+void run_replay(const char *log_name, const char *puzzle_name, long pack_puzzle, double speed)
+{
+    Mapped_File log;
+    const char *cursor;
+    const char *end;
+    uint64_t seed, difficulty, logged_pack_puzzle, name_length, event;
+    char logged_name[MAX_LINE + 1];
+    Sp_State *state;
+    static Frame frame; // What the terminal shows, when replaying on screen.
+    Viewport view;
+    struct timespec delay, started, finished;
+    double pause_ms;
+    uint8_t move;
+    bool replayed;
+    long events = 0, moves = 0, undos = 0, redos = 0, diverged = 0;
+    uint64_t session_ms = 0;
+    double seconds;
+
+    // Header:
+    if (!map_file(log_name, &log))
+    {
+        (void) printf("Error 29: Session log %s could not be opened.\n", log_name);
+        exit(29);
+    }
+    cursor = log.data + LOG_MAGIC_LENGTH + 1;
+    end = log.data + log.size;
+    if (log.size < LOG_MAGIC_LENGTH + 1 || memcmp(log.data, LOG_MAGIC, LOG_MAGIC_LENGTH) != 0
+        || log.data[LOG_MAGIC_LENGTH] != LOG_VERSION || !read_varint(&cursor, end, &seed)
+        || !read_varint(&cursor, end, &difficulty) || difficulty > MAX_DIFFICULTY + 1
+        || !read_varint(&cursor, end, &logged_pack_puzzle) || !read_varint(&cursor, end, &name_length)
+        || name_length > MAX_LINE || name_length > (uint64_t) (end - cursor))
+    {
+        (void) printf("Error 29: %s is not a session log, or is damaged or from another version of this program.\n", log_name);
+        exit(29);
+    }
+    (void) memcpy(logged_name, cursor, name_length);
+    logged_name[name_length] = '\0';
+    cursor += name_length;
+    if (puzzle_name == NULL)
+    {
+        puzzle_name = name_length ? logged_name : NULL;
+        pack_puzzle = logged_pack_puzzle ? (long) logged_pack_puzzle : 1;
+    }
+
+    // The same puzzle and scramble as the recording:
+    state = sp_create(puzzle_name, pack_puzzle);
+    if (state == NULL)
+    {
+        (void) printf("Error 26: Puzzle %s could not be loaded (missing, misformatted, or no such puzzle in the pack).\n",
+                      puzzle_name == NULL ? "(default)" : puzzle_name);
+        exit(26);
+    }
+    if (!sp_scramble(state, seed, (int) difficulty - 1))
+    {
+        (void) printf("Error 27: Not enough memory to play.\n");
+        exit(27);
+    }
+    if (speed > 0)
+    {
+        frame.valid = false;
+        frame.synchronized = isatty(STDOUT_FILENO);
+        view = full_view(state->atlas.grid);
+        update_viewport(&view, state->atlas.grid, state->atlas.size, state->board.gap);
+        update_display(&state->atlas, &state->board, state->final_piece_text, state->final_piece, &view, &state->display);
+        draw_display(&frame, &state->display);
+    }
+
+    // Events, until the end of the log:
+    (void) clock_gettime(CLOCK_MONOTONIC, &started);
+    while (cursor < end)
+    {
+        if (!read_varint(&cursor, end, &event))
+        {
+            (void) printf("Error 29: Session log %s is cut off partway through an event.\n", log_name);
+            exit(29);
+        }
+        events++;
+        session_ms += event >> LOG_CODE_BITS;
+        if (speed > 0)
+        {
+            pause_ms = (double) (event >> LOG_CODE_BITS) / speed;
+            if (pause_ms > MAX_REPLAY_PAUSE_MS)
+                pause_ms = MAX_REPLAY_PAUSE_MS;
+            delay.tv_sec = (time_t) (pause_ms / 1000);
+            delay.tv_nsec = (long) ((pause_ms - (double) delay.tv_sec * 1000) * 1000000);
+            (void) nanosleep(&delay, NULL);
+        }
+
+        move = (uint8_t) (event & LOG_CODE_MASK);
+        if (move == LOG_UNDO)
+            replayed = sp_undo(state);
+        else if (move == LOG_REDO)
+            replayed = sp_redo(state);
+        else
+            replayed = sp_apply_moves(state, &move, 1) == 1;
+        if (!replayed)
+            diverged++; // The recording was made with a different puzzle or scramble.
+        else if (move == LOG_UNDO)
+            undos++;
+        else if (move == LOG_REDO)
+            redos++;
+        else
+            moves++;
+
+        if (speed > 0)
+        {
+            update_viewport(&view, state->atlas.grid, state->atlas.size, state->board.gap);
+            update_display(&state->atlas, &state->board, state->final_piece_text, state->final_piece, &view, &state->display);
+            draw_display(&frame, &state->display);
+        }
+    }
+    (void) clock_gettime(CLOCK_MONOTONIC, &finished);
+    seconds = elapsed_seconds(&started, &finished);
+
+    (void) printf("result=%s events=%ld moves=%ld undos=%ld redos=%ld diverged=%ld session_seconds=%.3f"
+                  " replay_seconds=%.6f events_per_second=%.0f seed=%llu\n",
+                  sp_is_solved(state) ? "solved" : "unsolved", events, moves, undos, redos, diverged, (double) session_ms / 1000,
+                  seconds, seconds > 0 ? (double) events / seconds : 0, (unsigned long long) seed);
+    sp_destroy(state);
+    (void) unmap_file(&log);
+}
+
+
+/*********************************************************************************************************************************
+ * verify_batch():      Purpose: Confirms that each of a batch of submitted solutions really solves its board. Each line of the  *
+ *                                 input is a submission:                                                                        *
+ *                                      <puzzle> <pack puzzle> <seed> <difficulty> <moves>                                       *
+ *                                 where the puzzle is a puzzle file or pack ("-" for the default puzzle), the pack puzzle       *
+ *                                 counts from 1 (and is ignored for a plain file), the seed and difficulty (-1 for a            *
+ *                                 uniformly random scramble) are as given to the game, and the moves are in the short form      *
+ *                                 of command_to_moves(), such as "wwasd 2h". Blank lines and lines starting with '#' are        *
+ *                                 skipped. Each distinct puzzle is loaded once and each distinct board scrambled once (a        *
+ *                                 scramble to a difficulty solves candidate boards, so it costs far more than checking a        *
+ *                                 submission). Both passes are shared out among one thread per core, threads that finish        *
+ *                                 their share stealing from the others'. Results are printed in input order, one key=value      *
+ *                                 line each, followed by a summary.                                                             *
+ *                      Parameters: - const char *submissions_name --> the name of the file of submissions ("-" for stdin)       *
+ *                      Return value: none                                                                                       *
+ *                      Side effects: - prints to stdout                                                                         *
+ *                                    - terminates program                                                                       *
+ *                                    - reads external files (which may be stdin)                                                *
+ *********************************************************************************************************************************/
+void verify_batch(const char *submissions_name)
+{
+    FILE *input = strcmp(submissions_name, "-") == 0 ? stdin : fopen(submissions_name, "rb");
+    char *text;
+    size_t size;
+    char *line, *next_line;
+    long line_count = 0, count = 0, scramble_count = 0, passed = 0;
+    Submission *submissions;
+    Scramble *scrambles;
+    long *buckets; // Open-addressed hash table of the distinct boards (0 for empty, otherwise scramble index + 1).
+    size_t bucket_mask = 1;
+    size_t bucket;
+    uint64_t hash;
+    Verify_Puzzle *puzzles = NULL;
+    int puzzle_count = 0;
+    static Batch_Job job;
+    Batch_Worker workers[MAX_BATCH_THREADS];
+    const Distance_Table *table = NULL;
+    Mapped_File table_file;
+    char name[MAX_LINE + 1];
+    long pack_puzzle;
+    unsigned long long seed;
+    int difficulty;
+    int moves_at;
+    Submission *submission;
+    Scramble *scramble;
+    int p;
+    size_t longest = 0;
+    struct timespec started, finished;
+    double seconds;
+    const char *reasons[] = {"pending", "pass", "illegal", "unsolved", "unreadable", "no_puzzle"}; // Indexed by result
+
+    if (input == NULL || (text = read_all(input, &size)) == NULL)
+    {
+        (void) printf("Error 30: Submissions %s could not be read.\n", submissions_name);
+        exit(30);
+    }
+    if (input != stdin)
+        (void) fclose(input);
+    (void) clock_gettime(CLOCK_MONOTONIC, &started);
+
+    for (size_t i = 0; i < size; i++)
+        line_count += text[i] == '\n';
+    while (bucket_mask < (size_t) (line_count + 1) * 2)
+        bucket_mask <<= 1;
+    submissions = malloc((size_t) (line_count + 1) * sizeof(Submission));
+    scrambles = malloc((size_t) (line_count + 1) * sizeof(Scramble));
+    buckets = calloc(bucket_mask--, sizeof(long));
+    if (submissions == NULL || scrambles == NULL || buckets == NULL)
+    {
+        (void) printf("Error 31: Not enough memory to verify %ld submissions.\n", line_count + 1);
+        exit(31);
+    }
+
+    // Read each submission's fields, leaving its moves for the threads to parse:
+    line_count = 0;
+    for (line = text; line != NULL; line = next_line)
+    {
+        next_line = strchr(line, '\n');
+        if (next_line != NULL)
+            *next_line++ = '\0';
+        line_count++;
+        if (strchr(line, '\r') != NULL)
+            *strchr(line, '\r') = '\0'; // Submissions written on Windows work too.
+        if (line[0] == '\0' || line[0] == '#')
+            continue;
+
+        submission = &submissions[count++];
+        submission->line = line_count;
+        submission->scramble = -1;
+        submission->move_count = 0;
+        if (sscanf(line, "%1000s %ld %llu %d %n", name, &pack_puzzle, &seed, &difficulty, &moves_at) < 4
+            || difficulty < -1 || difficulty > MAX_DIFFICULTY)
+        {
+            submission->result = VERIFY_UNREADABLE;
+            continue;
+        }
+        submission->moves = line + moves_at;
+        if (strlen(submission->moves) > longest)
+            longest = strlen(submission->moves);
+
+        // Find the puzzle among those loaded so far, loading it if it is new:
+        for (p = 0; p < puzzle_count; p++)
+            if (strcmp(puzzles[p].name, name) == 0 && puzzles[p].pack_puzzle == pack_puzzle)
+                break;
+        if (p == puzzle_count)
+        {
+            puzzles = realloc(puzzles, (size_t) (puzzle_count + 1) * sizeof(Verify_Puzzle));
+            if (puzzles == NULL)
+            {
+                (void) printf("Error 31: Not enough memory to verify %ld submissions.\n", line_count);
+                exit(31);
+            }
+            (void) strcpy(puzzles[p].name, name);
+            puzzles[p].pack_puzzle = pack_puzzle;
+            puzzles[p].state = sp_create(strcmp(name, "-") == 0 ? NULL : name, pack_puzzle);
+            puzzle_count++;
+        }
+        if (puzzles[p].state == NULL)
+        {
+            submission->result = VERIFY_NO_PUZZLE;
+            continue;
+        }
+        submission->result = VERIFY_PENDING;
+
+        // Find the board among those to be scrambled, adding it if it is new:
+        hash = (seed ^ (uint64_t) p << 40 ^ (uint64_t) (difficulty + 1) << 56) * PCG_MULTIPLIER;
+        for (bucket = (size_t) (hash >> 32) & bucket_mask; buckets[bucket] != 0; bucket = (bucket + 1) & bucket_mask)
+        {
+            scramble = &scrambles[buckets[bucket] - 1];
+            if (scramble->seed == seed && scramble->puzzle == p && scramble->difficulty == difficulty)
+                break;
+        }
+        if (buckets[bucket] == 0)
+        {
+            scrambles[scramble_count] = (Scramble) {.puzzle = p, .seed = seed, .difficulty = difficulty};
+            buckets[bucket] = ++scramble_count;
+        }
+        submission->scramble = buckets[bucket] - 1;
+
+        if (difficulty >= 0 && table == NULL)
+        {
+            // Every thread shares one distance table, opened once here rather than by each scramble:
+            table = open_distance_table(&table_file);
+            if (table == NULL)
+            {
+                (void) printf("Error 31: Not enough memory to verify %ld submissions.\n", line_count);
+                exit(31);
+            }
+        }
+    }
+    for (p = 0; p < puzzle_count; p++)
+        if (puzzles[p].state != NULL)
+            puzzles[p].state->table = table;
+
+    // Give each thread its own scratch state and move buffer, then scramble every distinct board and verify every submission:
+    job.submissions = submissions;
+    job.scrambles = scrambles;
+    job.puzzles = puzzles;
+    job.max_threads = batch_thread_count();
+    job.capacity = (int) longest + 1;
+    for (int t = 0; t < job.max_threads; t++)
+    {
+        (void) pthread_mutex_init(&job.queues[t].lock, NULL);
+        job.scratch[t] = aligned_alloc(_Alignof(Sp_State), sizeof(Sp_State));
+        job.current[t] = -1;
+        job.moves[t] = malloc((size_t) job.capacity);
+        if (job.scratch[t] == NULL || job.moves[t] == NULL)
+        {
+            (void) printf("Error 31: Not enough memory to verify %ld submissions.\n", count);
+            exit(31);
+        }
+        workers[t] = (Batch_Worker) {.job = &job, .index = t};
+    }
+    run_batch_pass(&job, workers, BATCH_SCRAMBLE, scramble_count);
+    run_batch_pass(&job, workers, BATCH_VERIFY, count);
+    (void) clock_gettime(CLOCK_MONOTONIC, &finished);
+    seconds = elapsed_seconds(&started, &finished);
+
+    for (long i = 0; i < count; i++)
+    {
+        submission = &submissions[i];
+        passed += submission->result == VERIFY_PASS;
+        if (submission->result == VERIFY_ILLEGAL)
+            (void) printf("line=%ld result=fail reason=illegal move=%ld\n", submission->line, submission->move_count);
+        else if (submission->result == VERIFY_PASS)
+            (void) printf("line=%ld result=pass moves=%ld\n", submission->line, submission->move_count);
+        else
+            (void) printf("line=%ld result=fail reason=%s moves=%ld\n", submission->line, reasons[submission->result],
+                          submission->move_count);
+    }
+    (void) printf("submissions=%ld passed=%ld failed=%ld boards=%ld threads=%d seconds=%.6f per_second=%.0f\n", count, passed,
+                  count - passed, scramble_count, job.max_threads, seconds, seconds > 0 ? (double) count / seconds : 0);
+
+    for (int t = 0; t < job.max_threads; t++)
+    {
+        (void) pthread_mutex_destroy(&job.queues[t].lock);
+        free(job.scratch[t]);
+        free(job.moves[t]);
+    }
+    for (p = 0; p < puzzle_count; p++)
+        if (puzzles[p].state != NULL)
+        {
+            puzzles[p].state->table = NULL; // Shared, so freed just once below.
+            sp_destroy(puzzles[p].state);
+        }
+    if (table != NULL)
+        close_distance_table(table, &table_file);
+    free(puzzles);
+    free(buckets);
+    free(scrambles);
+    free(submissions);
+    free(text);
+}
+
+
+/******************************************************************************************************************************
+ * read_all():          Purpose: Reads a whole file (which may be stdin) into a null-terminated buffer, returning NULL if it  *
+ *                                 can't be read or there isn't enough memory                                                 *
+ *                      Parameters: - FILE *file --> the file to read                                                         *
+ *                                  - size_t *size --> pointer to the variable in which to store the number of bytes read     *
+ *                      Return value: char * --> the buffer (to be freed by the caller)                                       *
+ *                      Side effects: - alters the variable pointed to by "size_t *size"                                      *
+ *                                    - allocates memory                                                                      *
+ *                                    - reads external files (which may be stdin)                                             *
+ ******************************************************************************************************************************/
+char *read_all(FILE *file, size_t *size)
+{
+    size_t capacity = 1 << 16;
+    char *buffer = malloc(capacity);
+    char *larger;
+
+    *size = 0;
+    while (buffer != NULL)
+    {
+        *size += fread(buffer + *size, 1, capacity - *size - 1, file);
+        if (*size < capacity - 1)
+            break;
+        larger = realloc(buffer, capacity *= 2);
+        if (larger == NULL)
+            free(buffer);
+        buffer = larger;
+    }
+    if (buffer == NULL || ferror(file))
+    {
+        free(buffer);
+        return NULL;
+    }
+    buffer[*size] = '\0';
+
+    return buffer;
+}
+
+
+/***************************************************************************************************************************
+ * batch_thread_count(): Purpose: Returns how many threads the batch modes run on: one for each core online, from 1 up to  *
+ *                                   MAX_BATCH_THREADS                                                                     *
+ *                       Parameters: none                                                                                  *
+ *                       Return value: int                                                                                 *
+ *                       Side effects: none                                                                                *
+ ***************************************************************************************************************************/
+int batch_thread_count(void)
+{
+    long thread_count = sysconf(_SC_NPROCESSORS_ONLN);
+
+    if (thread_count < 1)
+        thread_count = 1;
+    if (thread_count > MAX_BATCH_THREADS)
+        thread_count = MAX_BATCH_THREADS;
+
+    return (int) thread_count;
+}
+
+
+/*******************************************************************************************************************************
+ * run_batch_pass():    Purpose: Shares a pass's items (boards to scramble or solve, submissions to verify, words of a bitset  *
+ *                                 or blocks of placements to expand) out evenly among the threads, no more threads than       *
+ *                                 there are chunks of work, and waits until every item is done                                *
+ *                      Parameters: - Batch_Job *job --> pointer to the job                                                    *
+ *                                  - Batch_Worker workers[] --> each thread's Batch_Worker                                    *
+ *                                  - int pass --> BATCH_SCRAMBLE to scramble the job's boards, BATCH_VERIFY to verify         *
+ *                                      its submissions, BATCH_SOLVE to solve its tasks, BATCH_EXPAND to expand the            *
+ *                                      words of its frontier, or BATCH_PATTERN to expand the blocks of its layer              *
+ *                                  - long count --> the number of items                                                       *
+ *                      Return value: none                                                                                     *
+ *                      Side effects: - alters the variable pointed to by "Batch_Job *job"                                     *
+ *******************************************************************************************************************************/
+void run_batch_pass(Batch_Job *job, Batch_Worker workers[], int pass, long count)
+{
+    pthread_t threads[MAX_BATCH_THREADS];
+    int started;
+
+    job->pass = pass;
+    job->thread_count = job->max_threads;
+    if (job->thread_count > (count + BATCH_CHUNK - 1) / BATCH_CHUNK)
+        job->thread_count = (int) ((count + BATCH_CHUNK - 1) / BATCH_CHUNK);
+    if (job->thread_count < 1)
+        job->thread_count = 1;
+    for (int t = 0; t < job->thread_count; t++)
+    {
+        job->queues[t].next = count * t / job->thread_count;
+        job->queues[t].end = count * (t + 1) / job->thread_count;
+    }
+
+    // This thread works too; any thread that can't be started just leaves its share to be stolen:
+    for (started = 1; started < job->thread_count; started++)
+        if (pthread_create(&threads[started], NULL, batch_items, &workers[started]))
+            break;
+    (void) batch_items(&workers[0]);
+    for (int t = 1; t < started; t++)
+        (void) pthread_join(threads[t], NULL);
+}
+
+
+/*****************************************************************************************************************************
+ * batch_items():       Purpose: Thread body for run_batch_pass(): takes items from the front of its own queue, BATCH_CHUNK  *
+ *                                 at a time, then steals from the back of the others' until none are left                   *
+ *                      Parameters: - void *worker --> pointer to the thread's Batch_Worker                                  *
+ *                      Return value: void * --> always NULL                                                                 *
+ *                      Side effects: - alters the job's queues, scratch states, arenas, bitsets, and items                  *
+ *****************************************************************************************************************************/
+void *batch_items(void *worker)
+{
+    Batch_Job *job = ((Batch_Worker *) worker)->job;
+    int thread = ((Batch_Worker *) worker)->index;
+    Batch_Queue *queue = &job->queues[thread];
+    long first, last;
+
+    for (;;)
+    {
+        (void) pthread_mutex_lock(&queue->lock);
+        first = queue->next;
+        last = queue->end - first > BATCH_CHUNK ? first + BATCH_CHUNK : queue->end;
+        queue->next = last;
+        (void) pthread_mutex_unlock(&queue->lock);
+        if (first == last && !steal_items(job, thread))
+            return NULL;
+        for (long i = first; i < last; i++)
+            if (job->pass == BATCH_SCRAMBLE)
+                scramble_board(job, thread, &job->scrambles[i]);
+            else if (job->pass == BATCH_VERIFY)
+                verify_submission(job, thread, &job->submissions[i]);
+            else if (job->pass == BATCH_SOLVE)
+                solve_task(job, thread, &job->tasks[i]);
+            else if (job->pass == BATCH_EXPAND)
+                expand_word(job, thread, i);
+            else
+                expand_placements(job, thread, i);
+    }
+}
+
+
+/******************************************************************************************************************************
+ * steal_items():       Purpose: Moves the back half of another thread's remaining items into an idle thread's queue, trying  *
+ *                                 each thread in turn after the thief; returns false if every queue is empty                 *
+ *                      Parameters: - Batch_Job *job --> pointer to the job                                                   *
+ *                                  - int thief --> the idle thread, whose queue is empty                                     *
+ *                      Return value: bool                                                                                    *
+ *                      Side effects: - alters the queues of the job                                                          *
+ ******************************************************************************************************************************/
+bool steal_items(Batch_Job *job, int thief)
+{
+    Batch_Queue *victim;
+    long taken, end;
+
+    for (int t = 1; t < job->thread_count; t++)
+    {
+        victim = &job->queues[(thief + t) % job->thread_count];
+        (void) pthread_mutex_lock(&victim->lock);
+        taken = (victim->end - victim->next + 1) / 2;
+        end = victim->end;
+        victim->end -= taken;
+        (void) pthread_mutex_unlock(&victim->lock);
+        if (taken > 0)
+        {
+            (void) pthread_mutex_lock(&job->queues[thief].lock);
+            job->queues[thief].next = end - taken;
+            job->queues[thief].end = end;
+            (void) pthread_mutex_unlock(&job->queues[thief].lock);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+/*****************************************************************************************************************************
+ * scratch_state():     Purpose: Returns a thread's scratch state, holding a copy of the given puzzle (copied only when the  *
+ *                                 thread moves on to a different puzzle)                                                    *
+ *                      Parameters: - Batch_Job *job --> pointer to the job                                                  *
+ *                                  - int thread --> the thread                                                              *
+ *                                  - int puzzle --> index of the puzzle among those loaded                                  *
+ *                      Return value: Sp_State                                                                               *
+ *                      Side effects: - alters the thread's scratch state                                                    *
+ *****************************************************************************************************************************/
+Sp_State *scratch_state(Batch_Job *job, int thread, int puzzle)
+{
+    if (job->current[thread] != puzzle)
+    {
+        *job->scratch[thread] = *job->puzzles[puzzle].state; // Shares the atlas art and distance table, both read-only.
+        job->current[thread] = puzzle;
+    }
+
+    return job->scratch[thread];
+}
+
+
+/********************************************************************************************************************************
+ * scramble_board():    Purpose: Works out the board the game scrambles a puzzle to for a seed and difficulty                   *
+ *                      Parameters: - Batch_Job *job --> pointer to the job                                                     *
+ *                                  - int thread --> the thread, whose scratch state is used                                    *
+ *                                  - Scramble *scramble --> pointer to the puzzle, seed, and difficulty                        *
+ *                      Return value: none                                                                                      *
+ *                      Side effects: - alters the variable pointed to by "Scramble *scramble", and the thread's scratch state  *
+ ********************************************************************************************************************************/
+void scramble_board(Batch_Job *job, int thread, Scramble *scramble)
+{
+    Sp_State *state = scratch_state(job, thread, scramble->puzzle);
+
+    (void) sp_scramble(state, scramble->seed, scramble->difficulty); // The table is already built, so this can't fail.
+    scramble->board = state->board;
+}
+
+
+/********************************************************************************************************************************
+ * verify_submission(): Purpose: Makes a submission's moves from its scrambled board, and records whether they can all be made  *
+ *                                 and leave the puzzle solved                                                                  *
+ *                      Parameters: - Batch_Job *job --> pointer to the job                                                     *
+ *                                  - int thread --> the thread, whose scratch state and move buffer are used                   *
+ *                                  - Submission *submission --> pointer to the submission                                      *
+ *                      Return value: none                                                                                      *
+ *                      Side effects: - alters the variable pointed to by "Submission *submission", and the thread's scratch    *
+ *                                      state and move buffer                                                                   *
+ ********************************************************************************************************************************/
+void verify_submission(Batch_Job *job, int thread, Submission *submission)
+{
+    const Scramble *scramble;
+    Sp_State *state;
+    uint8_t *moves = job->moves[thread];
+    int count;
+
+    if (submission->result != VERIFY_PENDING)
+        return; // Unreadable, or its puzzle couldn't be loaded.
+    scramble = &job->scrambles[submission->scramble];
+    state = scratch_state(job, thread, scramble->puzzle);
+    state->board = scramble->board;
+    state->correct = count_correct(&state->atlas, &state->board);
+
+    count = command_to_moves(submission->moves, moves, job->capacity);
+    if (count < 0)
+    {
+        submission->result = VERIFY_UNREADABLE;
+        return;
+    }
+    for (int i = 0; i < count; i++)
+        if (!apply_move(state, moves[i])) // Not sp_apply_moves(), as verifying has no use for the undo history.
+        {
+            submission->result = VERIFY_ILLEGAL;
+            submission->move_count = i + 1;
+            return;
+        }
+    submission->move_count = count;
+    submission->result = sp_is_solved(state) ? VERIFY_PASS : VERIFY_UNSOLVED;
+}
+
+
+/*******************************************************************************************************************************
+ * solve_batch():       Purpose: Finds a shortest solution for each of a batch of boards, solving on every core. Each line of  *
+ *                                 the input is a board:                                                                       *
+ *                                      <tiles> [<orientations>]                                                               *
+ *                                 where the tiles are the tile at each position (left to right, top to bottom; tile t         *
+ *                                 belongs in position t, and the last tile is the gap), a digit each on boards of up to ten   *
+ *                                 positions and separated by commas on larger ones, and the orientations are a digit for      *
+ *                                 each position, the orientation of the tile there (0 upright, 1 mirrored as by "h", 2 as by  *
+ *                                 "v", 3 rotated as by "r"; 0 for the gap), all upright if left out. So on a 3x3 puzzle       *
+ *                                 "012345678" is solved and "012345687 000000000" needs "a", and on a 4x4 puzzle              *
+ *                                 "0,1,2,3,4,5,6,7,8,9,10,11,12,13,15,14" needs "a". Blank lines and lines starting with '#'  *
+ *                                 are skipped. Which flips a board needs depends on the puzzle's art (a blank tile looks      *
+ *                                 right every way up), so the puzzle is loaded as for "--script". Results are printed in      *
+ *                                 input order, one key=value line each: the length of a shortest solution (-1 if there is     *
+ *                                 none) and its moves in the short form of command_to_moves(), or "length=-1 reason=gave_up"  *
+ *                                 if the search gave up on a board that can be solved (see SOLVER_NODE_LIMIT), followed by a  *
+ *                                 summary counting each kind of result.                                                       *
+ *                      Parameters: - const char *boards_name --> the name of the file of boards ("-" for stdin)               *
+ *                                  - const char *puzzle_name --> the puzzle file or pack (or NULL for the default puzzle)     *
+ *                                  - long pack_puzzle --> which puzzle of a pack to use, counting from 1                      *
+ *                      Return value: none                                                                                     *
+ *                      Side effects: - prints to stdout                                                                       *
+ *                                    - terminates program                                                                     *
+ *                                    - reads external files (which may be stdin)                                              *
+ *******************************************************************************************************************************/
+void solve_batch(const char *boards_name, const char *puzzle_name, long pack_puzzle)
+{
+    FILE *input = strcmp(boards_name, "-") == 0 ? stdin : fopen(boards_name, "rb");
+    char *text;
+    size_t size;
+    char *line, *next_line;
+    long line_count = 0, count = 0, solved = 0, unsolvable = 0, gave_up = 0;
+    Solve_Task *tasks;
+    Solve_Task *task;
+    Sp_State *state;
+    static Batch_Job job;
+    Batch_Worker workers[MAX_BATCH_THREADS];
+    struct timespec started, finished;
+    double seconds;
+
+    if (input == NULL || (text = read_all(input, &size)) == NULL)
+    {
+        (void) printf("Error 30: Boards %s could not be read.\n", boards_name);
+        exit(30);
+    }
+    if (input != stdin)
+        (void) fclose(input);
+    state = sp_create(puzzle_name, pack_puzzle);
+    if (state == NULL)
+    {
+        (void) printf("Error 26: Puzzle %s could not be loaded (missing, misformatted, or no such puzzle in the pack).\n",
+                      puzzle_name == NULL ? "(default)" : puzzle_name);
+        exit(26);
+    }
+    job.table = state_table(state); // Opened before the clock starts, like the puzzle.
+    (void) clock_gettime(CLOCK_MONOTONIC, &started);
+
+    for (size_t i = 0; i < size; i++)
+        line_count += text[i] == '\n';
+    tasks = malloc((size_t) (line_count + 1) * sizeof(Solve_Task));
+    if (tasks == NULL)
+    {
+        (void) printf("Error 31: Not enough memory to solve %ld boards.\n", line_count + 1);
+        exit(31);
+    }
+    line_count = 0;
+    for (line = text; line != NULL; line = next_line)
+    {
+        next_line = strchr(line, '\n');
+        if (next_line != NULL)
+            *next_line++ = '\0';
+        line_count++;
+        if (strchr(line, '\r') != NULL)
+            *strchr(line, '\r') = '\0'; // Boards written on Windows work too.
+        if (line[0] == '\0' || line[0] == '#')
+            continue;
+        task = &tasks[count++];
+        task->line = line_count;
+        task->readable = parse_board(line, state->atlas.grid, &task->board);
+    }
+
+    job.tasks = tasks;
+    job.atlas = &state->atlas;
+    job.max_threads = batch_thread_count();
+    for (int t = 0; t < job.max_threads; t++)
+    {
+        (void) pthread_mutex_init(&job.queues[t].lock, NULL);
+        job.arenas[t] = (Arena) {.data = NULL, .used = 0, .capacity = 0, .failed = false};
+        workers[t] = (Batch_Worker) {.job = &job, .index = t};
+    }
+    run_batch_pass(&job, workers, BATCH_SOLVE, count);
+    (void) clock_gettime(CLOCK_MONOTONIC, &finished);
+    seconds = elapsed_seconds(&started, &finished);
+    for (int t = 0; t < job.max_threads; t++)
+        if (job.arenas[t].failed)
+        {
+            (void) printf("Error 31: Not enough memory to solve %ld boards.\n", count);
+            exit(31);
+        }
+
+    // Each result is in the arena of whichever thread solved it:
+    for (long i = 0; i < count; i++)
+    {
+        task = &tasks[i];
+        (void) fwrite(job.arenas[task->thread].data + task->offset, 1, task->length, stdout);
+        solved += task->readable && task->distance >= 0;
+        unsolvable += task->readable && task->distance < 0 && !task->gave_up;
+        gave_up += task->gave_up;
+    }
+    (void) printf("boards=%ld solved=%ld unsolvable=%ld gave_up=%ld unreadable=%ld threads=%d seconds=%.6f per_second=%.0f\n",
+                  count, solved, unsolvable, gave_up, count - solved - unsolvable - gave_up, job.max_threads, seconds,
+                  seconds > 0 ? (double) count / seconds : 0);
+
+    for (int t = 0; t < job.max_threads; t++)
+    {
+        (void) pthread_mutex_destroy(&job.queues[t].lock);
+        free(job.arenas[t].data);
+    }
+    free(tasks);
+    free(text);
+    sp_destroy(state);
+}
+
+
+/****************************************************************************************************************************
+ * parse_board():       Purpose: Reads a board written as for solve_batch() (its tile numbers, then optionally a digit for  *
+ *                                 each position's orientation), returning false if it isn't one of the grid's boards       *
+ *                      Parameters: - const char *text --> the board as text (null-terminated)                              *
+ *                                  - const Grid *grid --> the size of the board                                            *
+ *                                  - Board *board --> pointer to the variable in which to store the board                  *
+ *                      Return value: bool                                                                                  *
+ *                      Side effects: - alters the variable pointed to by "Board *board"                                    *
+ ****************************************************************************************************************************/
+bool parse_board(const char *text, const Grid *grid, Board *board)
+{
+    bool commas = grid->cells > 10; // Tile numbers need two digits, so they are separated.
+    uint64_t seen = 0; // Bit t is set once tile t has been placed.
+    const char *c = text;
+    int tile;
+
+    while (*c == ' ' || *c == '\t')
+        c++;
+    *board = solved_board(grid);
+    for (int p = 0; p < grid->cells; p++)
+    {
+        if ((commas && p > 0 && *c++ != ',') || !isdigit((unsigned char) *c))
+            return false;
+        tile = *c++ - '0';
+        if (commas && isdigit((unsigned char) *c))
+            tile = tile * 10 + *c++ - '0';
+        if (tile >= grid->cells || seen >> tile & 1)
+            return false;
+        seen |= 1ULL << tile;
+        board->tiles[p] = (uint8_t) tile;
+        if (tile == grid->cells - 1)
+            board->gap = p;
+    }
+
+    while (*c == ' ' || *c == '\t')
+        c++;
+    if (*c != '\0')
+    {
+        for (int p = 0; p < grid->cells; p++, c++)
+        {
+            if (*c < '0' || *c >= '0' + NUM_ORIENTATIONS || (p == board->gap && *c != '0'))
+                return false;
+            board->orientations[board->tiles[p]] = (uint8_t) (*c - '0');
+        }
+        while (*c == ' ' || *c == '\t')
+            c++;
+    }
+
+    return *c == '\0';
+}
+
+
+/**********************************************************************************************************************
+ * solve_task():        Purpose: Solves a board for solve_batch() and writes its result line into the thread's arena  *
+ *                      Parameters: - Batch_Job *job --> pointer to the job                                           *
+ *                                  - int thread --> the solving thread, whose arena is written to                    *
+ *                                  - Solve_Task *task --> pointer to the board                                       *
+ *                      Return value: none                                                                            *
+ *                      Side effects: - alters the variable pointed to by "Solve_Task *task", and the thread's arena  *
+ **********************************************************************************************************************/
+void solve_task(Batch_Job *job, int thread, Solve_Task *task)
+{
+    Arena *arena = &job->arenas[thread];
+    char *out = arena_reserve(arena, SOLVE_RESULT_MAX);
+    Solution solution;
+    char command[8];
+    int length;
+
+    task->thread = thread;
+    task->offset = arena->used;
+    task->length = 0;
+    task->distance = -1;
+    task->gave_up = false;
+    if (out == NULL)
+        return; // The arena is marked as failed, and solve_batch() reports it.
+
+    if (!task->readable)
+        length = sprintf(out, "line=%ld error=unreadable\n", task->line);
+    else if (!solve_board(job->atlas, job->table, &task->board, &solution))
+    {
+        task->gave_up = board_solvable(job->atlas, &task->board);
+        length = sprintf(out, task->gave_up ? "line=%ld length=-1 reason=gave_up\n" : "line=%ld length=-1\n", task->line);
+    }
+    else
+    {
+        task->distance = solution.length;
+        length = sprintf(out, "line=%ld length=%d path=", task->line, solution.length);
+        for (int i = 0; i < solution.length; i++)
+        {
+            // The short form without its space ("3h" rather than "3 h"), which command_to_moves() reads back just the same:
+            (void) move_to_command(command, solution.moves[i]);
+            for (const char *c = command; *c != '\0'; c++)
+                if (*c != ' ')
+                    out[length++] = *c;
+        }
+        out[length++] = '\n';
+    }
+    task->length = (size_t) length;
+    arena->used += (size_t) length;
+}
+
+
+/*******************************************************************************************************************************
+ * arena_reserve():     Purpose: Makes room for at least "size" more bytes at the end of an arena, doubling it as often as     *
+ *                                 needed, and returns a pointer to them (valid until the next call); the caller adds what it  *
+ *                                 actually uses to the arena's "used". Returns NULL, marking the arena as failed, if there    *
+ *                                 isn't enough memory.                                                                        *
+ *                      Parameters: - Arena *arena --> pointer to the arena                                                    *
+ *                                  - size_t size --> the number of bytes needed                                               *
+ *                      Return value: char                                                                                     *
+ *                      Side effects: - alters the variable pointed to by "Arena *arena"                                       *
+ *                                    - allocates memory (freed by the arena's owner)                                          *
+ *******************************************************************************************************************************/
+char *arena_reserve(Arena *arena, size_t size)
+{
+    size_t capacity = arena->capacity ? arena->capacity : ARENA_INITIAL_CAPACITY;
+    char *larger;
+
+    while (capacity - arena->used < size)
+        capacity *= 2;
+    if (capacity != arena->capacity)
+    {
+        larger = realloc(arena->data, capacity);
+        if (larger == NULL)
+        {
+            arena->failed = true;
+            return NULL;
+        }
+        arena->data = larger;
+        arena->capacity = capacity;
+    }
+
+    return arena->data + arena->used;
+}
+
+
+/***********************************************************************************************************************************
+ * enumerate_states():  Purpose: Enumerates every arrangement sliding can reach by breadth-first search, one layer of distance at  *
+ *                                 a time, each layer kept as a bitset (a bit per board_rank() / 2) and expanded on every core,    *
+ *                                 and prints how many arrangements lie at each distance from solved, the farthest distance, and   *
+ *                                 how many antipodes (arrangements that far) there are. The same counts are given for the         *
+ *                                 whole graph of boards, orientations and all, as the rules stand: orientations ride along with   *
+ *                                 their tiles, and one flip puts any tile right whichever way up it is, so a board is exactly     *
+ *                                 as far as its arrangement plus one move per wrongly oriented tile (taking every tile's art to   *
+ *                                 be distinct, as table_distance() does). The layers are expanded with board_apply(), just as     *
+ *                                 parse_command() slides, and checked against build_distance_table()'s table, which is then       *
+ *                                 saved as TABLE_FILE_NAME for open_distance_table() to map rather than build.                    *
+ *                      Parameters: none                                                                                           *
+ *                      Return value: none                                                                                         *
+ *                      Side effects: - prints to stdout                                                                           *
+ *                                    - terminates program                                                                         *
+ *                                    - writes external files                                                                      *
+ ***********************************************************************************************************************************/
+void enumerate_states(void)
+{
+    static Batch_Job job;
+    Batch_Worker workers[MAX_BATCH_THREADS];
+    uint64_t *visited = calloc(BITSET_WORDS, sizeof(uint64_t));
+    uint64_t *frontier = calloc(BITSET_WORDS, sizeof(uint64_t));
+    Distance_Table *table = malloc(sizeof(Distance_Table));
+    uint64_t layers[MAX_DIFFICULTY + 1] = {0}; // Arrangements at each distance.
+    uint64_t boards[MAX_DIFFICULTY + 1] = {0}; // Boards, orientations and all, at each distance.
+    uint64_t ways = 1; // Ways of wrongly orienting the chosen tiles: 3 for each.
+    uint64_t choices = 1; // Ways of choosing which tiles are wrongly oriented: GAP_TILE choose "flips".
+    uint64_t fresh, found;
+    int distance = 0, farthest;
+    uint32_t index;
+    Board board;
+    char header[TABLE_HEADER_SIZE] = TABLE_MAGIC;
+    uint32_t byte_order = TABLE_BYTE_ORDER;
+    FILE *file;
+    bool written;
+    struct timespec started, finished;
+    double seconds;
+
+    job.max_threads = batch_thread_count();
+    for (int t = 0; t < job.max_threads; t++)
+    {
+        (void) pthread_mutex_init(&job.queues[t].lock, NULL);
+        job.reached[t] = calloc(BITSET_WORDS, sizeof(uint64_t));
+        if (job.reached[t] == NULL)
+            visited = NULL; // Reported just below, along with the others.
+        workers[t] = (Batch_Worker) {.job = &job, .index = t};
+    }
+    if (visited == NULL || frontier == NULL || table == NULL)
+    {
+        (void) printf("Error 31: Not enough memory to enumerate %d arrangements.\n", NUM_REACHABLE_STATES);
+        exit(31);
+    }
+    (void) clock_gettime(CLOCK_MONOTONIC, &started);
+
+    // Each layer is whatever the last one reaches in one slide that no earlier layer has:
+    board = solved_board(grid_of(DEFAULT_SIDE, DEFAULT_SIDE));
+    index = board_rank(&board) / 2;
+    frontier[index / 64] = visited[index / 64] = 1ULL << (index % 64);
+    job.frontier = frontier;
+    for (layers[0] = 1; layers[distance] > 0; layers[++distance] = found)
+    {
+        run_batch_pass(&job, workers, BATCH_EXPAND, BITSET_WORDS);
+        found = 0;
+        for (long w = 0; w < BITSET_WORDS; w++)
+        {
+            fresh = 0;
+            for (int t = 0; t < job.thread_count; t++)
+            {
+                fresh |= job.reached[t][w];
+                job.reached[t][w] = 0;
+            }
+            fresh &= ~visited[w];
+            visited[w] |= fresh;
+            frontier[w] = fresh;
+            for (; fresh != 0; fresh &= fresh - 1)
+                found++;
+        }
+    }
+    farthest = distance - 1;
+    (void) clock_gettime(CLOCK_MONOTONIC, &finished);
+    seconds = elapsed_seconds(&started, &finished);
+
+    // With "flips" tiles wrongly oriented, a board is "flips" moves farther than its arrangement:
+    for (int flips = 0; flips <= GAP_TILE; flips++)
+    {
+        for (int d = 0; d <= farthest; d++)
+            boards[d + flips] += layers[d] * choices * ways;
+        choices = choices * (uint64_t) (GAP_TILE - flips) / (uint64_t) (flips + 1);
+        ways *= NUM_ORIENTATIONS - 1;
+    }
+    for (int d = 0; d <= farthest + GAP_TILE; d++)
+        (void) printf("distance=%d arrangements=%llu boards=%llu\n", d, (unsigned long long) layers[d],
+                      (unsigned long long) boards[d]);
+    (void) printf("arrangements=%llu farthest=%d antipodes=%llu\n", (unsigned long long) (NUM_REACHABLE_STATES),
+                  farthest, (unsigned long long) layers[farthest]);
+    (void) printf("boards=%llu farthest=%d antipodes=%llu\n", (unsigned long long) NUM_REACHABLE_STATES << (2 * GAP_TILE),
+                  farthest + GAP_TILE, (unsigned long long) boards[farthest + GAP_TILE]);
+    (void) printf("threads=%d seconds=%.6f\n", job.max_threads, seconds);
+
+    // The saved table must be the one build_distance_table() makes, since scrambles are drawn from its by_distance order:
+    build_distance_table(table);
+    for (int d = 0; d <= MAX_SLIDE_DISTANCE; d++)
+        if (table->first[d + 1] - table->first[d] != (int) layers[d])
+        {
+            (void) printf("Error 33: The enumeration and the distance table disagree at distance %d.\n", d);
+            exit(33);
+        }
+
+    // Written under another name and renamed into place, so that programs already mapping the old table keep it intact:
+    write_le32(header + 8, TABLE_VERSION);
+    (void) memcpy(header + 12, &byte_order, sizeof(byte_order));
+    write_le32(header + 16, (uint32_t) sizeof(Distance_Table));
+    file = fopen(TABLE_FILE_NAME ".new", "wb");
+    written = file != NULL && fwrite(header, TABLE_HEADER_SIZE, 1, file) == 1
+              && fwrite(table, sizeof(Distance_Table), 1, file) == 1;
+    if (file == NULL || fclose(file) || !written || rename(TABLE_FILE_NAME ".new", TABLE_FILE_NAME))
+    {
+        (void) printf("Error 32: Distance table %s could not be written.\n", TABLE_FILE_NAME);
+        exit(32);
+    }
+    (void) printf("Wrote the distance table to %s.\n", TABLE_FILE_NAME);
+
+    for (int t = 0; t < job.max_threads; t++)
+    {
+        (void) pthread_mutex_destroy(&job.queues[t].lock);
+        free(job.reached[t]);
+    }
+    free(table);
+    free(frontier);
+    free(visited);
+}
+
+
+/******************************************************************************************************************************
+ * expand_word():       Purpose: Expands one word (64 arrangements) of a breadth-first layer for enumerate_states(), marking  *
+ *                                 every arrangement one slide from those in it in the thread's own "reached" bitset          *
+ *                      Parameters: - Batch_Job *job --> pointer to the job                                                   *
+ *                                  - int thread --> the expanding thread, whose bitset is marked                             *
+ *                                  - long word --> which word of the frontier to expand                                      *
+ *                      Return value: none                                                                                    *
+ *                      Side effects: - alters the thread's "reached" bitset                                                  *
+ ******************************************************************************************************************************/
+void expand_word(Batch_Job *job, int thread, long word)
+{
+    uint64_t *reached = job->reached[thread];
+    Board board, next;
+    uint32_t index;
+
+    for (int bit = 0; bit < 64 && job->frontier[word] >> bit != 0; bit++)
+    {
+        if (!(job->frontier[word] >> bit & 1))
+            continue;
+        board = reachable_board((uint32_t) (word * 64 + bit));
+        for (int direction = SLIDE_UP; direction <= SLIDE_RIGHT; direction++)
+        {
+            next = board;
+            if (!board_apply(&next, SLIDE_MOVE(direction)))
+                continue;
+            index = board_rank(&next) / 2;
+            reached[index / 64] |= 1ULL << (index % 64);
+        }
+    }
+}
+
+
+/****************************************************************************************************************************
+ * reachable_board():   Purpose: Returns the board (every tile upright) with the reachable one of the two arrangements      *
+ *                                 numbered "index" by board_rank() / 2. Sliding never changes the parity of the number of  *
+ *                                 pairs of tiles out of order (read in position order, skipping the gap), which is even    *
+ *                                 when solved, so the arrangement with an odd number is the unreachable one.               *
+ *                      Parameters: - uint32_t index --> board_rank() / 2 of the arrangement                                *
+ *                      Return value: Board                                                                                 *
+ *                      Side effects: none                                                                                  *
+ ****************************************************************************************************************************/
+Board reachable_board(uint32_t index)
+{
+    Board board = board_unrank(index * 2);
+    int tiles[GAP_TILE];
+    int count = 0, inversions = 0;
+
+    for (int i = 0; i < NUM_PANELS; i++)
+        if (i != board.gap)
+            tiles[count++] = board_tile_at(&board, i);
+    for (int i = 0; i < GAP_TILE; i++)
+        for (int j = i + 1; j < GAP_TILE; j++)
+            inversions += tiles[j] < tiles[i];
+
+    return inversions % 2 ? board_unrank(index * 2 + 1) : board;
+}
+
+
+/****************************************************************************************************************************
+ * open_distance_table(): Purpose: Returns the distance table: the one saved by "--enumerate" (TABLE_FILE_NAME), mapped     *
+ *                                   read-only so that every program using it shares one copy, if there is a valid one, or  *
+ *                                   else one built by build_distance_table(). Returns NULL if it had to be built and       *
+ *                                   there isn't enough memory.                                                             *
+ *                        Parameters: - Mapped_File *file --> pointer to the variable for storing the mapping (left empty   *
+ *                                        if the table was built)                                                           *
+ *                        Return value: const Distance_Table                                                                *
+ *                        Side effects: - alters the variable pointed to by "Mapped_File *file"                             *
+ *                                      - allocates memory (freed by close_distance_table())                                *
+ *                                      - reads external files                                                              *
+ ****************************************************************************************************************************/
+const Distance_Table *open_distance_table(Mapped_File *file)
+{
+    Distance_Table *table;
+    uint32_t byte_order = 0;
+
+    // Written by this build of the program on a machine of the same byte order, or not used at all:
+    if (map_file(TABLE_FILE_NAME, file))
+    {
+        if (file->size == TABLE_HEADER_SIZE + sizeof(Distance_Table))
+            (void) memcpy(&byte_order, file->data + 12, sizeof(byte_order));
+        if (byte_order == TABLE_BYTE_ORDER && memcmp(file->data, TABLE_MAGIC, TABLE_MAGIC_LENGTH) == 0
+            && read_le32(file->data + 8) == TABLE_VERSION && read_le32(file->data + 16) == sizeof(Distance_Table))
+            return (const Distance_Table *) (file->data + TABLE_HEADER_SIZE);
+        (void) unmap_file(file);
+    }
+    file->data = NULL;
+    file->size = 0;
+
+    table = malloc(sizeof(Distance_Table));
+    if (table != NULL)
+        build_distance_table(table);
+
+    return table;
+}
+
+
+/*************************************************************************************************************
+ * close_distance_table(): Purpose: Releases a table from open_distance_table() (a NULL pointer is ignored)  *
+ *                         Parameters: - const Distance_Table *table --> pointer to the table                *
+ *                                     - Mapped_File *file --> pointer to its mapping                        *
+ *                         Return value: none                                                                *
+ *                         Side effects: - frees memory                                                      *
+ *                                       - alters the variable pointed to by "Mapped_File *file"             *
+ *************************************************************************************************************/
+void close_distance_table(const Distance_Table *table, Mapped_File *file)
+{
+    if (file->size > 0)
+        (void) unmap_file(file);
+    else
+        free((void *) table);
+}
+
+
+/*******************************************************************************************************************************
+ * build_patterns():    Purpose: Builds the pattern databases of every board size in pattern_layouts and saves each size's     *
+ *                                 as its own file (PATTERN_FILE_NAME), for open_pattern_databases() to map. Each group of     *
+ *                                 tiles gets a table of the fewest moves of its own tiles that bring them home from every     *
+ *                                 placement they can have, found by build_pattern_group() on every core. Since no move moves  *
+ *                                 two tiles, the groups' entries add up to a lower bound on the slides a whole board needs.   *
+ *                                 Prints each group's size, how far its farthest placement is, and its mean, then how long    *
+ *                                 each board size took.                                                                       *
+ *                      Parameters: none                                                                                       *
+ *                      Return value: none                                                                                     *
+ *                      Side effects: - prints to stdout                                                                       *
+ *                                    - terminates program                                                                     *
+ *                                    - writes external files                                                                  *
+ *******************************************************************************************************************************/
+void build_patterns(void)
+{
+    static Batch_Job job;
+    Batch_Worker workers[MAX_BATCH_THREADS];
+    const Pattern_Layout *layout;
+    const Grid *grid;
+    char header[PATTERN_HEADER_SIZE];
+    char filename[sizeof(PATTERN_FILE_NAME)];
+    char temporary[sizeof(PATTERN_FILE_NAME) + 4];
+    uint8_t *costs[MAX_PATTERN_GROUPS];
+    long entries, most = 0;
+    double total;
+    int farthest;
+    FILE *file;
+    bool written;
+    struct timespec started, finished;
+    double seconds;
+
+    job.max_threads = batch_thread_count();
+    for (int t = 0; t < job.max_threads; t++)
+    {
+        (void) pthread_mutex_init(&job.queues[t].lock, NULL);
+        workers[t] = (Batch_Worker) {.job = &job, .index = t};
+    }
+
+    // One group is built at a time, so the layers need only be as large as the largest group:
+    for (int l = 0; l < PATTERN_LAYOUTS; l++)
+        for (int g = 0; g < pattern_layouts[l].group_count; g++)
+        {
+            entries = pattern_entries(pattern_layouts[l].rows * pattern_layouts[l].columns, pattern_layouts[l].sizes[g]);
+            if (entries > most)
+                most = entries;
+        }
+    job.layer = calloc((size_t) most, sizeof(_Atomic uint32_t));
+    job.next_layer = calloc((size_t) most, sizeof(_Atomic uint32_t));
+    job.placed = malloc((size_t) most * sizeof(uint32_t));
+    if (job.layer == NULL || job.next_layer == NULL || job.placed == NULL)
+    {
+        (void) printf("Error 31: Not enough memory to build pattern databases of %ld placements.\n", most);
+        exit(31);
+    }
+
+    for (int l = 0; l < PATTERN_LAYOUTS; l++)
+    {
+        layout = &pattern_layouts[l];
+        grid = grid_of(layout->rows, layout->columns);
+        (void) clock_gettime(CLOCK_MONOTONIC, &started);
+        for (int g = 0; g < layout->group_count; g++)
+        {
+            entries = pattern_entries(grid->cells, layout->sizes[g]);
+            costs[g] = malloc((size_t) entries);
+            if (costs[g] == NULL)
+            {
+                (void) printf("Error 31: Not enough memory to build pattern databases of %ld placements.\n", entries);
+                exit(31);
+            }
+            farthest = build_pattern_group(&job, workers, grid, layout->tiles[g], layout->sizes[g], costs[g]);
+            total = 0;
+            for (long i = 0; i < entries; i++)
+                total += costs[g][i];
+            (void) printf("board=%dx%d group=%d tiles=%d entries=%ld farthest=%d mean=%.3f\n", layout->rows,
+                          layout->columns, g + 1, layout->sizes[g], entries, farthest, total / (double) entries);
+        }
+        (void) clock_gettime(CLOCK_MONOTONIC, &finished);
+        seconds = elapsed_seconds(&started, &finished);
+        (void) printf("board=%dx%d threads=%d seconds=%.6f\n", layout->rows, layout->columns, job.max_threads, seconds);
+
+        // Written under another name and renamed into place, so that programs already mapping the old file keep it intact:
+        pattern_header(header, layout);
+        (void) sprintf(filename, PATTERN_FILE_NAME, layout->rows, layout->columns);
+        (void) sprintf(temporary, "%s.new", filename);
+        file = fopen(temporary, "wb");
+        written = file != NULL && fwrite(header, PATTERN_HEADER_SIZE, 1, file) == 1;
+        for (int g = 0; g < layout->group_count; g++)
+        {
+            entries = pattern_entries(grid->cells, layout->sizes[g]);
+            written = written && fwrite(costs[g], (size_t) entries, 1, file) == 1;
+            free(costs[g]);
+        }
+        if (file == NULL || fclose(file) || !written || rename(temporary, filename))
+        {
+            (void) printf("Error 34: Pattern database %s could not be written.\n", filename);
+            exit(34);
+        }
+        (void) printf("Wrote the %dx%d pattern databases to %s.\n", layout->rows, layout->columns, filename);
+    }
+
+    for (int t = 0; t < job.max_threads; t++)
+        (void) pthread_mutex_destroy(&job.queues[t].lock);
+    free((void *) job.layer);
+    free((void *) job.next_layer);
+    free(job.placed);
+}
+
+
+/****************************************************************************************************************************
+ * build_pattern_group(): Purpose: Fills a pattern database table for build_patterns(): for every placement of a group of   *
+ *                                   tiles, the fewest moves of those tiles alone that bring them home, whatever the other  *
+ *                                   tiles do. The search runs over placements and gap positions together, a layer of cost  *
+ *                                   at a time: the gap moves among the positions the group leaves empty at no cost, and    *
+ *                                   moving one of the group's tiles costs one move. Each layer is expanded on every core.  *
+ *                                   Returns the farthest cost found.                                                       *
+ *                        Parameters: - Batch_Job *job --> pointer to the job, with its layers and "placed" array           *
+ *                                    - Batch_Worker workers[] --> each thread's Batch_Worker                               *
+ *                                    - const Grid *grid --> the board size                                                 *
+ *                                    - const int8_t tiles[] --> the group's tiles                                          *
+ *                                    - int size --> the number of tiles in the group                                       *
+ *                                    - uint8_t *costs --> the table to fill, pattern_entries() long                        *
+ *                        Return value: int                                                                                 *
+ *                        Side effects: - alters the variable pointed to by "Batch_Job *job" and the table                  *
+ ****************************************************************************************************************************/
+int build_pattern_group(Batch_Job *job, Batch_Worker workers[], const Grid *grid, const int8_t tiles[], int size,
+                        uint8_t *costs)
+{
+    long entries = pattern_entries(grid->cells, size);
+    int positions[MAX_PATTERN_SIZE];
+    _Atomic uint32_t *swap;
+    long expanded = 1;
+
+    job->grid = grid;
+    job->group_size = size;
+    job->placements = entries;
+    job->costs = costs;
+    (void) memset(costs, PATTERN_UNSEEN, (size_t) entries);
+    (void) memset(job->placed, 0, (size_t) entries * sizeof(uint32_t));
+
+    // The first layer is the group at home, with the gap in the last position:
+    for (int i = 0; i < size; i++)
+        positions[i] = tiles[i];
+    atomic_store_explicit(&job->layer[pattern_rank(positions, size, grid->cells)], 1U << (grid->cells - 1),
+                          memory_order_relaxed);
+    for (job->cost = 0; expanded > 0; job->cost++)
+    {
+        for (int t = 0; t < job->max_threads; t++)
+            job->expanded[t] = 0;
+        run_batch_pass(job, workers, BATCH_PATTERN, (entries + PATTERN_BLOCK - 1) / PATTERN_BLOCK);
+        expanded = 0;
+        for (int t = 0; t < job->max_threads; t++)
+            expanded += job->expanded[t];
+        swap = job->layer;
+        job->layer = job->next_layer;
+        job->next_layer = swap;
+    }
+
+    return job->cost - 2; // The last layer expanded nothing, and the loop counted past it.
+}
+
+
+/******************************************************************************************************************************
+ * expand_placements(): Purpose: Expands one block (PATTERN_BLOCK placements) of a layer for build_pattern_group(): spreads   *
+ *                                 each placement's new gap positions over every empty position they reach, records the       *
+ *                                 layer's cost for placements seen for the first time, and adds every placement one move of  *
+ *                                 the group's tiles away to the next layer. Each placement is only ever touched by the       *
+ *                                 thread expanding its block, except for the next layer, which is shared and added to        *
+ *                                 atomically.                                                                                *
+ *                      Parameters: - Batch_Job *job --> pointer to the job                                                   *
+ *                                  - int thread --> the expanding thread, whose count of placements expanded is kept         *
+ *                                  - long block --> which block of placements to expand                                      *
+ *                      Return value: none                                                                                    *
+ *                      Side effects: - alters the job's layers, "placed" array, table, and counts                            *
+ ******************************************************************************************************************************/
+void expand_placements(Batch_Job *job, int thread, long block)
+{
+    const Grid *grid = job->grid;
+    int size = job->group_size;
+    long last = (block + 1) * PATTERN_BLOCK < job->placements ? (block + 1) * PATTERN_BLOCK : job->placements;
+    int positions[MAX_PATTERN_SIZE];
+    int members[MAX_CELLS]; // Which of the group's tiles is in each position (-1 for none).
+    int pending[MAX_CELLS]; // Gap positions reached whose neighbours haven't been looked at yet.
+    int pending_count;
+    uint32_t fresh, reach;
+    int x, from;
+
+    for (long p = block * PATTERN_BLOCK; p < last; p++)
+    {
+        fresh = atomic_load_explicit(&job->layer[p], memory_order_relaxed) & ~job->placed[p];
+        atomic_store_explicit(&job->layer[p], 0, memory_order_relaxed); // Left empty, for its turn as the next layer.
+        if (fresh == 0)
+            continue;
+        pattern_unrank((uint32_t) p, size, grid->cells, positions);
+        for (int i = 0; i < grid->cells; i++)
+            members[i] = -1;
+        for (int i = 0; i < size; i++)
+            members[positions[i]] = i;
+
+        // The gap moves among the empty positions for free, so wherever it can get to is at this cost too:
+        reach = fresh;
+        pending_count = 0;
+        for (x = 0; x < grid->cells; x++)
+            if (fresh >> x & 1)
+                pending[pending_count++] = x;
+        while (pending_count > 0)
+        {
+            x = pending[--pending_count];
+            for (int d = SLIDE_UP; d <= SLIDE_RIGHT; d++)
+            {
+                from = grid->neighbours[x][d];
+                if (from >= 0 && members[from] < 0 && !(reach >> from & 1))
+                {
+                    reach |= 1U << from;
+                    pending[pending_count++] = from;
+                }
+            }
+        }
+        if (job->placed[p] == 0)
+            job->costs[p] = (uint8_t) job->cost;
+        job->placed[p] |= reach;
+        job->expanded[thread]++;
+
+        // Sliding one of the group's tiles into the gap costs a move, and leaves the gap where the tile was:
+        for (x = 0; x < grid->cells; x++)
+            for (int d = SLIDE_UP; d <= SLIDE_RIGHT && (reach >> x & 1); d++)
+            {
+                from = grid->neighbours[x][d];
+                if (from < 0 || members[from] < 0)
+                    continue;
+                positions[members[from]] = x;
+                (void) atomic_fetch_or_explicit(&job->next_layer[pattern_rank(positions, size, grid->cells)], 1U << from,
+                                                memory_order_relaxed);
+                positions[members[from]] = from;
+            }
+    }
+}
+
+
+/************************************************************************************************************************
+ * pattern_rank():      Purpose: Numbers a placement of a group of tiles (which position each is in) from 0 to          *
+ *                                 pattern_entries() - 1: each tile's position counted among those the tiles before it  *
+ *                                 leave free, as digits of a mixed-radix number                                        *
+ *                      Parameters: - const int positions[] --> the position of each of the group's tiles, in order     *
+ *                                  - int size --> the number of tiles in the group                                     *
+ *                                  - int cells --> the number of positions on the board                                *
+ *                      Return value: uint32_t                                                                          *
+ *                      Side effects: none                                                                              *
+ ************************************************************************************************************************/
+uint32_t pattern_rank(const int positions[], int size, int cells)
+{
+    uint32_t rank = 0;
+    int digit;
+
+    for (int i = 0; i < size; i++)
+    {
+        digit = positions[i];
+        for (int j = 0; j < i; j++)
+            digit -= positions[j] < positions[i];
+        rank = rank * (uint32_t) (cells - i) + (uint32_t) digit;
+    }
+
+    return rank;
+}
+
+
+/***************************************************************************************************************************
+ * pattern_unrank():    Purpose: Finds the placement of a group of tiles with the given pattern_rank()                     *
+ *                      Parameters: - uint32_t rank --> the placement's pattern_rank()                                     *
+ *                                  - int size --> the number of tiles in the group                                        *
+ *                                  - int cells --> the number of positions on the board                                   *
+ *                                  - int positions[] --> the array for storing the position of each of the group's tiles  *
+ *                      Return value: none                                                                                 *
+ *                      Side effects: - alters the array positions[]                                                       *
+ ***************************************************************************************************************************/
+void pattern_unrank(uint32_t rank, int size, int cells, int positions[])
+{
+    int digits[MAX_PATTERN_SIZE];
+    bool used[MAX_CELLS] = {false};
+    int skip;
+
+    for (int i = size - 1; i >= 0; i--)
+    {
+        digits[i] = (int) (rank % (uint32_t) (cells - i));
+        rank /= (uint32_t) (cells - i);
+    }
+    for (int i = 0; i < size; i++)
+    {
+        skip = digits[i];
+        for (int p = 0; p < cells; p++)
+            if (!used[p] && skip-- == 0)
+            {
+                positions[i] = p;
+                used[p] = true;
+                break;
+            }
+    }
+}
+
+
+/*************************************************************************************************************************
+ * pattern_entries():   Purpose: Returns how many placements a group of tiles has on a board, which is how many entries  *
+ *                                 its pattern database table has                                                        *
+ *                      Parameters: - int cells --> the number of positions on the board                                 *
+ *                                  - int size --> the number of tiles in the group                                      *
+ *                      Return value: long                                                                               *
+ *                      Side effects: none                                                                               *
+ *************************************************************************************************************************/
+long pattern_entries(int cells, int size)
+{
+    long entries = 1;
+
+    for (int i = 0; i < size; i++)
+        entries *= cells - i;
+
+    return entries;
+}
+
+
+/***********************************************************************************************************************
+ * pattern_header():    Purpose: Writes the header a board size's pattern database file starts with, which also tells  *
+ *                                 open_pattern_databases() whether a file was built for the layout it expects         *
+ *                      Parameters: - char header[] --> the array for storing the header, PATTERN_HEADER_SIZE long     *
+ *                                  - const Pattern_Layout *layout --> pointer to the board size's layout              *
+ *                      Return value: none                                                                             *
+ *                      Side effects: - alters the array header[]                                                      *
+ ***********************************************************************************************************************/
+void pattern_header(char header[], const Pattern_Layout *layout)
+{
+    (void) memset(header, 0, PATTERN_HEADER_SIZE);
+    (void) memcpy(header, PATTERN_MAGIC, PATTERN_MAGIC_LENGTH);
+    write_le32(header + 8, PATTERN_VERSION);
+    header[12] = (char) layout->rows;
+    header[13] = (char) layout->columns;
+    header[14] = (char) layout->group_count;
+    for (int g = 0; g < layout->group_count; g++)
+    {
+        header[16 + g] = (char) layout->sizes[g];
+        for (int i = 0; i < layout->sizes[g]; i++)
+            header[24 + g * MAX_PATTERN_SIZE + i] = (char) layout->tiles[g][i];
+    }
+}
+
+
+/*************************************************************************************************************************
+ * open_pattern_databases(): Purpose: Maps every board size's pattern database file saved by "--build-patterns"          *
+ *                                      (PATTERN_FILE_NAME) read-only, so that every program using it shares one copy.   *
+ *                                      Files that are missing, or weren't built for the layout in pattern_layouts, are  *
+ *                                      left unmapped. Called once, by pattern_database(); the mappings last as long as  *
+ *                                      the program.                                                                     *
+ *                           Parameters: none                                                                            *
+ *                           Return value: none                                                                          *
+ *                           Side effects: - alters the external variable "pattern_databases"                            *
+ *                                         - reads external files                                                        *
+ *************************************************************************************************************************/
+void open_pattern_databases(void)
+{
+    const Pattern_Layout *layout;
+    Pattern_Database *database;
+    char header[PATTERN_HEADER_SIZE];
+    char filename[sizeof(PATTERN_FILE_NAME)];
+    size_t size, offset;
+    int cells;
+
+    for (int l = 0; l < PATTERN_LAYOUTS; l++)
+    {
+        layout = &pattern_layouts[l];
+        database = &pattern_databases[l];
+        database->layout = layout;
+        cells = layout->rows * layout->columns;
+        size = PATTERN_HEADER_SIZE;
+        for (int g = 0; g < layout->group_count; g++)
+            size += (size_t) pattern_entries(cells, layout->sizes[g]);
+        (void) sprintf(filename, PATTERN_FILE_NAME, layout->rows, layout->columns);
+        pattern_header(header, layout);
+        if (!map_file(filename, &database->file))
+        {
+            database->file = (Mapped_File) {.data = NULL, .size = 0};
+            continue;
+        }
+        if (database->file.size != size || memcmp(database->file.data, header, PATTERN_HEADER_SIZE) != 0)
+        {
+            (void) unmap_file(&database->file);
+            database->file = (Mapped_File) {.data = NULL, .size = 0};
+            continue;
+        }
+        offset = PATTERN_HEADER_SIZE;
+        for (int g = 0; g < layout->group_count; g++)
+        {
+            database->costs[g] = (const uint8_t *) database->file.data + offset;
+            offset += (size_t) pattern_entries(cells, layout->sizes[g]);
+        }
+    }
+}
+
+
+/**************************************************************************************************************************
+ * pattern_database():  Purpose: Returns the pattern databases for boards of a grid's size, or NULL if there are none     *
+ *                                 (only some sizes have a layout, and then only once "--build-patterns" has saved them)  *
+ *                      Parameters: - const Grid *grid --> the board size                                                 *
+ *                      Return value: const Pattern_Database *                                                            *
+ *                      Side effects: - maps external files, the first time it is called                                  *
+ **************************************************************************************************************************/
+const Pattern_Database *pattern_database(const Grid *grid)
+{
+    static pthread_once_t opened = PTHREAD_ONCE_INIT;
+
+    (void) pthread_once(&opened, open_pattern_databases);
+    for (int l = 0; l < PATTERN_LAYOUTS; l++)
+        if (pattern_databases[l].file.data != NULL && grid == grid_of(pattern_layouts[l].rows, pattern_layouts[l].columns))
+            return &pattern_databases[l];
+
+    return NULL;
+}
+
+
+/********************************************************************************************************************************
+ * bench_kernels():     Purpose: Times the tile kernels against their scalar fallbacks and prints the results: mirroring every  *
+ *                                 line of a panel (mirror_line(), as flip_panel_over_y() does) and comparing two panels        *
+ *                                 (panels_equal(), as build_atlas() does, on pairs that match all the way to the last line so  *
+ *                                 that every byte is compared), for the default panel size and the widest a 2x2 board allows.  *
+ *                                 Both versions' results are checked against each other. The panels are random printable       *
+ *                                 characters, BENCH_PANELS of them stored as an atlas stores them, run through until           *
+ *                                 BENCH_BYTES have been processed; each time reported is the best of BENCH_ROUNDS.             *
+ *                      Parameters: none                                                                                        *
+ *                      Return value: none                                                                                      *
+ *                      Side effects: - prints to stdout                                                                        *
+ *                                    - terminates program                                                                      *
+ ********************************************************************************************************************************/
+void bench_kernels(void)
+{
+    const Panel_Size sizes[2] = {{.width = DEFAULT_PANEL_WIDTH, .height = DEFAULT_PANEL_HEIGHT},
+                                 {.width = (MAX_DISPLAY_WIDTH - 3) / (MIN_GRID_SIDE + 1),
+                                  .height = (MAX_DISPLAY_LINES - 1) / MIN_GRID_SIDE}};
+    const char *names[2] = {"mirror", "equal"};
+    Panel_Size size;
+    size_t stride;
+    long repeats;
+    char *panels, *copies, *mirrored[2];
+    Rng rng;
+    long matches[2];
+    double ns[2][2]; // Nanoseconds per panel, for each kernel, scalar and then vector.
+    double elapsed;
+    int vector;
+    struct timespec started, finished;
+
+    (void) printf("kernels=%s\n", KERNEL_SET);
+    for (int s = 0; s < 2; s++)
+    {
+        size = sizes[s];
+        stride = PANEL_STRIDE(size);
+        repeats = BENCH_BYTES / (long) (BENCH_PANELS * PANEL_BYTES(size));
+        panels = aligned_alloc(CACHE_LINE, BENCH_PANELS * stride);
+        copies = aligned_alloc(CACHE_LINE, BENCH_PANELS * stride);
+        mirrored[0] = aligned_alloc(CACHE_LINE, BENCH_PANELS * stride);
+        mirrored[1] = aligned_alloc(CACHE_LINE, BENCH_PANELS * stride);
+        if (panels == NULL || copies == NULL || mirrored[0] == NULL || mirrored[1] == NULL)
+        {
+            (void) printf("Error 35: Not enough memory to benchmark the tile kernels.\n");
+            exit(35);
+        }
+
+        // Random art, and copies of it that differ only in the last byte of every other panel:
+        rng_seed(&rng, (uint64_t) s);
+        (void) memset(panels, 0, BENCH_PANELS * stride);
+        for (int p = 0; p < BENCH_PANELS; p++)
+            for (size_t i = 0; i < PANEL_BYTES(size); i++)
+                panels[p * stride + i] = (char) (' ' + rng_below(&rng, 95));
+        (void) memcpy(copies, panels, BENCH_PANELS * stride);
+        for (int p = 1; p < BENCH_PANELS; p += 2)
+            copies[p * stride + PANEL_BYTES(size) - 1] ^= 1;
+
+        // Scalar and vector rounds alternate, so that both see much the same machine:
+        ns[0][0] = ns[0][1] = ns[1][0] = ns[1][1] = 1e30;
+        for (int round = 0; round < 2 * BENCH_ROUNDS; round++)
+        {
+            vector = round % 2;
+            (void) clock_gettime(CLOCK_MONOTONIC, &started);
+            for (long r = 0; r < repeats; r++)
+                for (int p = 0; p < BENCH_PANELS; p++)
+                    for (int line = 0; line < size.height; line++)
+                        (vector ? mirror_line : mirror_line_scalar)(PANEL_LINE(mirrored[vector] + p * stride, line, size),
+                                                                    PANEL_LINE(panels + p * stride, line, size), size.width);
+            (void) clock_gettime(CLOCK_MONOTONIC, &finished);
+            elapsed = elapsed_seconds(&started, &finished) * 1e9;
+            if (elapsed / ((double) repeats * BENCH_PANELS) < ns[0][vector])
+                ns[0][vector] = elapsed / ((double) repeats * BENCH_PANELS);
+
+            matches[vector] = 0;
+            (void) clock_gettime(CLOCK_MONOTONIC, &started);
+            for (long r = 0; r < repeats; r++)
+                for (int p = 0; p < BENCH_PANELS; p++)
+                    matches[vector] += (vector ? panels_equal : panels_equal_scalar)(panels + p * stride, copies + p * stride,
+                                                                                     stride);
+            (void) clock_gettime(CLOCK_MONOTONIC, &finished);
+            elapsed = elapsed_seconds(&started, &finished) * 1e9;
+            if (elapsed / ((double) repeats * BENCH_PANELS) < ns[1][vector])
+                ns[1][vector] = elapsed / ((double) repeats * BENCH_PANELS);
+        }
+        if (memcmp(mirrored[0], mirrored[1], BENCH_PANELS * PANEL_BYTES(size)) != 0 || matches[0] != matches[1]
+            || matches[0] != repeats * BENCH_PANELS / 2)
+        {
+            (void) printf("Error 36: The %s tile kernels disagree with their scalar fallbacks.\n", KERNEL_SET);
+            exit(36);
+        }
+
+        for (int k = 0; k < 2; k++)
+            (void) printf("kernel=%s panel=%dx%d scalar_ns=%.1f vector_ns=%.1f speedup=%.2f\n", names[k], size.width,
+                          size.height, ns[k][0], ns[k][1], ns[k][0] / ns[k][1]);
+        free(panels);
+        free(copies);
+        free(mirrored[0]);
+        free(mirrored[1]);
+    }
+}
+
+
+/********************************************************************************************************************************
+ * hardest_distance():  Purpose: Works out the most moves from solved that a board drawn by board_at_difficulty() can be: the   *
+ *                                 largest, over every arrangement in the table and every way of turning the tiles, of the      *
+ *                                 fewest slides and flips that reach a goal arrangement (see goal_distance()). The flips each  *
+ *                                 goal needs are added up a tile at a time, dropping any way of turning that another beats     *
+ *                                 for every goal. Returns -1 if solve_board() searches this art's boards rather than looking   *
+ *                                 them up (see table_solves()), or if more than MAX_TURNINGS ways of turning are left.         *
+ *                      Parameters: - const Tile_Atlas *atlas --> pointer to the puzzle's art in every orientation              *
+ *                                  - const Distance_Table *table --> pointer to the distance table                             *
+ *                      Return value: int                                                                                       *
+ *                      Side effects: none                                                                                      *
+ ********************************************************************************************************************************/
+int hardest_distance(const Tile_Atlas *atlas, const Distance_Table *table)
+{
+    Search search; // Only for collecting the goal arrangements.
+    int tile_positions[NUM_PANELS];
+    int target[NUM_PANELS];
+    bool used[NUM_PANELS] = {false};
+    int flips[MAX_TURNINGS][MAX_GOALS] = {{0}}; // The flips each goal needs, for each way of turning the tiles so far,
+    int turned[MAX_TURNINGS * NUM_ORIENTATIONS][MAX_GOALS]; //     and for each of those with the next tile turned as well.
+    int ways = 1, candidates, most_flips = 0;
+    int distances[MAX_GOALS];
+    int fewest, hardest = 0;
+    bool covered, differs, beaten;
+    Board board;
+
+    if (!table_solves(atlas))
+        return -1;
+    for (int i = 0; i < NUM_PANELS; i++)
+        tile_positions[i] = i;
+    target[GAP_TILE] = GAP_TILE;
+    used[GAP_TILE] = true;
+    search.goal_count = 0;
+    (void) assign_positions(atlas, tile_positions, target, used, 0, 0, &search);
+
+    for (int i = 0; i < GAP_TILE; i++)
+    {
+        candidates = 0;
+        for (int w = 0; w < ways; w++)
+            for (int orientation = 0; orientation < NUM_ORIENTATIONS; orientation++, candidates++)
+                for (int g = 0; g < search.goal_count; g++)
+                    turned[candidates][g] = flips[w][g] + !(atlas->matches[i][search.goals[g][i]] & (1 << orientation));
+
+        // Another way beats this one if it needs at least as many flips for every goal (the first of equals is kept):
+        ways = 0;
+        for (int c = 0; c < candidates; c++)
+        {
+            beaten = false;
+            for (int other = 0; other < candidates && !beaten; other++)
+            {
+                covered = other != c;
+                differs = false;
+                for (int g = 0; g < search.goal_count; g++)
+                {
+                    covered = covered && turned[other][g] >= turned[c][g];
+                    differs = differs || turned[other][g] != turned[c][g];
+                }
+                beaten = covered && (differs || other < c);
+            }
+            if (beaten)
+                continue;
+            if (ways == MAX_TURNINGS)
+                return -1;
+            for (int g = 0; g < search.goal_count; g++)
+                flips[ways][g] = turned[c][g];
+            ways++;
+        }
+    }
+    for (int w = 0; w < ways; w++)
+        for (int g = 0; g < search.goal_count; g++)
+            if (flips[w][g] > most_flips)
+                most_flips = flips[w][g];
+
+    // The solved arrangement is one of the goals, so no board needs more than its slides from it plus the most flips, and
+    //     the farthest arrangements can be tried first until none can beat the hardest found:
+    for (int slides = MAX_SLIDE_DISTANCE; slides >= 0 && slides + most_flips > hardest; slides--)
+        for (int r = table->first[slides]; r < table->first[slides + 1]; r++)
+        {
+            board = board_unrank(table->by_distance[r]);
+            for (int g = 0; g < search.goal_count; g++)
+                distances[g] = goal_distance(table, &board, search.goals[g]);
+            for (int w = 0; w < ways; w++)
+            {
+                fewest = MAX_SOLUTION_LENGTH;
+                for (int g = 0; g < search.goal_count; g++)
+                    if (distances[g] + flips[w][g] < fewest)
+                        fewest = distances[g] + flips[w][g];
+                if (fewest > hardest)
+                    hardest = fewest;
+            }
+        }
+
+    return hardest;
+}
+
+
+/***********************************************************************************************************************************
+ * check_difficulty():  Purpose: Checks the scrambles of a 3x3 puzzle to every difficulty from 0 to MAX_DIFFICULTY, with           *
+ *                                 DIFFICULTY_CHECK_SEEDS seeds apiece. Each board is solved by search alone (so the distance      *
+ *                                 table's answers are checked too), and must be the difficulty asked for from solved, or the      *
+ *                                 hardest the art allows (see hardest_distance()) if that is less; the difficulty sp_scramble()   *
+ *                                 records must agree. Art with too many identical tiles to work out its hardest board is only     *
+ *                                 scrambled by chance (see board_at_difficulty()), so only that agreement is checked for it, and  *
+ *                                 "expected" is left as "?". Prints a line for each difficulty, such as                           *
+ *                                 "difficulty=38 expected=37 moves=37,37,..." (each seed's board), then a summary, and            *
+ *                                 terminates with an error if any board was wrong.                                                *
+ *                      Parameters: - const char *puzzle_name --> the puzzle file or pack (or NULL for the default puzzle)         *
+ *                                  - long pack_puzzle --> which puzzle of a pack to use, counting from 1                          *
+ *                      Return value: none                                                                                         *
+ *                      Side effects: - prints to stdout                                                                           *
+ *                                    - terminates program                                                                         *
+ *                                    - reads external files                                                                       *
+ ***********************************************************************************************************************************/
+void check_difficulty(const char *puzzle_name, long pack_puzzle)
+{
+    Sp_State *state = sp_create(puzzle_name, pack_puzzle);
+    Solution solution;
+    int moves[MAX_DIFFICULTY + 1][DIFFICULTY_CHECK_SEEDS];
+    int hardest, scrambled = 0, expected;
+    bool worked_out;
+    long wrong = 0;
+
+    if (state == NULL)
+    {
+        (void) printf("Error 26: Puzzle %s could not be loaded (missing, misformatted, or no such puzzle in the pack).\n",
+                      puzzle_name == NULL ? "(default)" : puzzle_name);
+        exit(26);
+    }
+    if (state->atlas.grid != grid_of(DEFAULT_SIDE, DEFAULT_SIDE))
+    {
+        (void) printf("Error 37: Only 3x3 puzzles are scrambled to a difficulty exactly, so only they can be checked.\n");
+        exit(37);
+    }
+    if (state_table(state) == NULL)
+    {
+        (void) printf("Error 27: Not enough memory to play.\n");
+        exit(27);
+    }
+
+    for (int difficulty = 0; difficulty <= MAX_DIFFICULTY; difficulty++)
+        for (int seed = 0; seed < DIFFICULTY_CHECK_SEEDS; seed++)
+        {
+            (void) sp_scramble(state, (uint64_t) seed + 1, difficulty); // The table is already open, so this can't fail.
+            moves[difficulty][seed] = solve_board(&state->atlas, NULL, &state->board, &solution) ? solution.length : -1;
+            wrong += state->distance != moves[difficulty][seed];
+            if (moves[difficulty][seed] > scrambled)
+                scrambled = moves[difficulty][seed];
+        }
+    hardest = hardest_distance(&state->atlas, state->table);
+    worked_out = hardest >= 0;
+    if (!worked_out)
+        hardest = scrambled;
+
+    for (int difficulty = 0; difficulty <= MAX_DIFFICULTY; difficulty++)
+    {
+        expected = difficulty < hardest ? difficulty : hardest;
+        if (worked_out)
+            (void) printf("difficulty=%d expected=%d moves=", difficulty, expected);
+        else
+            (void) printf("difficulty=%d expected=? moves=", difficulty);
+        for (int seed = 0; seed < DIFFICULTY_CHECK_SEEDS; seed++)
+        {
+            (void) printf("%s%d", seed > 0 ? "," : "", moves[difficulty][seed]);
+            wrong += worked_out && moves[difficulty][seed] != expected;
+        }
+        (void) printf("\n");
+    }
+    (void) printf("difficulties=%d seeds=%d hardest=%d worked_out=%s wrong=%ld\n", MAX_DIFFICULTY + 1, DIFFICULTY_CHECK_SEEDS,
+                  hardest, worked_out ? "yes" : "no", wrong);
+    sp_destroy(state);
+    if (wrong > 0)
+    {
+        (void) printf("Error 38: %ld scrambles were not the difficulty expected.\n", wrong);
+        exit(38);
+    }
+}
+
+
 /************************************************************************************************************************************************
  * Notes on further work:                                                                                                                       *
  * - It would be nice to expand this program in order to display color graphics, using ANSI escapes.                                            *
@@ -0,0 +1,70 @@
+/**************************************************
+ * Name: sliding_puzzle.h                         *
+ * File creation date: 2026-10-17                 *
+ * Last modification date: 2026-10-17             *
+ * Author: Ryan Wells                             *
+ * Purpose: The puzzle engine of sliding_puzzle.c *
+ *          for use from other programs           *
+ **************************************************/
+
+/*
+ * The engine holds a puzzle's art and board behind an opaque handle, so that bots and analysis tools can play without the
+ * terminal front end. To build it as a library, leave out main() with SP_LIBRARY:
+ *
+ *      cc -std=c11 -O2 -pthread -DSP_LIBRARY -c sliding_puzzle.c && ar rcs libslidingpuzzle.a sliding_puzzle.o
+ *
+ * A handle may be used from one thread at a time; separate handles are independent.
+ */
+
+#ifndef SLIDING_PUZZLE_H
+#define SLIDING_PUZZLE_H
+
+/* Preprocessing Directives (#include) */
+#include <stdbool.h> // for the macro "bool"
+#include <stddef.h> // for the type "size_t"
+#include <stdint.h> // for the types "uint8_t" and "uint64_t"
+
+/* Preprocessing Directives (#define) */
+// Move codes fit in a byte: the low two bits are the orientation bits to toggle (0 for a slide),
+//      and the upper bits are the slide direction or the position (0 to rows * columns - 1, left to right, top to bottom)
+//      of the panel to flip, which limits boards to 64 positions.
+#define SP_SLIDE_UP 0 // The panel below the gap moves up
+#define SP_SLIDE_DOWN 1 // The panel above the gap moves down
+#define SP_SLIDE_LEFT 2 // The panel right of the gap moves left
+#define SP_SLIDE_RIGHT 3 // The panel left of the gap moves right
+#define SP_FLIP_HORIZONTAL 1 // Mirror across the y-axis
+#define SP_FLIP_VERTICAL 2 // Mirror across the x-axis
+#define SP_ROTATE (SP_FLIP_HORIZONTAL | SP_FLIP_VERTICAL) // A 180-degree rotation toggles both bits
+#define SP_SLIDE_MOVE(direction) ((uint8_t) ((direction) << 2))
+#define SP_FLIP_MOVE(position, flip) ((uint8_t) (((position) << 2) | (flip)))
+#define SP_MAX_SOLUTION_LENGTH 255 // Room enough for any solution sp_solve() finds
+#define SP_GAVE_UP (-2) // What sp_solve() returns when its search gives up on a board that can be solved
+#define SP_RENDER_SIZE 33563 // Bytes sp_render_into() needs for the largest display, including the terminating null
+
+/* Type Definitions */
+typedef struct Sp_State Sp_State; // One puzzle's art and its current board
+
+/* Prototypes */
+Sp_State *sp_create(const char *puzzle_name, long pack_puzzle); // Loads a puzzle file, the pack_puzzle'th puzzle (from 1) of a
+                                                                //     pack, or the default puzzle if puzzle_name is NULL; the
+                                                                //     board starts solved. Returns NULL if it can't be loaded.
+void sp_destroy(Sp_State *state);
+bool sp_scramble(Sp_State *state, uint64_t seed, int difficulty); // As the game does; difficulty -1 for uniformly random.
+                                                                  //     Returns false only if out of memory.
+size_t sp_apply_moves(Sp_State *state, const uint8_t *moves, size_t n); // Applies moves in order, stopping at the first
+                                                                        //     illegal one; returns how many were applied.
+                                                                        //     Each is added to the undo history.
+size_t sp_check_moves(const Sp_State *state, const uint8_t *moves, size_t n); // How many of the moves sp_apply_moves()
+                                                                              //     would apply, without applying any.
+bool sp_undo(Sp_State *state); // Takes back the last move not yet undone; false if there is none. Undo is unlimited.
+bool sp_redo(Sp_State *state); // Makes the last undone move again; false if there is none, or a move has been made since.
+bool sp_is_solved(const Sp_State *state);
+int sp_solve(Sp_State *state, uint8_t *moves, int capacity); // Stores a shortest solution's moves; returns its length,
+                                                             //     -1 if unsolvable or longer than capacity, or
+                                                             //     SP_GAVE_UP if the search gave up first (which only
+                                                             //     happens on boards larger than 3x3). Opens the 3x3
+                                                             //     distance table, as sp_scramble() does.
+size_t sp_render_into(Sp_State *state, char *buffer, size_t size); // Writes the display as text lines (like snprintf(),
+                                                                   //     as much as fits); returns its full length.
+
+#endif